@@ -1240,6 +1240,7 @@ m4_include([m4/DEFINE_WITH_JNI.m4])
 m4_include([m4/DEFINE_WITH_NETTLE.m4])
 m4_include([m4/DEFINE_WITH_SSE.m4])
 m4_include([m4/DEFINE_WITH_SSE2.m4])
+m4_include([m4/DEFINE_WITH_VAES.m4])
 m4_include([m4/DEFINE_WITH_WINDOWS_BCRYPT.m4])
 m4_include([m4/DEFINE_WITH_WINDOWS_KERNEL32.m4])
 m4_include([m4/DEFINE_WITH_X86.m4])
@@ -1255,6 +1256,7 @@ m4_include([m4/DEFINE_WYNA_JNI.m4])
 m4_include([m4/DEFINE_WYNA_NETTLE.m4])
 m4_include([m4/DEFINE_WYNA_SSE.m4])
 m4_include([m4/DEFINE_WYNA_SSE2.m4])
+m4_include([m4/DEFINE_WYNA_VAES.m4])
 m4_include([m4/DEFINE_WYNA_WINDOWS_BCRYPT.m4])
 m4_include([m4/DEFINE_WYNA_WINDOWS_KERNEL32.m4])
 m4_include([m4/DEFINE_WYNA_X86_32.m4])
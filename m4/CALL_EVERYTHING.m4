@@ -37,6 +37,7 @@ GATBPS_CALL_COMMENT([$0]m4_if(m4_eval([$# > 0]), [1], [, $@]))
   GATBPS_REQUIRE([DEFINE_WITH_NETTLE])
   GATBPS_REQUIRE([DEFINE_WITH_SSE])
   GATBPS_REQUIRE([DEFINE_WITH_SSE2])
+  GATBPS_REQUIRE([DEFINE_WITH_VAES])
   GATBPS_REQUIRE([DEFINE_WITH_WINDOWS_BCRYPT])
   GATBPS_REQUIRE([DEFINE_WITH_WINDOWS_KERNEL32])
   GATBPS_REQUIRE([DEFINE_WITH_X86])
@@ -52,6 +53,7 @@ GATBPS_CALL_COMMENT([$0]m4_if(m4_eval([$# > 0]), [1], [, $@]))
   GATBPS_REQUIRE([DEFINE_WYNA_NETTLE])
   GATBPS_REQUIRE([DEFINE_WYNA_SSE])
   GATBPS_REQUIRE([DEFINE_WYNA_SSE2])
+  GATBPS_REQUIRE([DEFINE_WYNA_VAES])
   GATBPS_REQUIRE([DEFINE_WYNA_WINDOWS_BCRYPT])
   GATBPS_REQUIRE([DEFINE_WYNA_WINDOWS_KERNEL32])
   GATBPS_REQUIRE([DEFINE_WYNA_X86_32])
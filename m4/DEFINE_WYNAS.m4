@@ -17,6 +17,7 @@ GATBPS_CALL_COMMENT([$0]m4_if(m4_eval([$# > 0]), [1], [, $@]))
   GATBPS_REQUIRE([DEFINE_WYNA_NETTLE])
   GATBPS_REQUIRE([DEFINE_WYNA_SSE])
   GATBPS_REQUIRE([DEFINE_WYNA_SSE2])
+  GATBPS_REQUIRE([DEFINE_WYNA_VAES])
   GATBPS_REQUIRE([DEFINE_WYNA_WINDOWS_BCRYPT])
   GATBPS_REQUIRE([DEFINE_WYNA_WINDOWS_KERNEL32])
   GATBPS_REQUIRE([DEFINE_WYNA_X86_32])
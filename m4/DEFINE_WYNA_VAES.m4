@@ -0,0 +1,32 @@
+dnl
+dnl Copyright (C) Stealth Software Technologies, Inc.
+dnl
+dnl For the complete copyright information, please see the
+dnl associated README file.
+dnl
+
+AC_DEFUN_ONCE([DEFINE_WYNA_VAES], [
+GATBPS_CALL_COMMENT([$0]m4_if(m4_eval([$# > 0]), [1], [, $@]))
+{ :
+
+  GATBPS_BEFORE([$0], [DEFINE_WYNAS])
+
+  GATBPS_ARG_WYNA(
+    [--with-vaes],
+    [
+      Use the VAES instruction set.
+    ],
+    [
+      Do not use the VAES instruction set.
+    ],
+    [
+      Automatically decide whether to use the VAES instruction set.
+    ],
+    [
+      --with-aes-ni
+      --with-avx-512-f
+      --with-sse
+      --with-sse2
+    ])
+
+}])
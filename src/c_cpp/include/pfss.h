@@ -203,6 +203,21 @@ typedef uint32_t pfss_status;
 PFSS_PUBLIC_C_FUNCTION
 char const * pfss_get_status_name(pfss_status status);
 
+/*----------------------------------------------------------------------
+// pfss_get_aes_backend
+//--------------------------------------------------------------------*/
+
+/*
+ * Returns a string with static storage duration that names the AES
+ * implementation the library uses, such as "aes-ni" or "vaes-512". On
+ * x86 the implementation is chosen at first use from what the CPU
+ * supports, and the PFSS_AES_BACKEND environment variable can name a
+ * different one. See the hardware acceleration section of the manual.
+ */
+
+PFSS_PUBLIC_C_FUNCTION
+char const * pfss_get_aes_backend(void);
+
 /*----------------------------------------------------------------------
 // Logging
 //--------------------------------------------------------------------*/
@@ -254,6 +269,44 @@ typedef uint32_t pfss_endianness;
 #define PFSS_LITTLE_ENDIAN ((pfss_endianness) + 1)
 #define PFSS_BIG_ENDIAN ((pfss_endianness) + 2)
 
+/*----------------------------------------------------------------------
+// pfss_layout
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_layout[]
+[[c_api_pfss_layout]]
+== The `pfss_layout` type
+
+[source,c]
+----
+typedef uint32_t pfss_layout;
+----
+
+The `pfss_layout` type describes how a matrix of range elements with
+one row per key and one column per domain element is laid out in
+memory.
+
+The layout constants and their meanings are listed below.
+
+* 0 (0x0) `PFSS_KEY_MAJOR` +
+The elements for each key are contiguous.
+The element for key stem:[i] and domain element stem:[j] is at index
+stem:[i \cdot n + j], where stem:[n] is the number of domain elements.
+
+* 1 (0x1) `PFSS_POINT_MAJOR` +
+The elements for each domain element are contiguous.
+The element for key stem:[i] and domain element stem:[j] is at index
+stem:[j \cdot k + i], where stem:[k] is the number of keys.
+
+end::c_api_pfss_layout[]
+*/
+
+typedef uint32_t pfss_layout;
+
+#define PFSS_KEY_MAJOR ((pfss_layout) + 0)
+#define PFSS_POINT_MAJOR ((pfss_layout) + 1)
+
 /*----------------------------------------------------------------------
 // pfss_gen_sizes
 //--------------------------------------------------------------------*/
@@ -331,6 +384,22 @@ pfss_status pfss_map_gen(
   uint8_t *       key2_blobs,
   uint8_t const * rand_bufs
 );
+
+pfss_status pfss_map_gen_mt(
+  uint32_t        domain_bits,
+  uint32_t        range_bits,
+  uint8_t const * alphas,
+  uint32_t        alphas_count,
+  uint32_t        alpha_size,
+  pfss_endianness alpha_endianness,
+  uint8_t const * betas,
+  uint32_t        beta_size,
+  pfss_endianness beta_endianness,
+  uint8_t *       key1_blobs,
+  uint8_t *       key2_blobs,
+  uint8_t const * rand_bufs,
+  uint32_t        thread_count
+);
 ----
 
 The `pfss_map_gen` function creates FSS key pairs for each of the
@@ -351,6 +420,12 @@ Similarly, `rand_bufs` should be a container consisting of
 The function returns `PFSS_OK` upon success, or another status code upon
 failure.
 
+The `pfss_map_gen_mt` function is the same as `pfss_map_gen` except
+that it splits the key pairs among `thread_count` threads, which should
+be positive.
+Both functions produce the same key pairs from the same `rand_bufs`,
+regardless of the number of threads.
+
 end::c_api_pfss_map_gen[]
 */
 
@@ -369,6 +444,22 @@ pfss_status pfss_map_gen(
     uint8_t * key2_blobs,
     uint8_t const * rand_bufs);
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_gen_mt(
+    uint32_t domain_bits,
+    uint32_t range_bits,
+    uint8_t const * alphas,
+    uint32_t alphas_count,
+    uint32_t alpha_size,
+    pfss_endianness alpha_endianness,
+    uint8_t const * betas,
+    uint32_t beta_size,
+    pfss_endianness beta_endianness,
+    uint8_t * key1_blobs,
+    uint8_t * key2_blobs,
+    uint8_t const * rand_bufs,
+    uint32_t thread_count);
+
 /*----------------------------------------------------------------------
 // pfss_key
 //--------------------------------------------------------------------*/
@@ -460,6 +551,352 @@ PFSS_PUBLIC_C_FUNCTION
 pfss_status
 pfss_get_range_bits(pfss_key const * key, uint32_t * range_bits);
 
+/*----------------------------------------------------------------------
+// pfss_key_set
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_key_set[]
+[[c_api_pfss_key_set]]
+== The `pfss_key_set` type
+
+[source,c]
+----
+typedef struct pfss_key_set pfss_key_set;
+----
+
+The `pfss_key_set` type represents a set of keys that have been parsed
+together from key blobs that all have the same number of domain bits
+and the same number of range bits.
+The keys are stored together in one block of memory instead of being
+allocated one by one, which makes large sets faster to parse and to
+destroy.
+
+The `pfss_eval_all_sum_key_set`, `pfss_eval_all_dot_key_set`, and
+`pfss_map_eval_key_set` functions take a context and a key set and are
+otherwise the same as `pfss_eval_all_sum_ctx`, `pfss_eval_all_dot_ctx`,
+and `pfss_map_eval_keys_ctx` with the keys of the set in order.
+Single keys of the set can be passed to any other function that takes
+a `pfss_key const *` (see <<c_api_pfss_get_key_set_key>>).
+
+end::c_api_pfss_key_set[]
+*/
+
+typedef struct pfss_key_set pfss_key_set;
+
+/*----------------------------------------------------------------------
+// pfss_parse_keys
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_parse_keys[]
+[[c_api_pfss_parse_keys]]
+== The `pfss_parse_keys` function
+
+[source,c]
+----
+pfss_status pfss_parse_keys(
+  pfss_key_set * * p_key_set,
+  uint8_t const *  key_blobs,
+  uint32_t         keys_count,
+  uint32_t         key_blob_size,
+  uint32_t         thread_count
+);
+----
+
+The `pfss_parse_keys` function parses `keys_count` key blobs of
+`key_blob_size` bytes each, stored one after another in `key_blobs`,
+into a new key set and sets `*p_key_set` to point to it.
+All key blobs should have the same number of domain bits and the same
+number of range bits.
+The work is split across up to `thread_count` threads.
+
+end::c_api_pfss_parse_keys[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_parse_keys(
+    pfss_key_set ** p_key_set,
+    uint8_t const * key_blobs,
+    uint32_t keys_count,
+    uint32_t key_blob_size,
+    uint32_t thread_count);
+
+/*----------------------------------------------------------------------
+// pfss_destroy_key_set
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_destroy_key_set[]
+[[c_api_pfss_destroy_key_set]]
+== The `pfss_destroy_key_set` function
+
+[source,c]
+----
+pfss_status pfss_destroy_key_set(
+  pfss_key_set * key_set
+);
+----
+
+The `pfss_destroy_key_set` function destroys a key set and all of its
+keys.
+
+end::c_api_pfss_destroy_key_set[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_destroy_key_set(pfss_key_set * key_set);
+
+/*----------------------------------------------------------------------
+// pfss_get_key_set_key
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_get_key_set_key[]
+[[c_api_pfss_get_key_set_key]]
+== The `pfss_get_key_set_key` function
+
+[source,c]
+----
+pfss_status pfss_get_key_set_key(
+  pfss_key_set const * key_set,
+  uint32_t             i,
+  pfss_key const * *   p_key
+);
+----
+
+The `pfss_get_key_set_key` function sets `*p_key` to point to key `i`
+of a key set.
+The key belongs to the key set and stays valid until the key set is
+destroyed.
+It should not be passed to `pfss_destroy_key`.
+
+end::c_api_pfss_get_key_set_key[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_get_key_set_key(pfss_key_set const * key_set,
+                                 uint32_t i,
+                                 pfss_key const ** p_key);
+
+/*----------------------------------------------------------------------
+// pfss_key_store_size
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_key_store_size[]
+[[c_api_pfss_key_store_size]]
+== The `pfss_key_store_size` function
+
+[source,c]
+----
+pfss_status pfss_key_store_size(
+  uint32_t   domain_bits,
+  uint32_t   range_bits,
+  uint32_t   keys_count,
+  uint64_t * store_size
+);
+----
+
+The `pfss_key_store_size` function sets `*store_size` to the number of
+bytes that `pfss_write_key_store` needs to store `keys_count` keys with
+`domain_bits` domain bits and `range_bits` range bits.
+
+A key store is a byte image of a key set that can be saved to a file
+and later opened in place with `pfss_open_key_store`, typically after
+mapping the file into memory with `mmap` or a similar function.
+It consists of a 64-byte header followed by one record per key.
+Every record has the same size, which is a multiple of 64 bytes, and
+holds the key both in the form that the library evaluates it in and
+as a key blob.
+
+end::c_api_pfss_key_store_size[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_key_store_size(uint32_t domain_bits,
+                                uint32_t range_bits,
+                                uint32_t keys_count,
+                                uint64_t * store_size);
+
+/*----------------------------------------------------------------------
+// pfss_write_key_store
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_write_key_store[]
+[[c_api_pfss_write_key_store]]
+== The `pfss_write_key_store` function
+
+[source,c]
+----
+pfss_status pfss_write_key_store(
+  uint8_t const * key_blobs,
+  uint32_t        keys_count,
+  uint32_t        key_blob_size,
+  uint8_t *       store,
+  uint64_t        store_size,
+  uint32_t        thread_count
+);
+----
+
+The `pfss_write_key_store` function writes a key store that holds the
+`keys_count` key blobs of `key_blob_size` bytes each, stored one after
+another in `key_blobs`, to the `store_size` bytes pointed to by
+`store`.
+All key blobs should have the same number of domain bits and the same
+number of range bits, and `store_size` should be at least the size
+given by `pfss_key_store_size`.
+The work is split across up to `thread_count` threads.
+
+end::c_api_pfss_write_key_store[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_write_key_store(uint8_t const * key_blobs,
+                                 uint32_t keys_count,
+                                 uint32_t key_blob_size,
+                                 uint8_t * store,
+                                 uint64_t store_size,
+                                 uint32_t thread_count);
+
+/*----------------------------------------------------------------------
+// pfss_open_key_store
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_open_key_store[]
+[[c_api_pfss_open_key_store]]
+== The `pfss_open_key_store` function
+
+[source,c]
+----
+pfss_status pfss_open_key_store(
+  pfss_key_set * * p_key_set,
+  uint8_t const *  store,
+  uint64_t         store_size,
+  uint32_t         thread_count
+);
+----
+
+The `pfss_open_key_store` function opens the key store in the
+`store_size` bytes pointed to by `store` as a new key set and sets
+`*p_key_set` to point to it.
+
+If the key store was written by a build of the library with the same
+in-memory key layout, and `store` is suitably aligned (any address
+returned by `mmap` is), the keys of the set are evaluated directly from
+the store without being parsed or copied, and only the header and the
+first record are read before the function returns.
+Otherwise, the key blobs of the store are parsed into the set on up to
+`thread_count` threads, as by `pfss_parse_keys`.
+Either way, the store must not be modified or unmapped until the key
+set is destroyed with `pfss_destroy_key_set`.
+
+The records of a key store are not checked one by one when it is
+opened in place, so a key store should only be opened from a source
+that is trusted as much as the key blobs it was written from.
+
+end::c_api_pfss_open_key_store[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_open_key_store(pfss_key_set ** p_key_set,
+                                uint8_t const * store,
+                                uint64_t store_size,
+                                uint32_t thread_count);
+
+/*----------------------------------------------------------------------
+// pfss_eval_context
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_context[]
+[[c_api_pfss_eval_context]]
+== The `pfss_eval_context` type
+
+[source,c]
+----
+typedef struct pfss_eval_context pfss_eval_context;
+----
+
+The `pfss_eval_context` type holds state that can be reused across
+evaluation calls: a pool of worker threads, and for each thread the
+objects and buffers that it evaluates keys with.
+The pool starts empty and grows to the largest `thread_count` that has
+been used with the context.
+
+The `pfss_eval_all_ctx`, `pfss_eval_range_ctx`,
+`pfss_eval_all_sum_ctx`, `pfss_eval_all_dot_ctx`, `pfss_map_eval_ctx`,
+`pfss_map_eval_sorted_ctx`, `pfss_map_eval_keys_ctx`, and
+`pfss_map_eval_reduce_sum_ctx` functions take a context as their first
+parameter and are otherwise the same as `pfss_eval_all_mt`,
+`pfss_eval_range`, `pfss_eval_all_sum`, `pfss_eval_all_dot`,
+`pfss_map_eval_mt`, `pfss_map_eval_sorted`, `pfss_map_eval_keys`, and
+`pfss_map_eval_reduce_sum_mt`.
+The functions without a context set up and tear down the same state on
+every call, which can dominate the cost of evaluating keys with small
+domains.
+
+Calls that share a context are safe to make from multiple threads at
+the same time, but they take turns.
+
+end::c_api_pfss_eval_context[]
+*/
+
+typedef struct pfss_eval_context pfss_eval_context;
+
+/*----------------------------------------------------------------------
+// pfss_eval_context_create
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_context_create[]
+[[c_api_pfss_eval_context_create]]
+== The `pfss_eval_context_create` function
+
+[source,c]
+----
+pfss_status pfss_eval_context_create(
+  pfss_eval_context * * p_context
+);
+----
+
+The `pfss_eval_context_create` function creates a context and sets
+`*p_context` to point to it.
+
+end::c_api_pfss_eval_context_create[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_context_create(pfss_eval_context ** p_context);
+
+/*----------------------------------------------------------------------
+// pfss_eval_context_destroy
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_context_destroy[]
+[[c_api_pfss_eval_context_destroy]]
+== The `pfss_eval_context_destroy` function
+
+[source,c]
+----
+pfss_status pfss_eval_context_destroy(
+  pfss_eval_context * context
+);
+----
+
+The `pfss_eval_context_destroy` function destroys a context and stops
+its worker threads.
+No call that uses the context may be in progress.
+
+end::c_api_pfss_eval_context_destroy[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_context_destroy(pfss_eval_context * context);
+
 /*----------------------------------------------------------------------
 // pfss_eval
 //--------------------------------------------------------------------*/
@@ -830,6 +1267,101 @@ pfss_status pfss_map_eval(
     uint32_t y_size,
     pfss_endianness y_endianness);
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_mt(
+    pfss_key const * key,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_ctx(
+    pfss_eval_context * context,
+    pfss_key const * key,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_sorted(
+    pfss_key const * key,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    int xs_are_sorted,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_sorted_ctx(
+    pfss_eval_context * context,
+    pfss_key const * key,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    int xs_are_sorted,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_keys(
+    pfss_key const * const * keys,
+    uint32_t keys_count,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    pfss_layout ys_layout,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_keys_ctx(
+    pfss_eval_context * context,
+    pfss_key const * const * keys,
+    uint32_t keys_count,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    pfss_layout ys_layout,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_key_set(
+    pfss_eval_context * context,
+    pfss_key_set const * key_set,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    pfss_layout ys_layout,
+    uint32_t thread_count);
+
 /*----------------------------------------------------------------------
 // pfss_map_eval_reduce_sum
 //--------------------------------------------------------------------*/
@@ -845,6 +1377,31 @@ pfss_status pfss_map_eval_reduce_sum(
     uint32_t y_size,
     pfss_endianness y_endianness);
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_reduce_sum_mt(
+    pfss_key const * key,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * y,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_reduce_sum_ctx(
+    pfss_eval_context * context,
+    pfss_key const * key,
+    uint8_t const * xs,
+    uint64_t xs_count,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * y,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
 /*----------------------------------------------------------------------
 // pfss_eval_all
 //--------------------------------------------------------------------*/
@@ -859,6 +1416,258 @@ pfss_status pfss_eval_all(
     uint32_t y_size,
     pfss_endianness y_endianness);
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_mt(
+    pfss_key const * key,
+    uint8_t const * xp,
+    uint32_t xp_bits,
+    pfss_endianness xp_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_ctx(
+    pfss_eval_context * context,
+    pfss_key const * key,
+    uint8_t const * xp,
+    uint32_t xp_bits,
+    pfss_endianness xp_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+/*----------------------------------------------------------------------
+// pfss_eval_all_packed_ctx
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_all_packed_ctx[]
+[[c_api_pfss_eval_all_packed_ctx]]
+== The `pfss_eval_all_packed_ctx` function
+
+[source,c]
+----
+pfss_status pfss_eval_all_packed_ctx(
+  pfss_eval_context * context,
+  pfss_key const *    key,
+  uint8_t const *     xp,
+  uint32_t            xp_bits,
+  pfss_endianness     xp_endianness,
+  uint8_t *           ys,
+  uint32_t            thread_count
+);
+----
+
+The `pfss_eval_all_packed_ctx` function is the same as
+`pfss_eval_all_ctx`, except that `ys` is a packed array of
+`range_bits`-bit unsigned integers instead of an array of whole bytes
+per element, where `range_bits` is the number of range bits in `key`.
+Element `i` of a packed array occupies bits `i * range_bits` through
+`i * range_bits + range_bits - 1` of the array, where bit `j` of the
+array is bit `j % 8` of byte `j / 8`, and the least significant bit of
+the element comes first.
+The unused bits of the last byte are left as they were.
+For example, with 1 range bit, the output for 2^20^ domain elements
+takes 128 KiB instead of 1 MiB.
+
+The number of range bits in `key` must be at most 64, and the number of
+bits in the array must be representable by a `size_t`.
+Otherwise, the function fails with `PFSS_INVALID_ARGUMENT` or
+`PFSS_DOMAIN_OVERFLOW`, respectively.
+
+end::c_api_pfss_eval_all_packed_ctx[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_packed_ctx(pfss_eval_context * context,
+                                     pfss_key const * key,
+                                     uint8_t const * xp,
+                                     uint32_t xp_bits,
+                                     pfss_endianness xp_endianness,
+                                     uint8_t * ys,
+                                     uint32_t thread_count);
+
+/*----------------------------------------------------------------------
+// pfss_eval_range
+//--------------------------------------------------------------------*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_range(
+    pfss_key const * key,
+    uint8_t const * x_lo,
+    uint8_t const * x_hi,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_range_ctx(
+    pfss_eval_context * context,
+    pfss_key const * key,
+    uint8_t const * x_lo,
+    uint8_t const * x_hi,
+    uint32_t x_size,
+    pfss_endianness x_endianness,
+    uint8_t * ys,
+    uint32_t y_size,
+    pfss_endianness y_endianness,
+    uint32_t thread_count);
+
+/*----------------------------------------------------------------------
+// pfss_eval_all_cursor
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_all_cursor[]
+[[c_api_pfss_eval_all_cursor]]
+== The `pfss_eval_all_cursor` type
+
+[source,c]
+----
+typedef struct pfss_eval_all_cursor pfss_eval_all_cursor;
+----
+
+The `pfss_eval_all_cursor` type walks the same domain elements as
+`pfss_eval_all` and hands out their evaluation results a chunk at a
+time, so that a caller that only folds over the results does not need
+room for all of them at once.
+Memory use is bounded by the chunk size that the caller asks for plus
+a small amount that depends on the depth of the tree, not on the size
+of the domain.
+
+A cursor is not safe to use from more than one thread at a time, but
+different cursors can be used concurrently, including cursors over
+different parts of the same key.
+
+end::c_api_pfss_eval_all_cursor[]
+*/
+
+typedef struct pfss_eval_all_cursor pfss_eval_all_cursor;
+
+/*----------------------------------------------------------------------
+// pfss_eval_all_cursor_create
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_all_cursor_create[]
+[[c_api_pfss_eval_all_cursor_create]]
+== The `pfss_eval_all_cursor_create` function
+
+[source,c]
+----
+pfss_status pfss_eval_all_cursor_create(
+  pfss_eval_all_cursor * * p_cursor,
+  pfss_key const *         key,
+  uint8_t const *          xp,
+  uint32_t                 xp_bits,
+  pfss_endianness          xp_endianness
+);
+----
+
+The `pfss_eval_all_cursor_create` function creates a cursor over the
+domain elements that `pfss_eval_all` would evaluate `key` at for the
+same `xp`, `xp_bits`, and `xp_endianness`, and sets `*p_cursor` to
+point to it.
+The cursor starts at the first of these domain elements.
+The key must stay valid until the cursor is destroyed.
+Like `pfss_eval_all`, the function requires the number of domain bits
+in `key` to be at most the number of bits in a `size_t`, and fails
+with `PFSS_DOMAIN_OVERFLOW` otherwise.
+
+end::c_api_pfss_eval_all_cursor_create[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_cursor_create(pfss_eval_all_cursor ** p_cursor,
+                            pfss_key const * key,
+                            uint8_t const * xp,
+                            uint32_t xp_bits,
+                            pfss_endianness xp_endianness);
+
+/*----------------------------------------------------------------------
+// pfss_eval_all_cursor_next
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_all_cursor_next[]
+[[c_api_pfss_eval_all_cursor_next]]
+== The `pfss_eval_all_cursor_next` function
+
+[source,c]
+----
+pfss_status pfss_eval_all_cursor_next(
+  pfss_eval_all_cursor * cursor,
+  uint8_t *              ys,
+  uint32_t               ys_count,
+  uint32_t               y_size,
+  pfss_endianness        y_endianness,
+  uint32_t               thread_count,
+  uint32_t *             p_ys_count
+);
+----
+
+The `pfss_eval_all_cursor_next` function evaluates the key of a cursor
+at up to `ys_count` domain elements, starting where the cursor is,
+writes the results to `ys` in order, moves the cursor past them, and
+sets `*p_ys_count` to the number of results written.
+`ys` is treated as an array of unsigned integers, each consisting of
+`y_size` bytes in `y_endianness` byte order, the same way as for
+`pfss_eval_all`, except that the first result always goes to the first
+element.
+Once every domain element of the cursor has been evaluated, the
+function sets `*p_ys_count` to zero.
+
+Each chunk is evaluated like an interval of `pfss_eval_range`, on up to
+`thread_count` threads.
+The threads are kept by the cursor between calls.
+A chunk of a few thousand results or more makes the cost of starting
+each chunk at the top of the tree negligible.
+
+end::c_api_pfss_eval_all_cursor_next[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_cursor_next(pfss_eval_all_cursor * cursor,
+                                      uint8_t * ys,
+                                      uint32_t ys_count,
+                                      uint32_t y_size,
+                                      pfss_endianness y_endianness,
+                                      uint32_t thread_count,
+                                      uint32_t * p_ys_count);
+
+/*----------------------------------------------------------------------
+// pfss_eval_all_cursor_destroy
+//--------------------------------------------------------------------*/
+
+/*
+tag::c_api_pfss_eval_all_cursor_destroy[]
+[[c_api_pfss_eval_all_cursor_destroy]]
+== The `pfss_eval_all_cursor_destroy` function
+
+[source,c]
+----
+pfss_status pfss_eval_all_cursor_destroy(
+  pfss_eval_all_cursor * cursor
+);
+----
+
+The `pfss_eval_all_cursor_destroy` function destroys a cursor.
+It does not destroy the key of the cursor.
+
+end::c_api_pfss_eval_all_cursor_destroy[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_cursor_destroy(pfss_eval_all_cursor * cursor);
+
 /*----------------------------------------------------------------------
 // pfss_eval_all_sum
 //--------------------------------------------------------------------*/
@@ -871,6 +1680,55 @@ pfss_status pfss_eval_all_sum(pfss_key const * const * keys,
                               pfss_endianness y_endianness,
                               uint32_t thread_count);
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_sum_ctx(pfss_eval_context * context,
+                                  pfss_key const * const * keys,
+                                  uint32_t keys_count,
+                                  uint8_t * ys,
+                                  uint32_t y_size,
+                                  pfss_endianness y_endianness,
+                                  uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_sum_key_set(pfss_eval_context * context,
+                                      pfss_key_set const * key_set,
+                                      uint8_t * ys,
+                                      uint32_t y_size,
+                                      pfss_endianness y_endianness,
+                                      uint32_t thread_count);
+
+/*
+tag::c_api_pfss_eval_all_sum_packed_ctx[]
+[[c_api_pfss_eval_all_sum_packed_ctx]]
+== The `pfss_eval_all_sum_packed_ctx` function
+
+[source,c]
+----
+pfss_status pfss_eval_all_sum_packed_ctx(
+  pfss_eval_context *      context,
+  pfss_key const * const * keys,
+  uint32_t                 keys_count,
+  uint8_t *                ys,
+  uint32_t                 thread_count
+);
+----
+
+The `pfss_eval_all_sum_packed_ctx` function is the same as
+`pfss_eval_all_sum_ctx`, except that `ys` is a packed array of
+`range_bits`-bit unsigned integers, as described for
+`pfss_eval_all_packed_ctx`.
+
+end::c_api_pfss_eval_all_sum_packed_ctx[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_sum_packed_ctx(pfss_eval_context * context,
+                             pfss_key const * const * keys,
+                             uint32_t keys_count,
+                             uint8_t * ys,
+                             uint32_t thread_count);
+
 /*----------------------------------------------------------------------
 // pfss_eval_all_dot
 //--------------------------------------------------------------------*/
@@ -886,6 +1744,67 @@ pfss_status pfss_eval_all_dot(pfss_key const * const * keys,
                               pfss_endianness z_endianness,
                               uint32_t thread_count);
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_dot_ctx(pfss_eval_context * context,
+                                  pfss_key const * const * keys,
+                                  uint32_t keys_count,
+                                  uint8_t const * ys,
+                                  uint32_t y_size,
+                                  pfss_endianness y_endianness,
+                                  uint8_t * zs,
+                                  uint32_t z_size,
+                                  pfss_endianness z_endianness,
+                                  uint32_t thread_count);
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_dot_key_set(pfss_eval_context * context,
+                                      pfss_key_set const * key_set,
+                                      uint8_t const * ys,
+                                      uint32_t y_size,
+                                      pfss_endianness y_endianness,
+                                      uint8_t * zs,
+                                      uint32_t z_size,
+                                      pfss_endianness z_endianness,
+                                      uint32_t thread_count);
+
+/*
+tag::c_api_pfss_eval_all_dot_packed_ctx[]
+[[c_api_pfss_eval_all_dot_packed_ctx]]
+== The `pfss_eval_all_dot_packed_ctx` function
+
+[source,c]
+----
+pfss_status pfss_eval_all_dot_packed_ctx(
+  pfss_eval_context *      context,
+  pfss_key const * const * keys,
+  uint32_t                 keys_count,
+  uint8_t const *          ys,
+  uint8_t *                zs,
+  uint32_t                 z_size,
+  pfss_endianness          z_endianness,
+  uint32_t                 thread_count
+);
+----
+
+The `pfss_eval_all_dot_packed_ctx` function is the same as
+`pfss_eval_all_dot_ctx`, except that `ys` is a packed array of
+`range_bits`-bit unsigned integers, as described for
+`pfss_eval_all_packed_ctx`.
+
+end::c_api_pfss_eval_all_dot_packed_ctx[]
+*/
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_dot_packed_ctx(pfss_eval_context * context,
+                             pfss_key const * const * keys,
+                             uint32_t keys_count,
+                             uint8_t const * ys,
+                             uint8_t * zs,
+                             uint32_t z_size,
+                             pfss_endianness z_endianness,
+                             uint32_t thread_count);
+
 /*--------------------------------------------------------------------*/
 
 #endif /* PFSS_H */
@@ -47,6 +47,26 @@
 
 namespace pfss {
 
+template<class BlockType>
+struct bgi1_cache_entry {
+  BlockType s;
+  bool t;
+};
+
+//
+// The buffers that bgi1_common::eval_all works in. eval_all only ever
+// grows them, so a caller that expands many trees can keep one of
+// these around instead of allocating fresh buffers for every call.
+// The contents between calls are meaningless.
+//
+
+template<class BlockType>
+struct bgi1_eval_all_scratch {
+  std::vector<BlockType> ss;
+  std::vector<unsigned char> ts;
+  std::vector<bgi1_cache_entry<BlockType>> path;
+};
+
 template<class DomainType,
          class RangeType,
          class BlockType,
@@ -145,6 +165,37 @@ struct bgi1_common {
     std::array<bool, 2> tcw;
   };
 
+  //
+  // The form of a cw_type that evaluation uses. scw[j] is the scw block
+  // with its MSB replaced by tcw[j], which is the whole correction that
+  // a child on side j gets when its parent's control bit is set. This
+  // lets correct pick the correction with an index and apply it with a
+  // mask instead of branching on the control bit and calling set_msb
+  // on every level, which keeps random-point workloads free of
+  // unpredictable branches. Keys hold both forms: cw is what gets
+  // serialized and pcw is what gets evaluated.
+  //
+
+  struct prepared_cw_type {
+    block_type scw[2];
+  };
+
+  static prepared_cw_type prepare_cw(cw_type const & cw) noexcept {
+    prepared_cw_type p;
+    p.scw[L] = cw.scw.set_msb(cw.tcw[L]);
+    p.scw[R] = cw.scw.set_msb(cw.tcw[R]);
+    return p;
+  }
+
+  template<class CwTypeContainer, class PreparedCwTypeContainer>
+  static void prepare_cws(CwTypeContainer const & cw,
+                          PreparedCwTypeContainer & pcw) noexcept {
+    assert(cw.size() == pcw.size());
+    for (decltype(cw.size()) i = 0; i != cw.size(); ++i) {
+      pcw[i] = prepare_cw(cw[i]);
+    }
+  }
+
   static constexpr std::array<unsigned char, 1> key_header() noexcept {
     return {0};
   }
@@ -219,6 +270,14 @@ struct bgi1_common {
         *out++ = d;
       }
     }
+    return serialize_cw_last(range_bits, cw_last, out);
+  }
+
+  template<class RangeTypeContainer, class ContiguousByteOutputIt>
+  static ContiguousByteOutputIt
+  serialize_cw_last(int const range_bits,
+                    RangeTypeContainer const & cw_last,
+                    ContiguousByteOutputIt out) noexcept {
     if (range_bits % uchar_bits != 0) {
       int i = 0;
       for (range_type const & x : cw_last) {
@@ -333,11 +392,57 @@ struct bgi1_common {
     return pi(x) ^ x;
   }
 
+  //
+  // Computes out[j] = pi(in[j]) ^ in[j] for n blocks with one batched
+  // call to pi, so the rand_perm can keep several blocks in flight. The
+  // caller flips the MSB of in[j] beforehand for prg<R>. in and out
+  // must not overlap.
+  //
+
+  static void prg_n(rand_perm_type & pi,
+                    block_type const * const in,
+                    block_type * const out,
+                    std::size_t const n) {
+    pi(in, out, n);
+    for (std::size_t j = 0; j != n; ++j) {
+      // Correlation robustness (GKWY-2019-074).
+      out[j] ^= in[j];
+    }
+  }
+
+  // Computes a = prg<L>(pi, x) and b = prg<R>(pi, x) together.
+  static void prg_lr(rand_perm_type & pi,
+                     block_type const & x,
+                     block_type & a,
+                     block_type & b) {
+    block_type const in[2] = {x, x.flip_msb()};
+    block_type out[2];
+    prg_n(pi, in, out, 2);
+    a = out[0];
+    b = out[1];
+  }
+
   static block_type zero_msb(block_type x) {
     x = x.set_msb(0);
     return x;
   }
 
+  //
+  // Applies the correction word of one level of the GGM tree to a
+  // child seed s that was just computed as prg<x_i>(pi, parent), where
+  // t is the parent's control bit, and then splits the corrected seed
+  // into its new seed and control bit.
+  //
+
+  static void correct(prepared_cw_type const & cw,
+                      bool const x_i,
+                      block_type & s,
+                      bool & t) noexcept {
+    s ^= cw.scw[x_i].masked(t);
+    t = s.get_msb();
+    s = s.set_msb(0);
+  }
+
   // TODO:
   // For line 12, there's a question of whether using a lookup table
   // versus ternary expressions gives more performance.
@@ -369,10 +474,16 @@ struct bgi1_common {
     for (int i = 0; i != v; ++i) {
       block_type s0[2], s1[2];
       bool t0[2], t1[2];
-      s0[L] = prg<L>(pi, s[0]);
-      s0[R] = prg<R>(pi, s[0]);
-      s1[L] = prg<L>(pi, s[1]);
-      s1[R] = prg<R>(pi, s[1]);
+      {
+        block_type const in[4] = {
+            s[0], s[0].flip_msb(), s[1], s[1].flip_msb()};
+        block_type out[4];
+        prg_n(pi, in, out, 4);
+        s0[L] = out[0];
+        s0[R] = out[1];
+        s1[L] = out[2];
+        s1[R] = out[3];
+      }
       t0[L] = s0[L].get_msb();
       t0[R] = s0[R].get_msb();
       t1[L] = s1[L].get_msb();
@@ -393,6 +504,7 @@ struct bgi1_common {
         key[j].cw[i].scw = scw;
         key[j].cw[i].tcw[L] = tcw[L];
         key[j].cw[i].tcw[R] = tcw[R];
+        key[j].pcw[i] = prepare_cw(key[j].cw[i]);
       }
       // Line 12.
       // Note that although t[0] and t[1] are opposites for the first loop
@@ -406,43 +518,204 @@ struct bgi1_common {
       // Line 14. (End of loop).
     }
     // Line 15.
+    block_type prgs[4];
+    if (prg_convert) {
+      block_type const in[4] = {
+          s[0], s[0].flip_msb(), s[1], s[1].flip_msb()};
+      prg_n(pi, in, prgs, 4);
+    }
+    gen_cw_last(domain_bits,
+                range_bits,
+                n_minus_v,
+                v,
+                alpha,
+                beta,
+                s,
+                t[1],
+                prgs,
+                key[0].cw_last);
+    for (int i = 0; i != (1 << n_minus_v); ++i) {
+      key[1].cw_last[i] = key[0].cw_last[i];
+    }
+    // Line 16 doesn't happen because we already constructed the keys on
+    // Lines 2, 11, and 15.
+  }
+
+  //
+  // Computes the cw_last values on line 15 of gen from the final seeds
+  // s of both parties and the final control bit t1 of party 1. When
+  // prg_convert is set, prgs holds prg<L> and prg<R> of s[0] followed
+  // by the same for s[1].
+  //
+
+  template<class Alpha, class RangeTypeContainer>
+  static void gen_cw_last(int const domain_bits,
+                          int const range_bits,
+                          int const n_minus_v,
+                          int const v,
+                          Alpha const & alpha,
+                          range_type const beta,
+                          block_type const * const s,
+                          bool const t1,
+                          block_type const * const prgs,
+                          RangeTypeContainer & cw_last) noexcept {
     int cw_last_i = 0;
     for (int i = v; i != domain_bits; ++i) {
       cw_last_i <<= 1;
       cw_last_i |= getbitx(alpha, domain_bits - 1 - i);
     }
-    block_type prg_L_s0;
-    block_type prg_R_s0;
-    block_type prg_L_s1;
-    block_type prg_R_s1;
-    if (prg_convert) {
-      prg_L_s0 = prg<L>(pi, s[0]);
-      prg_R_s0 = prg<R>(pi, s[0]);
-      prg_L_s1 = prg<L>(pi, s[1]);
-      prg_R_s1 = prg<R>(pi, s[1]);
-    }
     for (int i = 0; i != (1 << n_minus_v); ++i) {
       if (prg_convert) {
-        key[0].cw_last[i] =
+        cw_last[i] =
             static_cast<nice_range_type>(
                 i == cw_last_i ? beta : static_cast<range_type>(0))
-            - convert(range_bits, n_minus_v, prg_L_s0, prg_R_s0, i)
-            + convert(range_bits, n_minus_v, prg_L_s1, prg_R_s1, i);
+            - convert(range_bits, n_minus_v, prgs[0], prgs[1], i)
+            + convert(range_bits, n_minus_v, prgs[2], prgs[3], i);
       } else {
-        key[0].cw_last[i] =
+        cw_last[i] =
             static_cast<nice_range_type>(
                 i == cw_last_i ? beta : static_cast<range_type>(0))
             - convert(range_bits, n_minus_v, s[0], i)
             + convert(range_bits, n_minus_v, s[1], i);
       }
-      if (t[1]) {
-        key[0].cw_last[i] = -key[0].cw_last[i];
+      if (t1) {
+        cw_last[i] = -cw_last[i];
+      }
+      cw_last[i] &= get_mask<range_type>(range_bits);
+    }
+  }
+
+  static constexpr std::size_t gen_batch = 8;
+
+  //
+  // Does the same as gen for count <= gen_batch keys at once, except
+  // that each pair of keys is written straight into its blobs instead
+  // of into key_type objects. The keys move down the tree in lockstep,
+  // so the PRG calls of all of them for one level go through one
+  // batched call. seeds[2 * k] and seeds[2 * k + 1] are the two blocks
+  // that gen would draw from its rng for key k, and alphas[k] and
+  // betas[k] are its domain slot and range value.
+  //
+
+  template<class Alphas>
+  static void gen_n(int const domain_bits,
+                    int const range_bits,
+                    int const n_minus_v,
+                    int const v,
+                    std::size_t const count,
+                    Alphas const & alphas,
+                    range_type const * const betas,
+                    block_type const * const seeds,
+                    rand_perm_type & pi,
+                    unsigned char * const key1_blobs,
+                    unsigned char * const key2_blobs) {
+    assert(count <= gen_batch);
+    std::size_t const blob_size =
+        key_blob_size(domain_bits, range_bits, n_minus_v, v);
+    std::size_t const block_size = block_type().size();
+    std::size_t const tcw_size = bits_to_bytes(v);
+    std::size_t const s_offset = key_header().size() + 2;
+    std::size_t const scw_offset = s_offset + block_size;
+    std::size_t const party_offset = scw_offset + v * block_size;
+    std::size_t const tcw_offset = party_offset + 1;
+    std::size_t const cw_last_offset = tcw_offset + 2 * tcw_size;
+    unsigned char * const blobs[2] = {key1_blobs, key2_blobs};
+    block_type s[gen_batch][2];
+    bool t[gen_batch][2];
+    // Lines 2 and 3.
+    for (std::size_t k = 0; k != count; ++k) {
+      for (int j = 0; j != 2; ++j) {
+        unsigned char * const blob = blobs[j] + k * blob_size;
+        auto const h = key_header();
+        unsigned char * const p = std::copy(h.cbegin(), h.cend(), blob);
+        serialize_integer(uchar_bits,
+                          range_bits,
+                          serialize_integer(uchar_bits, domain_bits, p));
+        s[k][j] = zero_msb(seeds[2 * k + j]);
+        s[k][j].serialize(blob + s_offset);
+        blob[party_offset] = static_cast<unsigned char>(j);
+        std::fill(blob + tcw_offset, blob + blob_size, 0);
+        t[k][j] = j != 0;
+      }
+    }
+    // Line 4.
+    std::array<block_type, 4 * gen_batch> in;
+    std::array<block_type, 4 * gen_batch> out;
+    for (int i = 0; i != v; ++i) {
+      for (std::size_t k = 0; k != count; ++k) {
+        in[4 * k + 0] = s[k][0];
+        in[4 * k + 1] = s[k][0].flip_msb();
+        in[4 * k + 2] = s[k][1];
+        in[4 * k + 3] = s[k][1].flip_msb();
+      }
+      prg_n(pi, &in[0], &out[0], 4 * count);
+      std::size_t const tcw_byte =
+          tcw_offset + static_cast<std::size_t>(v - 1 - i) / uchar_bits;
+      int const tcw_bit = (v - 1 - i) % uchar_bits;
+      for (std::size_t k = 0; k != count; ++k) {
+        block_type s0[2], s1[2];
+        bool t0[2], t1[2];
+        s0[L] = out[4 * k + 0];
+        s0[R] = out[4 * k + 1];
+        s1[L] = out[4 * k + 2];
+        s1[R] = out[4 * k + 3];
+        t0[L] = s0[L].get_msb();
+        t0[R] = s0[R].get_msb();
+        t1[L] = s1[L].get_msb();
+        t1[R] = s1[R].get_msb();
+        s0[L] = s0[L].set_msb(0);
+        s0[R] = s0[R].set_msb(0);
+        s1[L] = s1[L].set_msb(0);
+        s1[R] = s1[R].set_msb(0);
+        bool const alpha_i = getbitx(alphas[k], domain_bits - 1 - i);
+        bool const keep = alpha_i;
+        bool const lose = !alpha_i;
+        block_type const scw = s0[lose] ^ s1[lose];
+        bool tcw[2];
+        tcw[L] = t0[L] ^ t1[L] ^ alpha_i ^ 1;
+        tcw[R] = t0[R] ^ t1[R] ^ alpha_i;
+        // Line 11.
+        for (int j = 0; j != 2; ++j) {
+          unsigned char * const blob = blobs[j] + k * blob_size;
+          scw.serialize(blob + scw_offset + i * block_size);
+          blob[tcw_byte] |= static_cast<unsigned char>(tcw[L] << tcw_bit);
+          blob[tcw_byte + tcw_size] |=
+              static_cast<unsigned char>(tcw[R] << tcw_bit);
+        }
+        // Lines 12 and 13.
+        s[k][0] = t[k][0] ? s0[keep] ^ scw : s0[keep];
+        s[k][1] = t[k][1] ? s1[keep] ^ scw : s1[keep];
+        t[k][0] = t0[keep] ^ (t[k][0] & tcw[keep]);
+        t[k][1] = t1[keep] ^ (t[k][1] & tcw[keep]);
+      }
+    }
+    // Line 15.
+    if (prg_convert) {
+      for (std::size_t k = 0; k != count; ++k) {
+        in[4 * k + 0] = s[k][0];
+        in[4 * k + 1] = s[k][0].flip_msb();
+        in[4 * k + 2] = s[k][1];
+        in[4 * k + 3] = s[k][1].flip_msb();
+      }
+      prg_n(pi, &in[0], &out[0], 4 * count);
+    }
+    std::vector<range_type> cw_last(std::size_t(1) << n_minus_v);
+    for (std::size_t k = 0; k != count; ++k) {
+      gen_cw_last(domain_bits,
+                  range_bits,
+                  n_minus_v,
+                  v,
+                  alphas[k],
+                  betas[k],
+                  s[k],
+                  t[k][1],
+                  &out[4 * k],
+                  cw_last);
+      for (int j = 0; j != 2; ++j) {
+        unsigned char * const blob = blobs[j] + k * blob_size;
+        serialize_cw_last(range_bits, cw_last, blob + cw_last_offset);
       }
-      key[0].cw_last[i] &= get_mask<range_type>(range_bits);
-      key[1].cw_last[i] = key[0].cw_last[i];
     }
-    // Line 16 doesn't happen because we already constructed the keys on
-    // Lines 2, 11, and 15.
   }
 
   template<class KeyType>
@@ -457,18 +730,12 @@ struct bgi1_common {
     bool t = key.party;
     for (int i = 0; i != v; ++i) {
       bool const x_i = getbitx(x, domain_bits - 1 - i);
-      block_type scw = key.cw[i].scw;
       if (x_i == 0) {
         s = prg<L>(pi, s);
       } else {
         s = prg<R>(pi, s);
       }
-      if (t) {
-        scw = scw.set_msb(key.cw[i].tcw[x_i]);
-        s ^= scw;
-      }
-      t = s.get_msb();
-      s = s.set_msb(0);
+      correct(key.pcw[i], x_i, s, t);
     }
     int cw_last_i = 0;
     for (int i = v; i != domain_bits; ++i) {
@@ -477,11 +744,10 @@ struct bgi1_common {
     }
     nice_range_type y;
     if (prg_convert) {
-      y = convert(range_bits,
-                  n_minus_v,
-                  prg<L>(pi, s),
-                  prg<R>(pi, s),
-                  cw_last_i)
+      block_type prg_a;
+      block_type prg_b;
+      prg_lr(pi, s, prg_a, prg_b);
+      y = convert(range_bits, n_minus_v, prg_a, prg_b, cw_last_i)
           + static_cast<nice_range_type>(t ? key.cw_last[cw_last_i] :
                                              0);
     } else {
@@ -496,10 +762,9 @@ struct bgi1_common {
         y & get_mask<nice_range_type>(range_bits));
   }
 
-  struct cache_entry_t {
-    block_type s;
-    bool t;
-  };
+  using cache_entry_t = bgi1_cache_entry<block_type>;
+
+  using eval_all_scratch_t = bgi1_eval_all_scratch<block_type>;
 
   template<class KeyType, class CacheEntryArray, class OutputIt>
   static OutputIt pack_eval(int const domain_bits,
@@ -524,33 +789,424 @@ struct bgi1_common {
     }
     for (int i = b; i != v; ++i) {
       bool const x_i = getbitx(x, domain_bits - 1 - i);
-      block_type scw = key.cw[i].scw;
       if (x_i == 0) {
         s = prg<L>(pi, s);
       } else {
         s = prg<R>(pi, s);
       }
-      if (t) {
-        scw = scw.set_msb(key.cw[i].tcw[x_i]);
-        s ^= scw;
-      }
-      t = s.get_msb();
-      s = s.set_msb(0);
+      correct(key.pcw[i], x_i, s, t);
       cache[i].s = s;
       cache[i].t = t;
     }
     block_type prg_a;
     block_type prg_b;
     if (prg_convert) {
-      prg_a = prg<L>(pi, s);
-      prg_b = prg<R>(pi, s);
+      prg_lr(pi, s, prg_a, prg_b);
+    } else {
+      prg_a = s;
     }
-    for (int i = 0; i != pack_count; ++i) {
+    return finish_leaf(range_bits,
+                       n_minus_v,
+                       key,
+                       prg_a,
+                       prg_b,
+                       t,
+                       0,
+                       pack_count - 1,
+                       out);
+  }
+
+  //
+  // The number of nodes that eval_sorted expands with one batched call
+  // to the PRG.
+  //
+
+  static constexpr std::size_t eval_sorted_batch = 64;
+
+  //
+  // Does the same as eval for each of the count domain elements xs[0],
+  // xs[1], ..., storing each result with ys[j] = y. The elements should
+  // be sorted in ascending order. The tree is expanded one level at a
+  // time, and each node that is on the path to at least one element is
+  // expanded exactly once, so elements that share a prefix share the
+  // work for it. Elements that are out of order give the right results
+  // but share less. The frontier of each level lives in scratch.path,
+  // which needs room for two levels of count nodes.
+  //
+
+  template<class KeyType, class Xs, class Ys>
+  static void eval_sorted(int const domain_bits,
+                          int const range_bits,
+                          int const n_minus_v,
+                          int const v,
+                          KeyType const & key,
+                          Xs const & xs,
+                          std::size_t const count,
+                          rand_perm_type & pi,
+                          eval_all_scratch_t & scratch,
+                          Ys & ys) {
+    if (count == 0) {
+      return;
+    }
+    // shared[j] is the number of leading bits, up to v, that xs[j]
+    // shares with xs[j - 1]. xs[j] starts a new node at depth d if
+    // and only if shared[j] < d.
+    std::vector<unsigned char> & shared = scratch.ts;
+    if (shared.size() < count) {
+      shared.resize(count);
+    }
+    shared[0] = 0;
+    for (std::size_t j = 1; j != count; ++j) {
+      auto const x0 = xs[j - 1];
+      auto const x1 = xs[j];
+      int i = 0;
+      while (i != v && getbitx(x0, domain_bits - 1 - i)
+                           == getbitx(x1, domain_bits - 1 - i)) {
+        ++i;
+      }
+      shared[j] = static_cast<unsigned char>(i);
+    }
+    std::vector<cache_entry_t> & path = scratch.path;
+    if (path.size() < 2 * count) {
+      path.resize(2 * count);
+    }
+    cache_entry_t * cur = &path[0];
+    cache_entry_t * next = cur + count;
+    std::size_t cur_count = 1;
+    cur[0].s = key.s;
+    cur[0].t = key.party;
+    constexpr std::size_t batch = eval_sorted_batch;
+    block_type in[batch];
+    block_type out[batch];
+    bool ts[batch];
+    bool x_is[batch];
+    for (int d = 1; d <= v; ++d) {
+      auto const & cw = key.pcw[d - 1];
+      std::size_t next_count = 0;
+      std::size_t k = 0;
+      auto const flush = [&]() {
+        prg_n(pi, in, out, k);
+        for (std::size_t q = 0; q != k; ++q) {
+          block_type s = out[q];
+          bool t = ts[q];
+          correct(cw, x_is[q], s, t);
+          next[next_count].s = s;
+          next[next_count].t = t;
+          ++next_count;
+        }
+        k = 0;
+      };
+      std::size_t parent = 0;
+      for (std::size_t j = 0; j != count; ++j) {
+        if (j != 0) {
+          if (shared[j] < d - 1) {
+            ++parent;
+          }
+          if (shared[j] >= d) {
+            continue;
+          }
+        }
+        bool const x_i = getbitx(xs[j], domain_bits - d);
+        block_type const & s = cur[parent].s;
+        in[k] = x_i ? s.flip_msb() : s;
+        ts[k] = cur[parent].t;
+        x_is[k] = x_i;
+        if (++k == batch) {
+          flush();
+        }
+      }
+      if (k != 0) {
+        flush();
+      }
+      std::swap(cur, next);
+      cur_count = next_count;
+    }
+    // With prg_convert, scratch.ss[2 * q] and scratch.ss[2 * q + 1] are
+    // prg<L> and prg<R> of leaf q.
+    if (prg_convert) {
+      std::vector<block_type> & ab = scratch.ss;
+      if (ab.size() < 2 * cur_count) {
+        ab.resize(2 * cur_count);
+      }
+      std::size_t q = 0;
+      while (q != cur_count) {
+        std::size_t const n = std::min(batch / 2, cur_count - q);
+        for (std::size_t r = 0; r != n; ++r) {
+          in[2 * r] = cur[q + r].s;
+          in[2 * r + 1] = cur[q + r].s.flip_msb();
+        }
+        prg_n(pi, in, &ab[2 * q], 2 * n);
+        q += n;
+      }
+    }
+    std::size_t leaf = 0;
+    for (std::size_t j = 0; j != count; ++j) {
+      if (j != 0 && shared[j] < v) {
+        ++leaf;
+      }
+      auto const x = xs[j];
+      int cw_last_i = 0;
+      for (int i = v; i != domain_bits; ++i) {
+        cw_last_i <<= 1;
+        cw_last_i |= getbitx(x, domain_bits - 1 - i);
+      }
+      block_type const & a =
+          prg_convert ? scratch.ss[2 * leaf] : cur[leaf].s;
+      block_type const & b =
+          prg_convert ? scratch.ss[2 * leaf + 1] : cur[leaf].s;
+      range_type y;
+      finish_leaf(range_bits,
+                  n_minus_v,
+                  key,
+                  a,
+                  b,
+                  cur[leaf].t,
+                  cw_last_i,
+                  cw_last_i,
+                  &y);
+      ys[j] = y;
+    }
+  }
+
+  //
+  // Leaf kernels for finish_leaf. A leaf's outputs are computed in
+  // three passes over a local buffer: unpack_leaf extracts the range
+  // elements from the PRG output, correct_leaf adds cw_last (if t is
+  // set), negates (for party 1) and masks, and finish_leaf copies the
+  // requested elements to the output iterator. Each pass is a straight
+  // loop with no data-dependent branches, and correct_leaf uses SSE2
+  // when the range type is 8, 16, 32, or 64 bits wide.
+  //
+
+  //
+  // The most range elements that a leaf can hold, which is the size of
+  // finish_leaf's buffer.
+  //
+
+  static constexpr int leaf_max_count =
+      1 << power_of_two_width(cw_last_bits);
+
+  //
+  // The number of bytes of PRG output that a leaf is unpacked from.
+  // unpack_leaf reads up to 8 bytes past any element, so finish_leaf
+  // pads its copy of the bytes by that much.
+  //
+
+  static constexpr std::size_t leaf_raw_size =
+      (prg_convert ? 2 : 1) * sizeof(typename block_type::raw_type);
+
+  static constexpr std::size_t leaf_raw_slop = 8;
+
+  //
+  // Unpacks the range elements i_first through i_last of a leaf from
+  // raws into ys. Elements of 8, 16, 32, or 64 bits are loaded as whole
+  // words, other elements of at most 57 bits are loaded as a 64-bit
+  // window and shifted into place, and anything else (or any element on
+  // a big-endian system) goes through convert.
+  //
+
+  template<class Word>
+  static void unpack_leaf_words(unsigned char const * const raws,
+                                int const i_first,
+                                int const i_last,
+                                range_type * const ys) noexcept {
+    for (int i = i_first; i <= i_last; ++i) {
+      Word w;
+      std::memcpy(&w, raws + i * sizeof(Word), sizeof(Word));
+      ys[i] = static_cast<range_type>(w);
+    }
+  }
+
+  static void unpack_leaf(int const range_bits,
+                          int const n_minus_v,
+                          unsigned char const * const raws,
+                          int const i_first,
+                          int const i_last,
+                          range_type * const ys) noexcept {
+    if (!system_is_little_endian()) {
+      for (int i = i_first; i <= i_last; ++i) {
+        ys[i] = static_cast<range_type>(
+            convert(range_bits, n_minus_v, raws, i));
+      }
+    } else if (range_bits == 8) {
+      unpack_leaf_words<uint8_t>(raws, i_first, i_last, ys);
+    } else if (range_bits == 16) {
+      unpack_leaf_words<uint16_t>(raws, i_first, i_last, ys);
+    } else if (range_bits == 32) {
+      unpack_leaf_words<uint32_t>(raws, i_first, i_last, ys);
+    } else if (range_bits == 64) {
+      unpack_leaf_words<uint64_t>(raws, i_first, i_last, ys);
+    } else if (range_bits <= 57) {
+      uint64_t const mask = get_mask<uint64_t>(range_bits);
+      for (int i = i_first; i <= i_last; ++i) {
+        std::size_t const r = static_cast<std::size_t>(i) * range_bits;
+        uint64_t w;
+        std::memcpy(&w, raws + r / uchar_bits, sizeof(w));
+        ys[i] = static_cast<range_type>((w >> (r % uchar_bits)) & mask);
+      }
+    } else {
+      for (int i = i_first; i <= i_last; ++i) {
+        ys[i] = static_cast<range_type>(
+            convert(range_bits, n_minus_v, raws, i));
+      }
+    }
+  }
+
+  //
+  // Sets ys[i] to the final output for each i in [i_first, i_end),
+  // given the unpacked ys[i] and the key's cs[i] = cw_last[i]. The
+  // generic version is scalar, and the SSE2 versions handle whole
+  // vectors and pass the remainder to it.
+  //
+
+  template<class Size>
+  static void correct_leaf(Size,
+                           range_type * const ys,
+                           range_type const * const cs,
+                           int const i_first,
+                           int const i_end,
+                           bool const t,
+                           bool const party,
+                           range_type const mask) noexcept {
+    nice_range_type const tm = nice_range_type(0) - nice_range_type(t);
+    nice_range_type const pm =
+        nice_range_type(0) - nice_range_type(party);
+    for (int i = i_first; i < i_end; ++i) {
+      nice_range_type y = static_cast<nice_range_type>(ys[i])
+                          + (static_cast<nice_range_type>(cs[i]) & tm);
+      y = (y ^ pm) - pm;
+      ys[i] = static_cast<range_type>(y & mask);
+    }
+  }
+
+#if PFSS_WITH_SSE2
+
+  static __m128i leaf_set1(std::integral_constant<int, 1>,
+                           range_type const x) noexcept {
+    return _mm_set1_epi8(static_cast<char>(x));
+  }
+
+  static __m128i leaf_set1(std::integral_constant<int, 2>,
+                           range_type const x) noexcept {
+    return _mm_set1_epi16(static_cast<short>(x));
+  }
+
+  static __m128i leaf_set1(std::integral_constant<int, 4>,
+                           range_type const x) noexcept {
+    return _mm_set1_epi32(static_cast<int>(x));
+  }
+
+  static __m128i leaf_set1(std::integral_constant<int, 8>,
+                           range_type const x) noexcept {
+    return _mm_set1_epi64x(static_cast<long long>(x));
+  }
+
+  static __m128i leaf_add(std::integral_constant<int, 1>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_add_epi8(a, b);
+  }
+
+  static __m128i leaf_add(std::integral_constant<int, 2>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_add_epi16(a, b);
+  }
+
+  static __m128i leaf_add(std::integral_constant<int, 4>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_add_epi32(a, b);
+  }
+
+  static __m128i leaf_add(std::integral_constant<int, 8>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_add_epi64(a, b);
+  }
+
+  static __m128i leaf_sub(std::integral_constant<int, 1>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_sub_epi8(a, b);
+  }
+
+  static __m128i leaf_sub(std::integral_constant<int, 2>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_sub_epi16(a, b);
+  }
+
+  static __m128i leaf_sub(std::integral_constant<int, 4>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_sub_epi32(a, b);
+  }
+
+  static __m128i leaf_sub(std::integral_constant<int, 8>,
+                          __m128i const a,
+                          __m128i const b) noexcept {
+    return _mm_sub_epi64(a, b);
+  }
+
+  template<int Size,
+           typename std::enable_if<Size == 1 || Size == 2 || Size == 4
+                                       || Size == 8,
+                                   int>::type = 0>
+  static void correct_leaf(std::integral_constant<int, Size> size,
+                           range_type * const ys,
+                           range_type const * const cs,
+                           int const i_first,
+                           int const i_end,
+                           bool const t,
+                           bool const party,
+                           range_type const mask) noexcept {
+    constexpr int lanes = 16 / Size;
+    __m128i const tm = _mm_set1_epi32(-static_cast<int>(t));
+    __m128i const pm = _mm_set1_epi32(-static_cast<int>(party));
+    __m128i const mm = leaf_set1(size, mask);
+    int i = i_first;
+    for (; i_end - i >= lanes; i += lanes) {
+      __m128i y =
+          _mm_loadu_si128(reinterpret_cast<__m128i const *>(&ys[i]));
+      __m128i const c =
+          _mm_loadu_si128(reinterpret_cast<__m128i const *>(&cs[i]));
+      y = leaf_add(size, y, _mm_and_si128(c, tm));
+      y = leaf_sub(size, _mm_xor_si128(y, pm), pm);
+      y = _mm_and_si128(y, mm);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(&ys[i]), y);
+    }
+    correct_leaf(std::false_type(), ys, cs, i, i_end, t, party, mask);
+  }
+
+#endif // PFSS_WITH_SSE2
+
+  //
+  // Writes the outputs i_first through i_last of a depth-v node of the
+  // GGM tree. If prg_convert is true, a and b are prg<L> and prg<R> of
+  // the node's seed. Otherwise, a is the node's seed and b is unused.
+  //
+  // A single output, which is what the point evaluators ask for, is
+  // computed directly. Anything more goes through the leaf kernels.
+  //
+
+  template<class KeyType, class OutputIt>
+  static OutputIt finish_leaf(int const range_bits,
+                              int const n_minus_v,
+                              KeyType const & key,
+                              block_type const & a,
+                              block_type const & b,
+                              bool const t,
+                              int const i_first,
+                              int const i_last,
+                              OutputIt out) noexcept {
+    if (i_first == i_last) {
+      int const i = i_first;
       nice_range_type y;
       if (prg_convert) {
-        y = convert(range_bits, n_minus_v, prg_a, prg_b, i);
+        y = convert(range_bits, n_minus_v, a, b, i);
       } else {
-        y = convert(range_bits, n_minus_v, s, i);
+        y = convert(range_bits, n_minus_v, a, i);
       }
       if (t == 1) {
         y += static_cast<nice_range_type>(key.cw_last[i]);
@@ -560,39 +1216,490 @@ struct bgi1_common {
       }
       *out++ = static_cast<range_type>(
           y & get_mask<nice_range_type>(range_bits));
+      return out;
+    }
+    assert(i_first < i_last);
+    assert(i_last < leaf_max_count);
+    typename block_type::raw_type const & raw_a = a.raw();
+    typename block_type::raw_type const & raw_b = b.raw();
+    unsigned char raws[leaf_raw_size + leaf_raw_slop];
+    std::memcpy(&raws[0], &raw_a, sizeof(raw_a));
+    if (prg_convert) {
+      std::memcpy(&raws[sizeof(raw_a)], &raw_b, sizeof(raw_b));
+    }
+    std::memset(&raws[leaf_raw_size], 0, leaf_raw_slop);
+    range_type ys[leaf_max_count];
+    unpack_leaf(range_bits, n_minus_v, raws, i_first, i_last, ys);
+    correct_leaf(std::integral_constant<int, sizeof(range_type)>(),
+                 ys,
+                 key.cw_last.data(),
+                 i_first,
+                 i_last + 1,
+                 t,
+                 key.party,
+                 get_mask<range_type>(range_bits));
+    for (int i = i_first; i <= i_last; ++i) {
+      *out++ = ys[i];
     }
     return out;
   }
 
-#if 0
-  template<class KeyType, class OutputIt>
-  static OutputIt pack_eval_x4(int const domain_bits,
-                               int const range_bits,
-                               int const n_minus_v,
-                               int const v,
-                               int const pack_count,
-                               KeyType const & key,
-                               domain_type const & x0,
-                               domain_type const & x1,
-                               domain_type const & x2,
-                               domain_type const & x3,
-                               rand_perm_type & pi,
-                               OutputIt out) noexcept {
-    for (auto const & x :
-         {std::cref(x0), std::cref(x1), std::cref(x2), std::cref(x3)}) {
-      out = pack_eval(domain_bits,
-                      range_bits,
-                      n_minus_v,
-                      v,
-                      pack_count,
-                      key,
-                      x.get(),
-                      pi,
-                      out);
+  //
+  // The number of depth-v nodes that eval_all expands at once is at
+  // most 2^eval_all_tile_bits. Each node takes a block and a t bit, and
+  // the leaf stage needs room for twice as many blocks, so the default
+  // keeps a tile comfortably inside the L1 cache.
+  //
+
+  static constexpr int eval_all_tile_bits = 10;
+
+  //
+  // Evaluates the key at every x in [x_first, x_last] and writes the
+  // outputs to out in order of increasing x.
+  //
+  // Instead of walking the tree once per point like eval, this covers
+  // [x_first, x_last] with aligned subtrees of at most
+  // 2^eval_all_tile_bits leaves and expands each one level by level.
+  // Every internal node then costs two calls to pi, as does every leaf
+  // when prg_convert is true, and the calls for a whole level go
+  // through the batched pi in runs of eval_all_batch blocks. The path
+  // from the root to each subtree is cached the same way pack_eval
+  // caches its path, so consecutive subtrees only recompute the levels
+  // where their prefixes differ.
+  //
+
+  static constexpr std::size_t eval_all_batch = 64;
+
+  //
+  // Sets nodes[j] to the seed and control bit of node j of the
+  // subtree that has root_depth + split_bits levels above it and that
+  // descends from the depth-root_depth node with the given prefix, for
+  // every j in [0, 2^split_bits). The path down to the prefix is walked
+  // once and the split_bits levels below it are expanded level by
+  // level, so handing each node to eval_all below does none of the
+  // work above the nodes again.
+  //
+
+  template<class KeyType, class Index>
+  static void eval_frontier(int const v,
+                            KeyType const & key,
+                            Index const prefix,
+                            int const root_depth,
+                            int const split_bits,
+                            rand_perm_type & pi,
+                            cache_entry_t * const nodes) {
+    PFSS_SST_STATIC_ASSERT(std::is_unsigned<Index>::value);
+    assert(root_depth >= 0);
+    assert(split_bits >= 0);
+    assert(root_depth + split_bits <= v);
+    assert(nodes != nullptr);
+    static_cast<void>(v);
+    block_type s = key.s;
+    bool t = key.party;
+    for (int i = 0; i != root_depth; ++i) {
+      bool const x_i = ((prefix >> (root_depth - 1 - i)) & 1) != 0;
+      if (x_i == 0) {
+        s = prg<L>(pi, s);
+      } else {
+        s = prg<R>(pi, s);
+      }
+      correct(key.pcw[i], x_i, s, t);
+    }
+    nodes[0].s = s;
+    nodes[0].t = t;
+    std::array<block_type, eval_all_batch> in;
+    std::array<block_type, eval_all_batch> ps;
+    std::size_t const batch = eval_all_batch;
+    std::size_t m = 1;
+    for (int i = root_depth; i != root_depth + split_bits; ++i) {
+      for (std::size_t j = m; j-- != 0;) {
+        nodes[2 * j + 1].s = nodes[j].s.flip_msb();
+        nodes[2 * j + 1].t = nodes[j].t;
+        nodes[2 * j] = nodes[j];
+      }
+      m *= 2;
+      for (std::size_t j0 = 0; j0 < m; j0 += batch) {
+        std::size_t const n_j = min(m - j0, batch);
+        for (std::size_t j = 0; j != n_j; ++j) {
+          in[j] = nodes[j0 + j].s;
+        }
+        prg_n(pi, &in[0], &ps[0], n_j);
+        for (std::size_t j = 0; j != n_j; ++j) {
+          block_type y = ps[j];
+          bool tj = nodes[j0 + j].t;
+          correct(key.pcw[i], (j & 1) != 0, y, tj);
+          nodes[j0 + j].s = y;
+          nodes[j0 + j].t = tj;
+        }
+      }
+    }
+  }
+
+  template<class KeyType, class Index, class OutputIt>
+  static OutputIt eval_all(int const domain_bits,
+                           int const range_bits,
+                           int const n_minus_v,
+                           int const v,
+                           int const pack_count,
+                           KeyType const & key,
+                           Index const x_first,
+                           Index const x_last,
+                           rand_perm_type & pi,
+                           eval_all_scratch_t & scratch,
+                           OutputIt const out) {
+    cache_entry_t root;
+    root.s = key.s;
+    root.t = key.party;
+    return eval_all(domain_bits,
+                    range_bits,
+                    n_minus_v,
+                    v,
+                    pack_count,
+                    key,
+                    0,
+                    root,
+                    x_first,
+                    x_last,
+                    pi,
+                    scratch,
+                    out);
+  }
+
+  //
+  // The same as above, except that [x_first, x_last] must lie inside
+  // the subtree under root, a node at depth root_depth that came from
+  // eval_frontier. Nothing above root is recomputed.
+  //
+
+  template<class KeyType, class Index, class OutputIt>
+  static OutputIt eval_all(int const domain_bits,
+                           int const range_bits,
+                           int const n_minus_v,
+                           int const v,
+                           int const pack_count,
+                           KeyType const & key,
+                           int const root_depth,
+                           cache_entry_t const & root,
+                           Index const x_first,
+                           Index const x_last,
+                           rand_perm_type & pi,
+                           eval_all_scratch_t & scratch,
+                           OutputIt out) {
+    PFSS_SST_STATIC_ASSERT(std::is_unsigned<Index>::value);
+    assert(unsigned_le(domain_bits, type_bits<Index>()));
+    assert(x_first <= x_last);
+    assert(unsigned_le(x_last, get_mask<Index>(domain_bits)));
+    assert(root_depth >= 0);
+    assert(root_depth <= v);
+    assert(root_depth == 0
+           || (x_first >> (domain_bits - root_depth))
+                  == (x_last >> (domain_bits - root_depth)));
+    static_cast<void>(domain_bits);
+    int const pack_mask = pack_count - 1;
+    Index const leaf_mask = static_cast<Index>(pack_mask);
+    int const tile_bits = eval_all_tile_bits;
+    int const k_max = min(v - root_depth, tile_bits);
+    std::vector<block_type> & ss = scratch.ss;
+    if (ss.size() < (std::size_t(2) << k_max)) {
+      ss.resize(std::size_t(2) << k_max);
+    }
+    std::array<block_type, eval_all_batch> ps;
+    std::size_t const batch = eval_all_batch;
+    std::vector<unsigned char> & ts = scratch.ts;
+    if (ts.size() < (std::size_t(1) << k_max)) {
+      ts.resize(std::size_t(1) << k_max);
+    }
+    std::vector<cache_entry_t> & path = scratch.path;
+    if (path.size() < static_cast<std::size_t>(v)) {
+      path.resize(static_cast<std::size_t>(v));
+    }
+    Index const n_first = x_first >> n_minus_v;
+    Index const n_last = x_last >> n_minus_v;
+    // Every subtree has at least root_depth levels above it, so the
+    // search below always reuses root instead of going past it.
+    int path_depth = root_depth;
+    Index path_prefix = 0;
+    if (root_depth != 0) {
+      path_prefix = n_first >> (v - root_depth);
+      path[root_depth - 1] = root;
+    }
+    Index n = n_first;
+    while (true) {
+      // Use the largest aligned subtree that starts at n and does not
+      // go past n_last.
+      int k = 0;
+      while (k != k_max && ((n >> k) & 1) == 0
+             && unsigned_ge(n_last - n, get_mask<Index>(k + 1))) {
+        ++k;
+      }
+      int const d = v - k;
+      Index const prefix = n >> k;
+      // Find the root of the subtree, reusing as much of the previous
+      // path as possible.
+      int c = min(path_depth, d);
+      if (c != 0) {
+        Index const diff = (path_prefix >> (path_depth - c))
+                           ^ (prefix >> (d - c));
+        if (diff != 0) {
+          c = c - 1 - bit_scan_reverse(diff);
+        }
+      }
+      block_type s;
+      bool t;
+      if (c == 0) {
+        s = key.s;
+        t = key.party;
+      } else {
+        s = path[c - 1].s;
+        t = path[c - 1].t;
+      }
+      for (int i = c; i != d; ++i) {
+        bool const x_i = ((prefix >> (d - 1 - i)) & 1) != 0;
+        if (x_i == 0) {
+          s = prg<L>(pi, s);
+        } else {
+          s = prg<R>(pi, s);
+        }
+        correct(key.pcw[i], x_i, s, t);
+        path[i].s = s;
+        path[i].t = t;
+      }
+      path_depth = d;
+      path_prefix = prefix;
+      // Expand the subtree level by level. Each level first spreads
+      // every node j into the prg inputs 2j and 2j + 1, walking
+      // backwards so that no unread node is overwritten.
+      ss[0] = s;
+      ts[0] = t;
+      std::size_t m = 1;
+      for (int i = d; i != v; ++i) {
+        for (std::size_t j = m; j-- != 0;) {
+          ss[2 * j + 1] = ss[j].flip_msb();
+          ss[2 * j] = ss[j];
+          ts[2 * j + 1] = ts[j];
+          ts[2 * j] = ts[j];
+        }
+        m *= 2;
+        for (std::size_t j0 = 0; j0 < m; j0 += batch) {
+          std::size_t const n_j = min(m - j0, batch);
+          prg_n(pi, &ss[j0], &ps[0], n_j);
+          for (std::size_t j = 0; j != n_j; ++j) {
+            block_type y = ps[j];
+            bool tj = ts[j0 + j] != 0;
+            correct(key.pcw[i], (j & 1) != 0, y, tj);
+            ss[j0 + j] = y;
+            ts[j0 + j] = tj;
+          }
+        }
+      }
+      if (prg_convert) {
+        for (std::size_t j = m; j-- != 0;) {
+          ss[2 * j + 1] = ss[j].flip_msb();
+          ss[2 * j] = ss[j];
+        }
+        for (std::size_t j0 = 0; j0 < 2 * m; j0 += batch) {
+          std::size_t const n_j = min(2 * m - j0, batch);
+          prg_n(pi, &ss[j0], &ps[0], n_j);
+          std::copy(&ps[0], &ps[0] + n_j, &ss[j0]);
+        }
+      }
+      for (std::size_t j = 0; j != m; ++j) {
+        Index const leaf = n + static_cast<Index>(j);
+        int const i_first =
+            leaf == n_first ? static_cast<int>(x_first & leaf_mask) : 0;
+        int const i_last =
+            leaf == n_last ? static_cast<int>(x_last & leaf_mask) :
+                             pack_mask;
+        if (prg_convert) {
+          out = finish_leaf(range_bits,
+                            n_minus_v,
+                            key,
+                            ss[2 * j],
+                            ss[2 * j + 1],
+                            ts[j] != 0,
+                            i_first,
+                            i_last,
+                            out);
+        } else {
+          out = finish_leaf(range_bits,
+                            n_minus_v,
+                            key,
+                            ss[j],
+                            ss[j],
+                            ts[j] != 0,
+                            i_first,
+                            i_last,
+                            out);
+        }
+      }
+      if (n_last - n == get_mask<Index>(k)) {
+        break;
+      }
+      n += static_cast<Index>(1) << k;
     }
     return out;
   }
-#endif
+
+  //
+  // Evaluates the key at the N domain elements xs[0], ..., xs[N - 1]
+  // and writes the N outputs to out in order. This is the same as N
+  // calls to eval, except that the N paths walk down the tree in
+  // lockstep so that each level makes one batched call to pi with N
+  // blocks in flight instead of N dependent calls. xs only needs to be
+  // a forward iterator, as each level reads the N elements again.
+  //
+
+  template<int N, class KeyType, class ForwardIt, class OutputIt>
+  static OutputIt eval_xn(int const domain_bits,
+                          int const range_bits,
+                          int const n_minus_v,
+                          int const v,
+                          KeyType const & key,
+                          ForwardIt const xs,
+                          rand_perm_type & pi,
+                          OutputIt out) {
+    PFSS_SST_STATIC_ASSERT(N > 0);
+    block_type s[N];
+    bool t[N];
+    bool x_i[N];
+    block_type in[2 * N];
+    block_type ps[2 * N];
+    for (int j = 0; j != N; ++j) {
+      s[j] = key.s;
+      t[j] = key.party;
+    }
+    for (int i = 0; i != v; ++i) {
+      {
+        ForwardIt x = xs;
+        for (int j = 0; j != N; ++j, ++x) {
+          x_i[j] = getbitx(*x, domain_bits - 1 - i);
+        }
+      }
+      for (int j = 0; j != N; ++j) {
+        in[j] = x_i[j] ? s[j].flip_msb() : s[j];
+      }
+      prg_n(pi, in, ps, N);
+      for (int j = 0; j != N; ++j) {
+        s[j] = ps[j];
+        correct(key.pcw[i], x_i[j], s[j], t[j]);
+      }
+    }
+    if (prg_convert) {
+      for (int j = 0; j != N; ++j) {
+        in[2 * j] = s[j];
+        in[2 * j + 1] = s[j].flip_msb();
+      }
+      prg_n(pi, in, ps, 2 * N);
+    }
+    ForwardIt x = xs;
+    for (int j = 0; j != N; ++j, ++x) {
+      int cw_last_i = 0;
+      for (int i = v; i != domain_bits; ++i) {
+        cw_last_i <<= 1;
+        cw_last_i |= getbitx(*x, domain_bits - 1 - i);
+      }
+      if (prg_convert) {
+        out = finish_leaf(range_bits,
+                          n_minus_v,
+                          key,
+                          ps[2 * j],
+                          ps[2 * j + 1],
+                          t[j],
+                          cw_last_i,
+                          cw_last_i,
+                          out);
+      } else {
+        out = finish_leaf(range_bits,
+                          n_minus_v,
+                          key,
+                          s[j],
+                          s[j],
+                          t[j],
+                          cw_last_i,
+                          cw_last_i,
+                          out);
+      }
+    }
+    return out;
+  }
+
+  //
+  // The most paths that eval_keys walks down the tree at once.
+  //
+
+  static constexpr std::size_t eval_keys_batch = 8;
+
+  //
+  // Evaluates the key *keys[j] at the domain element xs[j] for each j
+  // in [0, count), where count <= eval_keys_batch, storing each result
+  // with ys[j] = y. This is the same as count calls to eval, except
+  // that the count paths walk down the tree in lockstep, so each level
+  // makes one batched call to pi with count blocks in flight. The keys
+  // may all be different, all be the same, or anything in between, but
+  // they must all have the same domain_bits and range_bits.
+  //
+
+  template<class KeyType, class Xs, class Ys>
+  static void eval_keys(int const domain_bits,
+                        int const range_bits,
+                        int const n_minus_v,
+                        int const v,
+                        std::size_t const count,
+                        KeyType const * const * const keys,
+                        Xs const & xs,
+                        rand_perm_type & pi,
+                        Ys & ys) {
+    assert(count <= eval_keys_batch);
+    constexpr std::size_t batch = eval_keys_batch;
+    block_type s[batch];
+    bool t[batch];
+    bool x_i[batch];
+    block_type in[2 * batch];
+    block_type ps[2 * batch];
+    for (std::size_t j = 0; j != count; ++j) {
+      s[j] = keys[j]->s;
+      t[j] = keys[j]->party;
+    }
+    for (int i = 0; i != v; ++i) {
+      for (std::size_t j = 0; j != count; ++j) {
+        x_i[j] = getbitx(xs[j], domain_bits - 1 - i);
+        in[j] = x_i[j] ? s[j].flip_msb() : s[j];
+      }
+      prg_n(pi, in, ps, count);
+      for (std::size_t j = 0; j != count; ++j) {
+        s[j] = ps[j];
+        correct(keys[j]->pcw[i], x_i[j], s[j], t[j]);
+      }
+    }
+    if (prg_convert) {
+      for (std::size_t j = 0; j != count; ++j) {
+        in[2 * j] = s[j];
+        in[2 * j + 1] = s[j].flip_msb();
+      }
+      prg_n(pi, in, ps, 2 * count);
+    }
+    for (std::size_t j = 0; j != count; ++j) {
+      auto const x = xs[j];
+      int cw_last_i = 0;
+      for (int i = v; i != domain_bits; ++i) {
+        cw_last_i <<= 1;
+        cw_last_i |= getbitx(x, domain_bits - 1 - i);
+      }
+      block_type const & a = prg_convert ? ps[2 * j] : s[j];
+      block_type const & b = prg_convert ? ps[2 * j + 1] : s[j];
+      range_type y;
+      finish_leaf(range_bits,
+                  n_minus_v,
+                  *keys[j],
+                  a,
+                  b,
+                  t[j],
+                  cw_last_i,
+                  cw_last_i,
+                  &y);
+      ys[j] = y;
+    }
+  }
 };
 
 template<int DomainBits,
@@ -707,6 +1814,7 @@ public:
   }
 
   using cw_type = typename common::cw_type;
+  using prepared_cw_type = typename common::prepared_cw_type;
 
   struct key_type final {
 
@@ -715,6 +1823,7 @@ public:
     bool party;
     block_type s;
     std::array<cw_type, v> cw;
+    std::array<prepared_cw_type, v> pcw;
     PFSS_SST_STATIC_ASSERT(unsigned_le(1 << n_minus_v, size_max::value));
     std::array<range_type, 1 << n_minus_v> cw_last;
 
@@ -738,13 +1847,15 @@ public:
     // verified.
     template<class InputIt>
     InputIt parse(InputIt in) {
-      return common::deserialize_key(domain_bits,
-                                     range_bits,
-                                     party,
-                                     s,
-                                     cw,
-                                     cw_last,
-                                     in);
+      in = common::deserialize_key(domain_bits,
+                                   range_bits,
+                                   party,
+                                   s,
+                                   cw,
+                                   cw_last,
+                                   in);
+      common::prepare_cws(cw, pcw);
+      return in;
     }
   };
 
@@ -784,6 +1895,29 @@ public:
                 rng);
   }
 
+  static constexpr std::size_t gen_batch = common::gen_batch;
+
+  template<class Alphas>
+  static void gen_n(std::size_t const count,
+                    Alphas const & alphas,
+                    range_type const * const betas,
+                    block_type const * const seeds,
+                    rand_perm_type & pi,
+                    unsigned char * const key1_blobs,
+                    unsigned char * const key2_blobs) {
+    common::gen_n(domain_bits,
+                  range_bits,
+                  n_minus_v,
+                  v,
+                  count,
+                  alphas,
+                  betas,
+                  seeds,
+                  pi,
+                  key1_blobs,
+                  key2_blobs);
+  }
+
   static range_type eval(key_type const & key,
                          domain_type const & x,
                          rand_perm_type & pi) noexcept {
@@ -822,45 +1956,140 @@ public:
                              out);
   }
 
-#if 0
-  template<class OutputIt>
-  static OutputIt pack_eval_x4(key_type const & key,
-                               domain_type const & x0,
-                               domain_type const & x1,
-                               domain_type const & x2,
-                               domain_type const & x3,
-                               rand_perm_type & pi,
-                               OutputIt const out) noexcept {
-    return common::pack_eval_x4(domain_bits,
-                                range_bits,
-                                n_minus_v,
-                                v,
-                                pack_count,
-                                key,
-                                x0,
-                                x1,
-                                x2,
-                                x3,
-                                pi,
-                                out);
-  }
-#endif
+  template<class Xs, class Ys>
+  static void eval_sorted(key_type const & key,
+                          Xs const & xs,
+                          std::size_t const count,
+                          rand_perm_type & pi,
+                          typename common::eval_all_scratch_t & scratch,
+                          Ys & ys) {
+    common::eval_sorted(domain_bits,
+                        range_bits,
+                        n_minus_v,
+                        v,
+                        key,
+                        xs,
+                        count,
+                        pi,
+                        scratch,
+                        ys);
+  }
+
+  template<int N, class ForwardIt, class OutputIt>
+  static OutputIt eval_xn(key_type const & key,
+                          ForwardIt const xs,
+                          rand_perm_type & pi,
+                          OutputIt const out) {
+    return common::template eval_xn<N>(domain_bits,
+                                       range_bits,
+                                       n_minus_v,
+                                       v,
+                                       key,
+                                       xs,
+                                       pi,
+                                       out);
+  }
+
+  static constexpr std::size_t eval_keys_batch = common::eval_keys_batch;
+
+  template<class Xs, class Ys>
+  static void eval_keys(std::size_t const count,
+                        key_type const * const * const keys,
+                        Xs const & xs,
+                        rand_perm_type & pi,
+                        Ys & ys) {
+    common::eval_keys(domain_bits,
+                      range_bits,
+                      n_minus_v,
+                      v,
+                      count,
+                      keys,
+                      xs,
+                      pi,
+                      ys);
+  }
+
+  using eval_all_scratch_t = typename common::eval_all_scratch_t;
+
+  static constexpr int eval_all_tile_bits = common::eval_all_tile_bits;
+
+  template<class Index, class OutputIt>
+  static OutputIt eval_all(key_type const & key,
+                           Index const x_first,
+                           Index const x_last,
+                           rand_perm_type & pi,
+                           eval_all_scratch_t & scratch,
+                           OutputIt const out) {
+    return common::eval_all(domain_bits,
+                            range_bits,
+                            n_minus_v,
+                            v,
+                            pack_count,
+                            key,
+                            x_first,
+                            x_last,
+                            pi,
+                            scratch,
+                            out);
+  }
+
+  template<class Index, class OutputIt>
+  static OutputIt eval_all(key_type const & key,
+                           Index const x_first,
+                           Index const x_last,
+                           rand_perm_type & pi,
+                           OutputIt const out) {
+    eval_all_scratch_t scratch;
+    return eval_all(key, x_first, x_last, pi, scratch, out);
+  }
+
+  using cache_entry_t = typename common::cache_entry_t;
+
+  template<class Index>
+  static void eval_frontier(key_type const & key,
+                            Index const prefix,
+                            int const root_depth,
+                            int const split_bits,
+                            rand_perm_type & pi,
+                            cache_entry_t * const nodes) {
+    common::eval_frontier(
+        v, key, prefix, root_depth, split_bits, pi, nodes);
+  }
+
+  template<class Index, class OutputIt>
+  static OutputIt eval_all(key_type const & key,
+                           int const root_depth,
+                           cache_entry_t const & root,
+                           Index const x_first,
+                           Index const x_last,
+                           rand_perm_type & pi,
+                           eval_all_scratch_t & scratch,
+                           OutputIt const out) {
+    return common::eval_all(domain_bits,
+                            range_bits,
+                            n_minus_v,
+                            v,
+                            pack_count,
+                            key,
+                            root_depth,
+                            root,
+                            x_first,
+                            x_last,
+                            pi,
+                            scratch,
+                            out);
+  }
 
   template<class RangeTypeContainer>
   static void eval_all(key_type const & key,
                        RangeTypeContainer & ys,
                        rand_perm_type & pi) {
-    auto const domain_max =
-        std::numeric_limits<domain_type>::max()
-        >> (std::numeric_limits<domain_type>::digits - domain_bits);
-    domain_type x = 0;
-    while (true) {
-      ys[x] = eval(key, x, pi);
-      if (x == domain_max) {
-        break;
-      }
-      ++x;
-    }
+    PFSS_SST_STATIC_ASSERT(domain_bits <= type_bits<std::size_t>());
+    eval_all(key,
+             std::size_t(0),
+             get_mask<std::size_t>(domain_bits),
+             pi,
+             &ys[0]);
   }
 };
 
@@ -961,6 +2190,7 @@ public:
   }
 
   using cw_type = typename common::cw_type;
+  using prepared_cw_type = typename common::prepared_cw_type;
 
   struct key_type final {
 
@@ -971,6 +2201,7 @@ public:
     bool party;
     block_type s;
     std::vector<cw_type> cw;
+    std::vector<prepared_cw_type> pcw;
     std::vector<range_type> cw_last;
 
     key_type(int const domain_bits,
@@ -982,6 +2213,7 @@ public:
           n_minus_v(n_minus_v),
           v(v),
           cw(v),
+          pcw(v),
           cw_last(1 << n_minus_v) {
     }
 
@@ -1008,13 +2240,15 @@ public:
     // verified.
     template<class InputIt>
     InputIt parse(InputIt in) {
-      return common::deserialize_key(domain_bits,
-                                     range_bits,
-                                     party,
-                                     s,
-                                     cw,
-                                     cw_last,
-                                     in);
+      in = common::deserialize_key(domain_bits,
+                                   range_bits,
+                                   party,
+                                   s,
+                                   cw,
+                                   cw_last,
+                                   in);
+      common::prepare_cws(cw, pcw);
+      return in;
     }
   };
 
@@ -1055,6 +2289,29 @@ public:
                 rng);
   }
 
+  static constexpr std::size_t gen_batch = common::gen_batch;
+
+  template<class Alphas>
+  void gen_n(std::size_t const count,
+             Alphas const & alphas,
+             range_type const * const betas,
+             block_type const * const seeds,
+             rand_perm_type & pi,
+             unsigned char * const key1_blobs,
+             unsigned char * const key2_blobs) const {
+    common::gen_n(domain_bits,
+                  range_bits,
+                  n_minus_v,
+                  v,
+                  count,
+                  alphas,
+                  betas,
+                  seeds,
+                  pi,
+                  key1_blobs,
+                  key2_blobs);
+  }
+
   range_type eval(key_type const & key,
                   domain_type const & x,
                   rand_perm_type & pi) const noexcept {
@@ -1093,29 +2350,141 @@ public:
                              out);
   }
 
-#if 0
-  template<class OutputIt>
-  OutputIt pack_eval_x4(key_type const & key,
-                        domain_type const & x0,
-                        domain_type const & x1,
-                        domain_type const & x2,
-                        domain_type const & x3,
-                        rand_perm_type & pi,
-                        OutputIt const out) const noexcept {
-    return common::pack_eval_x4(domain_bits,
-                                range_bits,
-                                n_minus_v,
-                                v,
-                                pack_count,
-                                key,
-                                x0,
-                                x1,
-                                x2,
-                                x3,
-                                pi,
-                                out);
-  }
-#endif
+  template<class Xs, class Ys>
+  void eval_sorted(key_type const & key,
+                   Xs const & xs,
+                   std::size_t const count,
+                   rand_perm_type & pi,
+                   typename common::eval_all_scratch_t & scratch,
+                   Ys & ys) const {
+    common::eval_sorted(domain_bits,
+                        range_bits,
+                        n_minus_v,
+                        v,
+                        key,
+                        xs,
+                        count,
+                        pi,
+                        scratch,
+                        ys);
+  }
+
+  using eval_all_scratch_t = typename common::eval_all_scratch_t;
+
+  static constexpr int eval_all_tile_bits = common::eval_all_tile_bits;
+
+  template<class Index, class OutputIt>
+  OutputIt eval_all(key_type const & key,
+                    Index const x_first,
+                    Index const x_last,
+                    rand_perm_type & pi,
+                    eval_all_scratch_t & scratch,
+                    OutputIt const out) const {
+    return common::eval_all(domain_bits,
+                            range_bits,
+                            n_minus_v,
+                            v,
+                            pack_count,
+                            key,
+                            x_first,
+                            x_last,
+                            pi,
+                            scratch,
+                            out);
+  }
+
+  template<class Index, class OutputIt>
+  OutputIt eval_all(key_type const & key,
+                    Index const x_first,
+                    Index const x_last,
+                    rand_perm_type & pi,
+                    OutputIt const out) const {
+    eval_all_scratch_t scratch;
+    return eval_all(key, x_first, x_last, pi, scratch, out);
+  }
+
+  using cache_entry_t = typename common::cache_entry_t;
+
+  template<class Index>
+  void eval_frontier(key_type const & key,
+                     Index const prefix,
+                     int const root_depth,
+                     int const split_bits,
+                     rand_perm_type & pi,
+                     cache_entry_t * const nodes) const {
+    common::eval_frontier(
+        v, key, prefix, root_depth, split_bits, pi, nodes);
+  }
+
+  template<class Index, class OutputIt>
+  OutputIt eval_all(key_type const & key,
+                    int const root_depth,
+                    cache_entry_t const & root,
+                    Index const x_first,
+                    Index const x_last,
+                    rand_perm_type & pi,
+                    eval_all_scratch_t & scratch,
+                    OutputIt const out) const {
+    return common::eval_all(domain_bits,
+                            range_bits,
+                            n_minus_v,
+                            v,
+                            pack_count,
+                            key,
+                            root_depth,
+                            root,
+                            x_first,
+                            x_last,
+                            pi,
+                            scratch,
+                            out);
+  }
+
+  template<class RangeTypeContainer>
+  void eval_all(key_type const & key,
+                RangeTypeContainer & ys,
+                rand_perm_type & pi) const {
+    assert(unsigned_le(domain_bits, type_bits<std::size_t>()));
+    eval_all(key,
+             std::size_t(0),
+             get_mask<std::size_t>(domain_bits),
+             pi,
+             &ys[0]);
+  }
+
+  template<int N, class ForwardIt, class OutputIt>
+  OutputIt eval_xn(key_type const & key,
+                   ForwardIt const xs,
+                   rand_perm_type & pi,
+                   OutputIt const out) const {
+    return common::template eval_xn<N>(domain_bits,
+                                       range_bits,
+                                       n_minus_v,
+                                       v,
+                                       key,
+                                       xs,
+                                       pi,
+                                       out);
+  }
+
+  static constexpr std::size_t eval_keys_batch = common::eval_keys_batch;
+
+  template<class Xs, class Ys>
+  void eval_keys(std::size_t const count,
+                 key_type const * const * const keys,
+                 Xs const & xs,
+                 rand_perm_type & pi,
+                 Ys & ys) const {
+    common::eval_keys(domain_bits,
+                      range_bits,
+                      n_minus_v,
+                      v,
+                      count,
+                      keys,
+                      xs,
+                      pi,
+                      ys);
+  }
 };
 
 } // namespace pfss
@@ -28,6 +28,24 @@
 #include <bit>
 #endif
 
+// Runtime AES backend dispatch compiles each x86 backend with a GCC
+// target attribute and picks one with cpuid at first use. The VAES
+// intrinsics need GCC 8 or Clang 7.
+#ifndef PFSS_WITH_CPU_DISPATCH
+#if PFSS_WITH_X86 && PFSS_WITH_SSE2 \
+    && ((defined(__clang__) && __clang_major__ >= 7) \
+        || (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8))
+#define PFSS_WITH_CPU_DISPATCH 1
+#else
+#define PFSS_WITH_CPU_DISPATCH 0
+#endif
+#endif
+
+#if PFSS_WITH_CPU_DISPATCH
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 #if PFSS_WITH_AES_NI
 #include <wmmintrin.h>
 #endif
@@ -997,6 +1015,17 @@ public:
     return *this;
   }
 
+  // Returns the block if b is true and the zero block otherwise,
+  // without branching on b.
+  chunked_block masked(bool const b) const noexcept {
+    chunk_type const m = static_cast<chunk_type>(chunk_type(0) - b);
+    chunked_block x;
+    for (int i = 0; i != ChunkCount; ++i) {
+      x.raw_[i] = raw_[i] & m;
+    }
+    return x;
+  }
+
   //--------------------------------------------------------------------
   // Serialization
   //--------------------------------------------------------------------
@@ -1138,6 +1167,13 @@ public:
     return *this = *this ^ other;
   }
 
+  // Returns the block if b is true and the zero block otherwise,
+  // without branching on b.
+  m128i_block masked(bool const b) const noexcept {
+    return _mm_and_si128(raw_,
+                         _mm_set1_epi32(-static_cast<int>(b)));
+  }
+
   //--------------------------------------------------------------------
   // Serialization
   //--------------------------------------------------------------------
@@ -1161,38 +1197,6 @@ public:
 
 #endif // PFSS_WITH_SSE2
 
-//----------------------------------------------------------------------
-// pfss::m512i_block
-//----------------------------------------------------------------------
-
-#if PFSS_WITH_AVX_512_F
-
-class m512i_block final {
-
-  __m512i raw_;
-
-public:
-
-  m512i_block() noexcept = default;
-
-  m512i_block(__m512i const & x) noexcept : raw_(x) {
-  }
-
-  operator __m512i() const noexcept {
-    return raw_;
-  }
-
-  m512i_block operator^(m512i_block const & other) const noexcept {
-    return _mm512_xor_si512(raw_, other.raw_);
-  }
-
-  m512i_block & operator^=(m512i_block const & other) noexcept {
-    return *this = *this ^ other;
-  }
-};
-
-#endif // PFSS_WITH_AVX_512_F
-
 //----------------------------------------------------------------------
 // pfss::uint8x16_block
 //----------------------------------------------------------------------
@@ -1294,6 +1298,12 @@ public:
     return *this;
   }
 
+  // Returns the block if b is true and the zero block otherwise,
+  // without branching on b.
+  uint8x16_block masked(bool const b) const noexcept {
+    return vandq_u8(raw_, vdupq_n_u8(static_cast<uint8_t>(0 - b)));
+  }
+
   //--------------------------------------------------------------------
   // Serialization
   //--------------------------------------------------------------------
@@ -1481,6 +1491,75 @@ void SubWord(W w) {
   }
 }
 
+template<class State>
+void SubBytes(State s) {
+  for (int i = 0; i < 4 * Nb; ++i) {
+    s[i] = Sbox[s[i]];
+  }
+}
+
+template<class State>
+void ShiftRows(State s) {
+  unsigned char t[4 * Nb];
+  for (int c = 0; c < Nb; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      t[c * 4 + r] = s[((c + r) % Nb) * 4 + r];
+    }
+  }
+  for (int i = 0; i < 4 * Nb; ++i) {
+    s[i] = t[i];
+  }
+}
+
+inline unsigned char xtime(unsigned char const b) {
+  return static_cast<unsigned char>((b << 1) ^ ((b & 0x80) ? 0x1B : 0));
+}
+
+template<class State>
+void MixColumns(State s) {
+  for (int c = 0; c < Nb; ++c) {
+    unsigned char const a0 = s[c * 4 + 0];
+    unsigned char const a1 = s[c * 4 + 1];
+    unsigned char const a2 = s[c * 4 + 2];
+    unsigned char const a3 = s[c * 4 + 3];
+    unsigned char const all = a0 ^ a1 ^ a2 ^ a3;
+    s[c * 4 + 0] = a0 ^ all ^ xtime(a0 ^ a1);
+    s[c * 4 + 1] = a1 ^ all ^ xtime(a1 ^ a2);
+    s[c * 4 + 2] = a2 ^ all ^ xtime(a2 ^ a3);
+    s[c * 4 + 3] = a3 ^ all ^ xtime(a3 ^ a0);
+  }
+}
+
+template<class State, class W>
+void AddRoundKey(State s, W w) {
+  for (int i = 0; i < 4 * Nb; ++i) {
+    s[i] ^= w[i];
+  }
+}
+
+template<int Nk, class In, class Out, class W>
+void Cipher(In in, Out out, W w) {
+  PFSS_SST_STATIC_ASSERT(Nk == 4 || Nk == 6 || Nk == 8);
+  constexpr int Nr = Nk + 6;
+  unsigned char state[4 * Nb];
+  for (int i = 0; i < 4 * Nb; ++i) {
+    state[i] = in[i];
+  }
+  AddRoundKey(state, &w[0]);
+  for (int round = 1; round < Nr; ++round) {
+    SubBytes(state);
+    ShiftRows(state);
+    MixColumns(state);
+    AddRoundKey(state, &w[round * 4 * Nb]);
+  }
+  SubBytes(state);
+  ShiftRows(state);
+  AddRoundKey(state, &w[Nr * 4 * Nb]);
+  for (int i = 0; i < 4 * Nb; ++i) {
+    out[i] = state[i];
+  }
+}
+
 template<int Nk, class Key, class W>
 void KeyExpansion(Key key, W w) {
   PFSS_SST_STATIC_ASSERT(Nk == 4 || Nk == 6 || Nk == 8);
@@ -1511,6 +1590,197 @@ void KeyExpansion(Key key, W w) {
 
 } // namespace fips197
 
+//----------------------------------------------------------------------
+// pfss::m512i_block
+//----------------------------------------------------------------------
+//
+// A 512-bit block that holds four 128-bit lanes, where each lane is
+// one AES state. With VAES, each lane operation is a single instruction
+// on all four lanes. Without it, the same operations are emulated one
+// lane at a time, which is slow but produces the same bits, so the
+// code built on top of this type can be tested anywhere.
+//
+
+class m512i_block final {
+
+#if PFSS_WITH_AVX_512_F
+  __m512i raw_;
+#else
+  alignas(64) unsigned char raw_[64];
+#endif
+
+public:
+  static constexpr int bits = 512;
+  static constexpr int bytes = 64;
+  static constexpr int lanes = 4;
+
+  m512i_block() noexcept = default;
+
+#if PFSS_WITH_AVX_512_F
+
+  m512i_block(__m512i const & x) noexcept : raw_(x) {
+  }
+
+  operator __m512i() const noexcept {
+    return raw_;
+  }
+
+#endif
+
+  //--------------------------------------------------------------------
+  // Raw access
+  //--------------------------------------------------------------------
+
+  using raw_type = decltype(raw_);
+
+  raw_type & raw() noexcept {
+    return raw_;
+  }
+
+  raw_type const & raw() const noexcept {
+    return raw_;
+  }
+
+  //--------------------------------------------------------------------
+  // Container access
+  //--------------------------------------------------------------------
+
+  using size_type = unsigned int;
+
+  size_type size() const noexcept {
+    return static_cast<size_type>(bytes);
+  }
+
+  unsigned char & operator[](size_type const i) noexcept {
+    assert(i < size());
+    return reinterpret_cast<unsigned char *>(&raw_)[i];
+  }
+
+  unsigned char const & operator[](size_type const i) const noexcept {
+    assert(i < size());
+    return reinterpret_cast<unsigned char const *>(&raw_)[i];
+  }
+
+  //--------------------------------------------------------------------
+  // Lane access
+  //--------------------------------------------------------------------
+  //
+  // load and store move four consecutive 128-bit blocks into and out of
+  // the lanes, with p[0] in the lowest lane. broadcast copies one
+  // 16-byte value into every lane.
+  //
+
+  template<class Block>
+  static m512i_block load(Block const * const p) noexcept {
+    PFSS_SST_STATIC_ASSERT(sizeof(Block) * lanes == bytes);
+    assert(p != nullptr);
+    m512i_block b;
+#if PFSS_WITH_AVX_512_F
+    b.raw_ = _mm512_loadu_si512(p);
+#else
+    std::memcpy(&b.raw_, p, bytes);
+#endif
+    return b;
+  }
+
+  template<class Block>
+  void store(Block * const p) const noexcept {
+    PFSS_SST_STATIC_ASSERT(sizeof(Block) * lanes == bytes);
+    assert(p != nullptr);
+#if PFSS_WITH_AVX_512_F
+    _mm512_storeu_si512(p, raw_);
+#else
+    std::memcpy(static_cast<void *>(p), &raw_, bytes);
+#endif
+  }
+
+  static m512i_block broadcast(void const * const p) noexcept {
+    assert(p != nullptr);
+    m512i_block b;
+    for (size_type i = 0; i != b.size(); i += bytes / lanes) {
+      std::memcpy(&b[i], p, bytes / lanes);
+    }
+    return b;
+  }
+
+  //--------------------------------------------------------------------
+  // Arithmetic
+  //--------------------------------------------------------------------
+
+  m512i_block operator^(m512i_block const & other) const noexcept {
+#if PFSS_WITH_AVX_512_F
+    return _mm512_xor_si512(raw_, other.raw_);
+#else
+    m512i_block b;
+    for (size_type i = 0; i != b.size(); ++i) {
+      b[i] = (*this)[i] ^ other[i];
+    }
+    return b;
+#endif
+  }
+
+  m512i_block & operator^=(m512i_block const & other) noexcept {
+    return *this = *this ^ other;
+  }
+
+  //--------------------------------------------------------------------
+  // AES rounds
+  //--------------------------------------------------------------------
+  //
+  // These match _mm512_aesenc_epi128 and _mm512_aesenclast_epi128: each
+  // lane gets one AES round with the corresponding lane of rkey.
+  //
+
+  m512i_block aesenc(m512i_block const & rkey) const noexcept {
+#if PFSS_WITH_VAES
+    return _mm512_aesenc_epi128(raw_, rkey.raw_);
+#else
+    m512i_block b = *this;
+    for (size_type i = 0; i != b.size(); i += bytes / lanes) {
+      fips197::SubBytes(&b[i]);
+      fips197::ShiftRows(&b[i]);
+      fips197::MixColumns(&b[i]);
+      fips197::AddRoundKey(&b[i], &rkey[i]);
+    }
+    return b;
+#endif
+  }
+
+  m512i_block aesenclast(m512i_block const & rkey) const noexcept {
+#if PFSS_WITH_VAES
+    return _mm512_aesenclast_epi128(raw_, rkey.raw_);
+#else
+    m512i_block b = *this;
+    for (size_type i = 0; i != b.size(); i += bytes / lanes) {
+      fips197::SubBytes(&b[i]);
+      fips197::ShiftRows(&b[i]);
+      fips197::AddRoundKey(&b[i], &rkey[i]);
+    }
+    return b;
+#endif
+  }
+
+  //--------------------------------------------------------------------
+  // Serialization
+  //--------------------------------------------------------------------
+
+  template<class OutputIt>
+  OutputIt serialize(OutputIt out) const {
+    for (size_type i = 0; i != size(); ++i) {
+      *out++ = (*this)[i];
+    }
+    return out;
+  }
+
+  template<class InputIt>
+  InputIt parse(InputIt in) {
+    for (size_type i = 0; i != size(); ++i) {
+      (*this)[i] = *in++;
+    }
+    return in;
+  }
+};
+
 //----------------------------------------------------------------------
 // Fixed keys
 //----------------------------------------------------------------------
@@ -1547,6 +1817,25 @@ Block nettle_aes_128_encrypt(
   return block;
 }
 
+// Encrypts n blocks with a single call into Nettle, which lets Nettle
+// use its own multi-block code path if it has one. in and out may be
+// equal.
+template<class Block>
+void nettle_aes_128_encrypt(Block const * const in,
+                            Block * const out,
+                            std::size_t const n,
+                            aes128_ctx const & rkeys) noexcept {
+  PFSS_SST_STATIC_ASSERT(sizeof(Block) == 16);
+  assert(in != nullptr || n == 0);
+  assert(out != nullptr || n == 0);
+  if (n != 0) {
+    aes128_encrypt(&rkeys,
+                   16 * n,
+                   reinterpret_cast<unsigned char *>(out),
+                   reinterpret_cast<unsigned char const *>(in));
+  }
+}
+
 template<class BlockType>
 class rand_perm_nettle_aes128 final {
 
@@ -1572,6 +1861,12 @@ public:
   block_type operator()(block_type x) {
     return nettle_aes_128_encrypt(x, ctx);
   }
+
+  void operator()(block_type const * const in,
+                  block_type * const out,
+                  std::size_t const n) {
+    nettle_aes_128_encrypt(in, out, n, ctx);
+  }
 };
 
 constexpr std::array<unsigned char, 176>
@@ -1587,6 +1882,12 @@ struct fixed_nettle_aes_128_rand_perm final {
   Block operator()(Block const block) const noexcept {
     return nettle_aes_128_encrypt(block, fixed_nettle_aes_128_rkeys);
   }
+
+  void operator()(Block const * const in,
+                  Block * const out,
+                  std::size_t const n) const noexcept {
+    nettle_aes_128_encrypt(in, out, n, fixed_nettle_aes_128_rkeys);
+  }
 };
 
 #endif // PFSS_WITH_NETTLE
@@ -1614,6 +1915,53 @@ inline __m128i aes_ni_128_encrypt(
   return block;
 }
 
+// Encrypts N blocks with the rounds interleaved, so that N independent
+// aesenc instructions are in flight instead of each block waiting out
+// the full latency of the previous one. in and out may be equal.
+template<int N, class Block>
+void aes_ni_128_encrypt_x(Block const * const in,
+                          Block * const out,
+                          __m128i const * const rkeys) noexcept {
+  assert(in != nullptr);
+  assert(out != nullptr);
+  assert(rkeys != nullptr);
+  __m128i b[N];
+  for (int j = 0; j != N; ++j) {
+    b[j] = _mm_xor_si128(in[j], rkeys[0]);
+  }
+  for (int r = 1; r != 10; ++r) {
+    for (int j = 0; j != N; ++j) {
+      b[j] = _mm_aesenc_si128(b[j], rkeys[r]);
+    }
+  }
+  for (int j = 0; j != N; ++j) {
+    out[j] = _mm_aesenclast_si128(b[j], rkeys[10]);
+  }
+}
+
+// Encrypts n blocks, eight at a time where possible. in and out may be
+// equal.
+template<class Block>
+void aes_ni_128_encrypt(Block const * in,
+                        Block * out,
+                        std::size_t n,
+                        __m128i const * const rkeys) noexcept {
+  assert(in != nullptr || n == 0);
+  assert(out != nullptr || n == 0);
+  for (; n >= 8; n -= 8, in += 8, out += 8) {
+    aes_ni_128_encrypt_x<8>(in, out, rkeys);
+  }
+  if (n >= 4) {
+    aes_ni_128_encrypt_x<4>(in, out, rkeys);
+    n -= 4;
+    in += 4;
+    out += 4;
+  }
+  for (; n != 0; --n) {
+    *out++ = aes_ni_128_encrypt(*in++, rkeys);
+  }
+}
+
 #endif // PFSS_WITH_AES_NI
 
 //----------------------------------------------------------------------
@@ -1683,6 +2031,12 @@ public:
   block_type operator()(block_type const x) const noexcept {
     return encrypt(x);
   }
+
+  void operator()(block_type const * const in,
+                  block_type * const out,
+                  std::size_t const n) const noexcept {
+    aes_ni_128_encrypt(in, out, n, w);
+  }
 };
 
 #endif // PFSS_WITH_AES_NI
@@ -1703,6 +2057,12 @@ struct fixed_aes_ni_128_rand_perm final {
   m128i_block operator()(m128i_block const block) const noexcept {
     return aes_ni_128_encrypt(block, fixed_aes_ni_128_rkeys);
   }
+
+  void operator()(m128i_block const * const in,
+                  m128i_block * const out,
+                  std::size_t const n) const noexcept {
+    aes_ni_128_encrypt(in, out, n, fixed_aes_ni_128_rkeys);
+  }
 };
 
 #endif // PFSS_WITH_AES_NI
@@ -1728,6 +2088,52 @@ inline uint8x16_t arm_aes_128_encrypt(
   return block;
 }
 
+// Encrypts N blocks with the rounds interleaved. in and out may be
+// equal.
+template<int N, class Block>
+void arm_aes_128_encrypt_x(Block const * const in,
+                           Block * const out,
+                           uint8x16_t const * const rkeys) noexcept {
+  assert(in != nullptr);
+  assert(out != nullptr);
+  assert(rkeys != nullptr);
+  uint8x16_t b[N];
+  for (int j = 0; j != N; ++j) {
+    b[j] = in[j];
+  }
+  for (int r = 0; r != 9; ++r) {
+    for (int j = 0; j != N; ++j) {
+      b[j] = vaesmcq_u8(vaeseq_u8(b[j], rkeys[r]));
+    }
+  }
+  for (int j = 0; j != N; ++j) {
+    out[j] = veorq_u8(vaeseq_u8(b[j], rkeys[9]), rkeys[10]);
+  }
+}
+
+// Encrypts n blocks, eight at a time where possible. in and out may be
+// equal.
+template<class Block>
+void arm_aes_128_encrypt(Block const * in,
+                         Block * out,
+                         std::size_t n,
+                         uint8x16_t const * const rkeys) noexcept {
+  assert(in != nullptr || n == 0);
+  assert(out != nullptr || n == 0);
+  for (; n >= 8; n -= 8, in += 8, out += 8) {
+    arm_aes_128_encrypt_x<8>(in, out, rkeys);
+  }
+  if (n >= 4) {
+    arm_aes_128_encrypt_x<4>(in, out, rkeys);
+    n -= 4;
+    in += 4;
+    out += 4;
+  }
+  for (; n != 0; --n) {
+    *out++ = arm_aes_128_encrypt(*in++, rkeys);
+  }
+}
+
 class arm_crypto_aes_128_rand_perm final {
 
   // Round keys.
@@ -1761,6 +2167,12 @@ public:
   block_type operator()(block_type const x) const noexcept {
     return encrypt(x);
   }
+
+  void operator()(block_type const * const in,
+                  block_type * const out,
+                  std::size_t const n) const noexcept {
+    arm_aes_128_encrypt(in, out, n, w);
+  }
 };
 
 constexpr std::array<unsigned char, 176>
@@ -1774,10 +2186,424 @@ struct fixed_arm_aes_128_rand_perm final {
   uint8x16_block operator()(uint8x16_block const block) const noexcept {
     return arm_aes_128_encrypt(block, fixed_arm_aes_128_rkeys);
   }
+
+  void operator()(uint8x16_block const * const in,
+                  uint8x16_block * const out,
+                  std::size_t const n) const noexcept {
+    arm_aes_128_encrypt(in, out, n, fixed_arm_aes_128_rkeys);
+  }
 };
 
 #endif // PFSS_WITH_ARM_CRYPTO
 
+//----------------------------------------------------------------------
+// vaes_512_rand_perm
+//----------------------------------------------------------------------
+//
+// AES-128 on four blocks per round instruction using m512i_block. The
+// block type is any 16-byte block, which is moved into and out of the
+// lanes by its byte representation, the same as the nettle rand_perm.
+// Without PFSS_WITH_VAES this still works through the emulated lanes.
+//
+
+// Encrypts 4 * N blocks, four to an m512i_block, with the rounds of the
+// N wide blocks interleaved. rkeys holds each round key broadcast to
+// all four lanes. in and out may be equal.
+template<int N, class Block>
+void vaes_512_encrypt_x(Block const * const in,
+                        Block * const out,
+                        m512i_block const * const rkeys) noexcept {
+  assert(in != nullptr);
+  assert(out != nullptr);
+  assert(rkeys != nullptr);
+  constexpr int lanes = m512i_block::lanes;
+  m512i_block b[N];
+  for (int j = 0; j != N; ++j) {
+    b[j] = m512i_block::load(in + j * lanes) ^ rkeys[0];
+  }
+  for (int r = 1; r != 10; ++r) {
+    for (int j = 0; j != N; ++j) {
+      b[j] = b[j].aesenc(rkeys[r]);
+    }
+  }
+  for (int j = 0; j != N; ++j) {
+    b[j].aesenclast(rkeys[10]).store(out + j * lanes);
+  }
+}
+
+// Encrypts n blocks, sixteen at a time where possible. A final partial
+// group is padded out to one full m512i_block. in and out may be equal.
+template<class Block>
+void vaes_512_encrypt(Block const * in,
+                      Block * out,
+                      std::size_t n,
+                      m512i_block const * const rkeys) noexcept {
+  assert(in != nullptr || n == 0);
+  assert(out != nullptr || n == 0);
+  constexpr int lanes = m512i_block::lanes;
+  for (; n >= 4 * lanes; n -= 4 * lanes) {
+    vaes_512_encrypt_x<4>(in, out, rkeys);
+    in += 4 * lanes;
+    out += 4 * lanes;
+  }
+  if (n >= 2 * lanes) {
+    vaes_512_encrypt_x<2>(in, out, rkeys);
+    n -= 2 * lanes;
+    in += 2 * lanes;
+    out += 2 * lanes;
+  }
+  if (n >= lanes) {
+    vaes_512_encrypt_x<1>(in, out, rkeys);
+    n -= lanes;
+    in += lanes;
+    out += lanes;
+  }
+  if (n != 0) {
+    Block b[lanes];
+    for (int j = 0; j != lanes; ++j) {
+      b[j] = in[static_cast<std::size_t>(j) < n ? j : 0];
+    }
+    vaes_512_encrypt_x<1>(b, b, rkeys);
+    std::copy(b, b + n, out);
+  }
+}
+
+template<class Block = default_block_t<>>
+class vaes_512_rand_perm final {
+
+  PFSS_SST_STATIC_ASSERT(sizeof(Block) == 16);
+
+  // Round keys, each broadcast to all four lanes.
+  m512i_block w[11];
+
+public:
+  using block_type = Block;
+
+  vaes_512_rand_perm(void const * const key) noexcept {
+    assert(key != nullptr);
+    unsigned char rkeys[176];
+    fips197::KeyExpansion<4>(static_cast<unsigned char const *>(key),
+                             rkeys);
+    for (int r = 0; r != 11; ++r) {
+      w[r] = m512i_block::broadcast(&rkeys[r * 16]);
+    }
+  }
+
+  ~vaes_512_rand_perm() noexcept = default;
+  vaes_512_rand_perm(vaes_512_rand_perm const &) noexcept = default;
+  vaes_512_rand_perm(vaes_512_rand_perm &&) noexcept = default;
+  vaes_512_rand_perm &
+  operator=(vaes_512_rand_perm const &) noexcept = default;
+  vaes_512_rand_perm &
+  operator=(vaes_512_rand_perm &&) noexcept = default;
+
+  block_type operator()(block_type const x) const noexcept {
+    block_type y;
+    vaes_512_encrypt(&x, &y, 1, w);
+    return y;
+  }
+
+  void operator()(block_type const * const in,
+                  block_type * const out,
+                  std::size_t const n) const noexcept {
+    vaes_512_encrypt(in, out, n, w);
+  }
+};
+
+template<class Block = default_block_t<>>
+class fixed_vaes_512_rand_perm final {
+  vaes_512_rand_perm<Block> p_{fixed_aes_128_key.data()};
+
+public:
+  using block_type = Block;
+
+  block_type operator()(block_type const x) const noexcept {
+    return p_(x);
+  }
+
+  void operator()(block_type const * const in,
+                  block_type * const out,
+                  std::size_t const n) const noexcept {
+    p_(in, out, n);
+  }
+};
+
+//----------------------------------------------------------------------
+// fixed_dispatch_aes_128_rand_perm
+//----------------------------------------------------------------------
+//
+// The fixed-key AES-128 permutation with the backend chosen at run
+// time, so that one build runs at full speed on every x86 host. Each
+// backend is compiled for its own instruction set with a target
+// attribute and is only called after cpuid says it is usable. The
+// PFSS_AES_BACKEND environment variable can name a backend to use
+// instead of the fastest one. An unknown or unusable name is ignored.
+//
+
+#if PFSS_WITH_CPU_DISPATCH
+
+struct cpu_features final {
+  bool aes_ni = false;
+  bool vaes_256 = false;
+  bool vaes_512 = false;
+};
+
+inline cpu_features get_cpu_features() noexcept {
+  cpu_features f;
+  unsigned int a, b, c, d;
+  if (!__get_cpuid(1, &a, &b, &c, &d)) {
+    return f;
+  }
+  f.aes_ni = (c & (1U << 25)) != 0;
+  bool const osxsave = (c & (1U << 27)) != 0;
+  bool const avx = (c & (1U << 28)) != 0;
+  if (!f.aes_ni || !osxsave || !avx) {
+    return f;
+  }
+  // The OS must save the YMM (and for AVX-512, the opmask and ZMM)
+  // state, or the wider registers are unusable even if present.
+  unsigned int xcr0_lo, xcr0_hi;
+  __asm__ __volatile__("xgetbv"
+                       : "=a"(xcr0_lo), "=d"(xcr0_hi)
+                       : "c"(0));
+  bool const ymm_state = (xcr0_lo & 0x06U) == 0x06U;
+  bool const zmm_state = (xcr0_lo & 0xE6U) == 0xE6U;
+  if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+    return f;
+  }
+  bool const avx2 = (b & (1U << 5)) != 0;
+  bool const avx512f = (b & (1U << 16)) != 0;
+  bool const vaes = (c & (1U << 9)) != 0;
+  f.vaes_256 = ymm_state && avx2 && vaes;
+  f.vaes_512 = zmm_state && avx512f && vaes;
+  return f;
+}
+
+// Loads the fixed round keys one 128-bit lane at a time. The backends
+// below broadcast these to the register width they use.
+#define PFSS_LOAD_FIXED_RKEYS(w) \
+  __m128i w[11]; \
+  for (int r = 0; r != 11; ++r) { \
+    w[r] = _mm_loadu_si128(reinterpret_cast<__m128i const *>( \
+        &fixed_aes_128_rkeys[static_cast<std::size_t>(r) * 16])); \
+  }
+
+__attribute__((target("sse2,aes"))) inline void
+aes_ni_fixed_aes_128_encrypt(m128i_block const * in,
+                             m128i_block * out,
+                             std::size_t n) noexcept {
+  PFSS_LOAD_FIXED_RKEYS(w)
+  while (n != 0) {
+    int const k = n < 8 ? static_cast<int>(n) : 8;
+    __m128i b[8];
+    for (int j = 0; j != k; ++j) {
+      b[j] = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + j)),
+          w[0]);
+    }
+    for (int r = 1; r != 10; ++r) {
+      for (int j = 0; j != k; ++j) {
+        b[j] = _mm_aesenc_si128(b[j], w[r]);
+      }
+    }
+    for (int j = 0; j != k; ++j) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j),
+                       _mm_aesenclast_si128(b[j], w[10]));
+    }
+    in += k;
+    out += k;
+    n -= static_cast<std::size_t>(k);
+  }
+}
+
+__attribute__((target("sse2,aes,avx2,vaes"))) inline void
+vaes_256_fixed_aes_128_encrypt(m128i_block const * in,
+                               m128i_block * out,
+                               std::size_t n) noexcept {
+  PFSS_LOAD_FIXED_RKEYS(w)
+  __m256i v[11];
+  for (int r = 0; r != 11; ++r) {
+    v[r] = _mm256_broadcastsi128_si256(w[r]);
+  }
+  for (; n >= 8; n -= 8) {
+    __m256i b[4];
+    for (int j = 0; j != 4; ++j) {
+      b[j] = _mm256_xor_si256(
+          _mm256_loadu_si256(
+              reinterpret_cast<__m256i const *>(in + 2 * j)),
+          v[0]);
+    }
+    for (int r = 1; r != 10; ++r) {
+      for (int j = 0; j != 4; ++j) {
+        b[j] = _mm256_aesenc_epi128(b[j], v[r]);
+      }
+    }
+    for (int j = 0; j != 4; ++j) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * j),
+                          _mm256_aesenclast_epi128(b[j], v[10]));
+    }
+    in += 8;
+    out += 8;
+  }
+  for (; n != 0; --n) {
+    __m128i b = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(in++)),
+        w[0]);
+    for (int r = 1; r != 10; ++r) {
+      b = _mm_aesenc_si128(b, w[r]);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out++),
+                     _mm_aesenclast_si128(b, w[10]));
+  }
+}
+
+__attribute__((target("sse2,aes,avx512f,vaes"))) inline void
+vaes_512_fixed_aes_128_encrypt(m128i_block const * in,
+                               m128i_block * out,
+                               std::size_t n) noexcept {
+  PFSS_LOAD_FIXED_RKEYS(w)
+  // The zero-masked broadcast avoids a GCC 12 -Wuninitialized false
+  // positive in the unmasked one.
+  __m512i v[11];
+  for (int r = 0; r != 11; ++r) {
+    v[r] = _mm512_maskz_broadcast_i32x4(
+        static_cast<__mmask16>(-1), w[r]);
+  }
+  for (; n >= 16; n -= 16) {
+    __m512i b[4];
+    for (int j = 0; j != 4; ++j) {
+      b[j] = _mm512_xor_si512(_mm512_loadu_si512(in + 4 * j), v[0]);
+    }
+    for (int r = 1; r != 10; ++r) {
+      for (int j = 0; j != 4; ++j) {
+        b[j] = _mm512_aesenc_epi128(b[j], v[r]);
+      }
+    }
+    for (int j = 0; j != 4; ++j) {
+      _mm512_storeu_si512(out + 4 * j,
+                          _mm512_aesenclast_epi128(b[j], v[10]));
+    }
+    in += 16;
+    out += 16;
+  }
+  for (; n >= 4; n -= 4) {
+    __m512i b = _mm512_xor_si512(_mm512_loadu_si512(in), v[0]);
+    for (int r = 1; r != 10; ++r) {
+      b = _mm512_aesenc_epi128(b, v[r]);
+    }
+    _mm512_storeu_si512(out, _mm512_aesenclast_epi128(b, v[10]));
+    in += 4;
+    out += 4;
+  }
+  for (; n != 0; --n) {
+    __m128i b = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(in++)),
+        w[0]);
+    for (int r = 1; r != 10; ++r) {
+      b = _mm_aesenc_si128(b, w[r]);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out++),
+                     _mm_aesenclast_si128(b, w[10]));
+  }
+}
+
+#undef PFSS_LOAD_FIXED_RKEYS
+
+inline void portable_fixed_aes_128_encrypt(m128i_block const * in,
+                                           m128i_block * out,
+                                           std::size_t n) noexcept {
+#if PFSS_WITH_NETTLE
+  nettle_aes_128_encrypt(in, out, n, fixed_nettle_aes_128_rkeys);
+#else
+  for (; n != 0; --n) {
+    fips197::Cipher<4>(reinterpret_cast<unsigned char const *>(in++),
+                       reinterpret_cast<unsigned char *>(out++),
+                       fixed_aes_128_rkeys.data());
+  }
+#endif
+}
+
+struct aes_128_backend final {
+  char const * name;
+  bool (*usable)(cpu_features const &);
+  void (*encrypt)(m128i_block const *, m128i_block *, std::size_t);
+};
+
+// Returns the backends from fastest to slowest, terminated by an entry
+// with a null name. The last real entry is always usable.
+inline aes_128_backend const * get_aes_128_backends() noexcept {
+  static aes_128_backend const backends[] = {
+      {"vaes-512",
+       [](cpu_features const & f) { return f.vaes_512; },
+       vaes_512_fixed_aes_128_encrypt},
+      {"vaes-256",
+       [](cpu_features const & f) { return f.vaes_256; },
+       vaes_256_fixed_aes_128_encrypt},
+      {"aes-ni",
+       [](cpu_features const & f) { return f.aes_ni; },
+       aes_ni_fixed_aes_128_encrypt},
+      {"portable",
+       [](cpu_features const &) { return true; },
+       portable_fixed_aes_128_encrypt},
+      {nullptr, nullptr, nullptr},
+  };
+  return backends;
+}
+
+// Returns the backend with the given name if it is usable on this CPU,
+// or the fastest usable backend if name is null. Returns null if name
+// is unknown or not usable.
+inline aes_128_backend const *
+find_aes_128_backend(char const * const name) noexcept {
+  cpu_features const f = get_cpu_features();
+  for (auto b = get_aes_128_backends(); b->name != nullptr; ++b) {
+    if (name == nullptr || std::strcmp(name, b->name) == 0) {
+      if (b->usable(f)) {
+        return b;
+      }
+      if (name != nullptr) {
+        return nullptr;
+      }
+    }
+  }
+  return nullptr;
+}
+
+inline aes_128_backend const & get_aes_128_backend() noexcept {
+  static aes_128_backend const & backend = []() noexcept
+      -> aes_128_backend const & {
+    aes_128_backend const * b =
+        find_aes_128_backend(std::getenv("PFSS_AES_BACKEND"));
+    if (b == nullptr) {
+      b = find_aes_128_backend(nullptr);
+    }
+    assert(b != nullptr);
+    return *b;
+  }();
+  return backend;
+}
+
+struct fixed_dispatch_aes_128_rand_perm final {
+  using block_type = m128i_block;
+
+  void (*encrypt)(m128i_block const *, m128i_block *, std::size_t) =
+      get_aes_128_backend().encrypt;
+
+  m128i_block operator()(m128i_block const block) const noexcept {
+    m128i_block y;
+    encrypt(&block, &y, 1);
+    return y;
+  }
+
+  void operator()(m128i_block const * const in,
+                  m128i_block * const out,
+                  std::size_t const n) const noexcept {
+    encrypt(in, out, n);
+  }
+};
+
+#endif // PFSS_WITH_CPU_DISPATCH
+
 //----------------------------------------------------------------------
 // default_rand_perm_t
 //----------------------------------------------------------------------
@@ -1800,7 +2626,11 @@ struct default_rand_perm_t<chunked_block<uint64_t, 2>> {
 #if PFSS_WITH_SSE2
 template<>
 struct default_rand_perm_t<m128i_block> {
-#if PFSS_WITH_AES_NI
+#if PFSS_WITH_CPU_DISPATCH
+  using type = fixed_dispatch_aes_128_rand_perm;
+#elif PFSS_WITH_VAES
+  using type = fixed_vaes_512_rand_perm<m128i_block>;
+#elif PFSS_WITH_AES_NI
   using type = fixed_aes_ni_128_rand_perm;
 #elif PFSS_WITH_NETTLE
   using type = fixed_nettle_aes_128_rand_perm<m128i_block>;
@@ -12,12 +12,15 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
-#include <future>
+#include <exception>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <pfss/bgi1.h>
 #include <pfss/common.h>
 #include <pfss/config.h>
@@ -27,6 +30,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -186,6 +190,78 @@ constexpr uint32_t uint32_max = type_max<uint32_t>();
 
 using uint_buf_type = uint_buf<uint32_t>;
 
+//
+// Converts a domain element to the domain type of a scheme. Schemes
+// with a fixed domain_bits take a native integer type (see
+// pick_domain_type), so the conversion happens once here instead of on
+// every level of the tree. The others take uint_buf_type as is.
+//
+
+template<class Domain>
+Domain to_domain(uint_buf_type const & x) noexcept {
+  return x.get_as<Domain>();
+}
+
+template<>
+uint_buf_type to_domain<uint_buf_type>(uint_buf_type const & x) noexcept {
+  return x;
+}
+
+//
+// Holds a batch of domain elements converted to the domain type of a
+// scheme, for the scheme functions that read the elements of a batch
+// again on every level. load returns something that the scheme can
+// index (or, for packed elements, iterate over) and stays valid until
+// the next load. The storage is reused from load to load.
+//
+
+template<class Domain>
+class domain_batch {
+  std::vector<Domain> xs_;
+
+public:
+  template<class Xs>
+  Domain const * load(Xs const & xs, std::size_t const count) {
+    if (xs_.size() < count) {
+      xs_.resize(count);
+    }
+    for (std::size_t j = 0; j != count; ++j) {
+      xs_[j] = xs[j].template get_as<Domain>();
+    }
+    return xs_.data();
+  }
+
+  Domain const * load(uint8_t const * const xs,
+                      std::size_t const count,
+                      uint32_t const x_size,
+                      bool const x_is_little_endian) {
+    if (xs_.size() < count) {
+      xs_.resize(count);
+    }
+    for (std::size_t j = 0; j != count; ++j) {
+      uint_buf_type const x(xs + j * x_size, x_size, x_is_little_endian);
+      xs_[j] = x.get_as<Domain>();
+    }
+    return xs_.data();
+  }
+};
+
+template<>
+class domain_batch<uint_buf_type> {
+public:
+  template<class Xs>
+  Xs const & load(Xs const & xs, std::size_t) noexcept {
+    return xs;
+  }
+
+  uint_buf_iterator<uint32_t> load(uint8_t const * const xs,
+                                   std::size_t,
+                                   uint32_t const x_size,
+                                   bool const x_is_little_endian) {
+    return uint_buf_iterator<uint32_t>(xs, x_size, x_is_little_endian);
+  }
+};
+
 //
 //
 //
@@ -255,6 +331,17 @@ bool validate_endianness(pfss_endianness const e) {
   return system_is_little_endian();
 }
 
+// Returns true for PFSS_POINT_MAJOR and false for PFSS_KEY_MAJOR.
+bool validate_layout(pfss_layout const layout) {
+  if (layout == PFSS_POINT_MAJOR) {
+    return true;
+  }
+  if (layout != PFSS_KEY_MAJOR) {
+    throw error(PFSS_INVALID_ARGUMENT);
+  }
+  return false;
+}
+
 template<class Scheme>
 void inner_gen_sizes(
     Scheme const & scheme,
@@ -308,7 +395,7 @@ void inner_gen(
   typename Scheme::rng_type rng(rand_buf, Scheme::rand_buf_size());
   scheme.gen(
       keys,
-      alpha_buf,
+      to_domain<typename Scheme::domain_type>(alpha_buf),
       beta_buf.template get_as<typename Scheme::range_type>() &
           get_mask<typename Scheme::range_type>(scheme.range_bits),
       rand_perm,
@@ -330,7 +417,8 @@ void inner_eval(
     bool const y_is_little_endian) {
   uint_buf_type const x_buf(x, x_size, x_is_little_endian);
   uint_buf_type y_buf(y, y_size, y_is_little_endian);
-  y_buf = scheme.eval(key, x_buf, rand_perm);
+  y_buf = scheme.eval(
+      key, to_domain<typename Scheme::domain_type>(x_buf), rand_perm);
 }
 
 } // namespace
@@ -380,6 +468,46 @@ char const * pfss_get_status_name(pfss_status const status) {
   return ret;
 }
 
+//----------------------------------------------------------------------
+// pfss_get_aes_backend
+//----------------------------------------------------------------------
+
+namespace {
+
+char const * pfss_get_aes_backend_nolog() noexcept {
+#if PFSS_WITH_CPU_DISPATCH
+  return pfss::get_aes_128_backend().name;
+#elif PFSS_WITH_VAES
+  return "vaes-512";
+#elif PFSS_WITH_AES_NI
+  return "aes-ni";
+#elif PFSS_WITH_ARM_CRYPTO
+  return "arm-crypto";
+#else
+  return "portable";
+#endif
+}
+
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+char const * pfss_get_aes_backend() {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_get_aes_backend_nolog();
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 ret);
+    }
+  }
+  return ret;
+}
+
 //----------------------------------------------------------------------
 //
 //
@@ -407,6 +535,34 @@ struct pick_range_type<64> {
   using type = uint64_t;
 };
 
+//
+// The domain type for a fixed DomainBits is the narrowest of uint32_t,
+// uint64_t, and unsigned __int128 (where the compiler treats it as an
+// integer type) that holds DomainBits bits, or uint_buf_type if none
+// of them do.
+//
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 uint128_type;
+#else
+using uint128_type = uint_buf_type;
+#endif
+
+template<int DomainBits>
+struct pick_domain_type {
+  using type = typename std::conditional<
+      DomainBits <= 32,
+      uint32_t,
+      typename std::conditional<
+          DomainBits <= 64,
+          uint64_t,
+          typename std::conditional<
+              DomainBits <= 128
+                  && std::is_integral<uint128_type>::value,
+              uint128_type,
+              uint_buf_type>::type>::type>::type;
+};
+
 //
 //
 
@@ -421,7 +577,7 @@ template<
 using scheme_type = Scheme<
     DomainBits,
     RangeBits,
-    uint_buf_type,
+    typename pick_domain_type<DomainBits>::type,
     typename pick_range_type<RangeBits>::type,
     block_type,
     rand_perm_type,
@@ -441,6 +597,254 @@ using default_scheme_type =
 
 using default_scheme_type_v = scheme_type_v<pfss::bgi1_v>;
 
+//----------------------------------------------------------------------
+// pfss_eval_context
+//----------------------------------------------------------------------
+
+namespace {
+
+//
+// A set of worker threads that stays alive between calls.
+// run(width, n, f) calls f(i, w) for every i in [0, n), where w
+// identifies the thread that makes the call: 0 is the calling thread
+// and 1, 2, ... are the workers. Only threads with w < width take
+// tasks. The calling thread takes tasks too, and run returns once all
+// n calls have finished, rethrowing the first exception that any of
+// them threw. Only one run may be in progress at a time.
+//
+
+class thread_pool final {
+public:
+  using task_type = std::function<void(std::size_t, std::size_t)>;
+
+private:
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::vector<std::thread> threads_;
+  task_type const * task_ = nullptr;
+  std::size_t width_ = 0;
+  std::size_t task_count_ = 0;
+  std::size_t next_task_ = 0;
+  std::size_t pending_ = 0;
+  std::size_t generation_ = 0;
+  std::exception_ptr error_;
+  bool stop_ = false;
+
+  // Runs tasks from the current batch until there are none left to
+  // start. The lock must be held on entry and is held on exit.
+  void drain(std::unique_lock<std::mutex> & lock,
+             std::size_t const w) noexcept {
+    if (w >= width_) {
+      return;
+    }
+    while (next_task_ != task_count_) {
+      std::size_t const i = next_task_++;
+      lock.unlock();
+      std::exception_ptr e;
+      try {
+        (*task_)(i, w);
+      } catch (...) {
+        e = std::current_exception();
+      }
+      lock.lock();
+      if (e != nullptr && error_ == nullptr) {
+        error_ = e;
+      }
+      if (--pending_ == 0) {
+        done_cv_.notify_one();
+      }
+    }
+  }
+
+  void work(std::size_t const w) noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t seen = generation_;
+    while (true) {
+      work_cv_.wait(lock,
+                    [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+      drain(lock, w);
+    }
+  }
+
+public:
+  thread_pool() = default;
+
+  thread_pool(thread_pool const &) = delete;
+  thread_pool & operator=(thread_pool const &) = delete;
+
+  ~thread_pool() noexcept {
+    {
+      std::lock_guard<std::mutex> const lock(mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread & t : threads_) {
+      t.join();
+    }
+  }
+
+  // The number of threads that run can use, including the caller.
+  std::size_t size() const noexcept {
+    return threads_.size() + 1;
+  }
+
+  // Starts workers until size() is at least n.
+  void grow(std::size_t const n) {
+    while (size() < n) {
+      threads_.emplace_back(&thread_pool::work, this, size());
+    }
+  }
+
+  void run(std::size_t const width,
+           std::size_t const n,
+           task_type const & f) {
+    assert(width > 0);
+    if (n == 0) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &f;
+    width_ = width;
+    task_count_ = n;
+    next_task_ = 0;
+    pending_ = n;
+    ++generation_;
+    if (width > 1 && n > 1) {
+      work_cv_.notify_all();
+    }
+    drain(lock, 0);
+    done_cv_.wait(lock, [&] { return pending_ == 0; });
+    task_ = nullptr;
+    if (error_ != nullptr) {
+      std::exception_ptr e;
+      std::swap(e, error_);
+      std::rethrow_exception(e);
+    }
+  }
+};
+
+//
+// The state that one thread needs to evaluate keys. The rand_perm is
+// constructed once and reused, and eval_all keeps its buffers here so
+// that evaluating many keys does not allocate for each one.
+//
+
+struct eval_scratch {
+  rand_perm_type rand_perm;
+  bgi1_eval_all_scratch<block_type> eval_all;
+  std::vector<unsigned long long> dot_partials;
+  std::vector<std::uint64_t> packed_tile;
+};
+
+} // namespace
+
+struct pfss_eval_context {
+  // Calls that share a context take turns.
+  std::mutex mutex;
+  thread_pool pool;
+  // scratch[w] belongs to thread w of the pool.
+  std::vector<std::unique_ptr<eval_scratch>> scratch;
+
+  eval_scratch & main_scratch() {
+    if (scratch.empty()) {
+      scratch.emplace_back(new eval_scratch);
+    }
+    return *scratch[0];
+  }
+
+  // Calls f(i, s) for every i in [0, n) on up to width threads, where
+  // s is the scratch of the thread that makes the call. The mutex must
+  // be held.
+  template<class F>
+  void run(std::size_t const width, std::size_t const n, F const & f) {
+    pool.grow(width);
+    while (scratch.size() < pool.size()) {
+      scratch.emplace_back(new eval_scratch);
+    }
+    pool.run(width, n, [&](std::size_t const i, std::size_t const w) {
+      f(i, *scratch[w]);
+    });
+  }
+};
+
+namespace {
+
+pfss_status
+pfss_eval_context_create_nolog(pfss_eval_context ** const p_context) {
+  try {
+    validate_pointer(p_context);
+    *p_context = new pfss_eval_context;
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_context_create(pfss_eval_context ** const p_context) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_context_create_nolog(p_context);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 p_context);
+    }
+  }
+  return ret;
+}
+
+namespace {
+
+pfss_status
+pfss_eval_context_destroy_nolog(pfss_eval_context * const context) {
+  try {
+    validate_pointer(context);
+    delete context;
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_context_destroy(pfss_eval_context * const context) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_context_destroy_nolog(context);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context);
+    }
+  }
+  return ret;
+}
+
 //----------------------------------------------------------------------
 // pfss_gen_sizes
 //----------------------------------------------------------------------
@@ -657,34 +1061,116 @@ pfss_status pfss_gen(uint32_t const domain_bits,
 
 namespace {
 
+// Lets gen_n index into an array of alpha_size-byte domain slots.
+class alpha_array {
+  uint8_t const * const alphas_;
+  uint32_t const alpha_size_;
+  bool const alpha_is_little_endian_;
+
+public:
+  explicit alpha_array(uint8_t const * const alphas,
+                       uint32_t const alpha_size,
+                       bool const alpha_is_little_endian) noexcept
+      : alphas_(alphas),
+        alpha_size_(alpha_size),
+        alpha_is_little_endian_(alpha_is_little_endian) {
+  }
+
+  uint_buf_type operator[](std::size_t const i) const noexcept {
+    return uint_buf_type(alphas_ + i * alpha_size_,
+                         alpha_size_,
+                         alpha_is_little_endian_);
+  }
+
+  alpha_array from(std::size_t const i) const noexcept {
+    return alpha_array(alphas_ + i * alpha_size_,
+                       alpha_size_,
+                       alpha_is_little_endian_);
+  }
+};
+
+// pfss_map_gen splits the alphas into about
+// 2^map_gen_slack_bits tasks per thread, each a run of whole batches.
+constexpr int map_gen_slack_bits = 2;
+
+//
+// Generates the key pairs for alphas [first, last) in batches of
+// Scheme::gen_batch, with the batch's keys moving down the tree in
+// lockstep.
+//
+
+template<class Scheme>
+void map_gen_range(Scheme const & scheme,
+                   std::size_t const first,
+                   std::size_t const last,
+                   alpha_array const & alphas,
+                   uint8_t const * const betas,
+                   uint32_t const beta_size,
+                   bool const beta_is_little_endian,
+                   uint8_t * const key1_blobs,
+                   uint8_t * const key2_blobs,
+                   uint8_t const * const rand_bufs,
+                   typename Scheme::rand_perm_type & rand_perm) {
+  using range_type = typename Scheme::range_type;
+  using block_type = typename Scheme::block_type;
+  using rng_type = typename Scheme::rng_type;
+  std::size_t const batch = Scheme::gen_batch;
+  std::size_t const key_blob_size = scheme.key_blob_size();
+  std::size_t const rand_buf_size = scheme.rand_buf_size();
+  range_type const mask = get_mask<range_type>(scheme.range_bits);
+  std::array<range_type, Scheme::gen_batch> bs;
+  std::array<block_type, 2 * Scheme::gen_batch> seeds;
+  domain_batch<typename Scheme::domain_type> batch_alphas;
+  for (std::size_t i = first; i < last; i += batch) {
+    std::size_t const n = pfss::min(batch, last - i);
+    for (std::size_t k = 0; k != n; ++k) {
+      uint_buf_type const beta_buf(
+          betas + (i + k) * beta_size, beta_size, beta_is_little_endian);
+      bs[k] = beta_buf.template get_as<range_type>() & mask;
+      rng_type rng(rand_bufs + (i + k) * rand_buf_size, rand_buf_size);
+      seeds[2 * k] = rng();
+      seeds[2 * k + 1] = rng();
+    }
+    alpha_array const alphas_i = alphas.from(i);
+    scheme.gen_n(n,
+                 batch_alphas.load(alphas_i, n),
+                 bs.data(),
+                 seeds.data(),
+                 rand_perm,
+                 key1_blobs + i * key_blob_size,
+                 key2_blobs + i * key_blob_size);
+  }
+}
+
 #define COMMON_CODE() \
   do { \
-    typename Scheme::key_type keys[2] = { \
-        scheme.make_key(), scheme.make_key()}; \
-    typename Scheme::rand_perm_type rand_perm; \
-    while (alphas_count--) { \
-      uint_buf_type const alpha_buf( \
-          alphas, alpha_size, alpha_is_little_endian); \
-      uint_buf_type const beta_buf( \
-          betas, beta_size, beta_is_little_endian); \
-      typename Scheme::rng_type rng( \
-          rand_bufs, scheme.rand_buf_size()); \
-      scheme.gen( \
-          keys, \
-          alpha_buf, \
-          beta_buf.template get_as<typename Scheme::range_type>() & \
-              get_mask<typename Scheme::range_type>( \
-                  scheme.range_bits), \
-          rand_perm, \
-          rng); \
-      keys[0].serialize(key1_blobs); \
-      keys[1].serialize(key2_blobs); \
-      alphas += alpha_size; \
-      betas += beta_size; \
-      key1_blobs += scheme.key_blob_size(); \
-      key2_blobs += scheme.key_blob_size(); \
-      rand_bufs += scheme.rand_buf_size(); \
-    } \
+    std::size_t const batches = \
+        (alphas_count + Scheme::gen_batch - 1) / Scheme::gen_batch; \
+    std::size_t const tasks = \
+        pfss::min(batches, num_threads << map_gen_slack_bits); \
+    alpha_array const alphas_array( \
+        alphas, alpha_size, alpha_is_little_endian); \
+    context->run( \
+        pfss::min(num_threads, tasks), \
+        tasks, \
+        [&](std::size_t const t, eval_scratch & scratch) { \
+          std::size_t const first = \
+              batches * t / tasks * Scheme::gen_batch; \
+          std::size_t const last = pfss::min( \
+              batches * (t + 1) / tasks * Scheme::gen_batch, \
+              std::size_t(alphas_count)); \
+          map_gen_range(scheme, \
+                        first, \
+                        last, \
+                        alphas_array, \
+                        betas, \
+                        beta_size, \
+                        beta_is_little_endian, \
+                        key1_blobs, \
+                        key2_blobs, \
+                        rand_bufs, \
+                        scratch.rand_perm); \
+        }); \
   } while (0)
 
 #define TEMPLATE_CODE(DomainBits, RangeBits) \
@@ -702,19 +1188,22 @@ namespace {
     COMMON_CODE(); \
   } while (0)
 
-pfss_status pfss_map_gen_nolog(uint32_t const domain_bits,
+pfss_status pfss_map_gen_nolog(pfss_eval_context * const context,
+                               uint32_t const domain_bits,
                                uint32_t const range_bits,
-                               uint8_t const * alphas,
-                               uint32_t alphas_count,
+                               uint8_t const * const alphas,
+                               uint32_t const alphas_count,
                                uint32_t const alpha_size,
                                pfss_endianness const alpha_endianness,
-                               uint8_t const * betas,
+                               uint8_t const * const betas,
                                uint32_t const beta_size,
                                pfss_endianness const beta_endianness,
-                               uint8_t * key1_blobs,
-                               uint8_t * key2_blobs,
-                               uint8_t const * rand_bufs) {
+                               uint8_t * const key1_blobs,
+                               uint8_t * const key2_blobs,
+                               uint8_t const * const rand_bufs,
+                               uint32_t const thread_count) {
   try {
+    validate_pointer(context);
     validate_domain_bits(domain_bits);
     validate_range_bits(range_bits);
     validate_pointer(alphas);
@@ -729,6 +1218,9 @@ pfss_status pfss_map_gen_nolog(uint32_t const domain_bits,
     validate_pointer(key1_blobs);
     validate_pointer(key2_blobs);
     validate_pointer(rand_bufs);
+    validate_size(thread_count);
+    std::size_t const num_threads = thread_count;
+    std::lock_guard<std::mutex> const lock(context->mutex);
     PFSS_SWITCH_DB_RB(domain_bits,
                       range_bits,
                       TEMPLATE_CODE,
@@ -763,7 +1255,9 @@ pfss_status pfss_map_gen(uint32_t const domain_bits,
                          uint8_t * key2_blobs,
                          uint8_t const * rand_bufs) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_map_gen_nolog(domain_bits,
+  pfss_eval_context context;
+  auto const ret = pfss_map_gen_nolog(&context,
+                                      domain_bits,
                                       range_bits,
                                       alphas,
                                       alphas_count,
@@ -774,7 +1268,8 @@ pfss_status pfss_map_gen(uint32_t const domain_bits,
                                       beta_endianness,
                                       key1_blobs,
                                       key2_blobs,
-                                      rand_bufs);
+                                      rand_bufs,
+                                      1);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -801,15 +1296,166 @@ pfss_status pfss_map_gen(uint32_t const domain_bits,
   return ret;
 }
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_gen_mt(uint32_t const domain_bits,
+                            uint32_t const range_bits,
+                            uint8_t const * const alphas,
+                            uint32_t const alphas_count,
+                            uint32_t const alpha_size,
+                            pfss_endianness const alpha_endianness,
+                            uint8_t const * const betas,
+                            uint32_t const beta_size,
+                            pfss_endianness const beta_endianness,
+                            uint8_t * const key1_blobs,
+                            uint8_t * const key2_blobs,
+                            uint8_t const * const rand_bufs,
+                            uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_gen_nolog(&context,
+                                      domain_bits,
+                                      range_bits,
+                                      alphas,
+                                      alphas_count,
+                                      alpha_size,
+                                      alpha_endianness,
+                                      betas,
+                                      beta_size,
+                                      beta_endianness,
+                                      key1_blobs,
+                                      key2_blobs,
+                                      rand_bufs,
+                                      thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 domain_bits,
+                 range_bits,
+                 alphas,
+                 alphas_count,
+                 alpha_size,
+                 alpha_endianness,
+                 betas,
+                 beta_size,
+                 beta_endianness,
+                 key1_blobs,
+                 key2_blobs,
+                 rand_bufs,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
 //----------------------------------------------------------------------
 // pfss_parse_key
 //----------------------------------------------------------------------
 
+namespace {
+
+struct map_eval_plan;
+struct map_eval_keys_plan;
+
+//
+// The functions that operate on a key, instantiated for the scheme that
+// the key was parsed with. pfss_parse_key goes through PFSS_SWITCH_DB_RB
+// once to pick the table for the key, and every later call on the key
+// jumps straight to the right instantiation through it. The entries are
+// defined in the sections of the functions that call them, and the
+// tables themselves are built by get_key_ops at the end of this file.
+//
+
+struct key_ops {
+  void (*destroy)(pfss_key const * key);
+  void (*destroy_key_set)(pfss_key_set * key_set);
+  void (*eval)(pfss_key const * key,
+               uint8_t const * x,
+               uint32_t x_size,
+               bool x_is_little_endian,
+               uint8_t * y,
+               uint32_t y_size,
+               bool y_is_little_endian);
+  void (*map_eval)(pfss_eval_context * context,
+                   pfss_key const * key,
+                   uint8_t const * xs,
+                   uint32_t x_size,
+                   bool x_is_little_endian,
+                   uint8_t * ys,
+                   uint32_t y_size,
+                   bool y_is_little_endian,
+                   map_eval_plan const & plan);
+  void (*map_eval_sorted)(pfss_eval_context * context,
+                          pfss_key const * key,
+                          uint8_t const * xs,
+                          uint32_t x_size,
+                          bool x_is_little_endian,
+                          uint8_t * ys,
+                          uint32_t y_size,
+                          bool y_is_little_endian,
+                          int xs_are_sorted,
+                          map_eval_plan const & plan);
+  void (*map_eval_keys)(pfss_eval_context * context,
+                        pfss_key const * const * keys,
+                        uint32_t keys_count,
+                        uint8_t const * xs,
+                        uint32_t x_size,
+                        bool x_is_little_endian,
+                        uint8_t * ys,
+                        std::size_t key_stride,
+                        std::size_t x_stride,
+                        uint32_t y_size,
+                        bool y_is_little_endian,
+                        map_eval_keys_plan const & plan);
+  void (*map_eval_reduce_sum)(pfss_eval_context * context,
+                              pfss_key const * key,
+                              uint8_t const * xs,
+                              uint32_t x_size,
+                              bool x_is_little_endian,
+                              uint8_t * y,
+                              uint32_t y_size,
+                              bool y_is_little_endian,
+                              map_eval_plan const & plan);
+  void (*eval_all)(pfss_eval_context * context,
+                   pfss_key const * key,
+                   std::size_t x,
+                   int rbits,
+                   std::size_t num_threads,
+                   uint8_t * ys,
+                   uint32_t y_size,
+                   bool y_is_little_endian);
+  void (*eval_all_packed)(pfss_eval_context * context,
+                          pfss_key const * key,
+                          std::size_t x,
+                          int rbits,
+                          std::size_t num_threads,
+                          uint8_t * ys);
+  void (*eval_range)(pfss_eval_context * context,
+                     pfss_key const * key,
+                     std::size_t x_lo,
+                     std::size_t x_hi,
+                     uint32_t thread_count,
+                     uint8_t * ys,
+                     uint32_t y_size,
+                     bool y_is_little_endian);
+};
+
+template<class Scheme>
+key_ops const * get_key_ops() noexcept;
+
+} // namespace
+
 struct pfss_key {
   std::array<unsigned char, 1> header;
   int domain_bits;
   int range_bits;
   void * inner_key;
+  key_ops const * ops;
 };
 
 namespace {
@@ -823,6 +1469,7 @@ namespace {
     } \
     inner_key->parse(key_blob); \
     key->inner_key = inner_key.release(); \
+    key->ops = get_key_ops<Scheme>(); \
   } while (0)
 
 #define TEMPLATE_CODE(DomainBits, RangeBits) \
@@ -911,11 +1558,208 @@ pfss_status pfss_parse_key(pfss_key ** const p_key,
 
 namespace {
 
-#define COMMON_CODE() \
-  do { \
-    Scheme const scheme(key->domain_bits, key->range_bits); \
-    scheme.delete_key(k->inner_key); \
-  } while (0)
+template<class Scheme>
+void destroy_key_op(pfss_key const * const key) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  scheme.delete_key(key->inner_key);
+}
+
+pfss_status pfss_destroy_key_nolog(pfss_key * const key) {
+  try {
+    validate_pointer(key);
+    std::unique_ptr<pfss_key> k(key);
+    if (k->header[0] == 0) {
+      k->ops->destroy(k.get());
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_destroy_key(pfss_key * const key) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_destroy_key_nolog(key);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_parse_keys
+//----------------------------------------------------------------------
+
+//
+// A key set holds keys that were parsed together from blobs with the
+// same header, domain_bits, and range_bits. The inner keys live in one
+// arena allocated for the scheme's key type, and keys[i].inner_key
+// points to element i of it, so parsing a set takes a few allocations
+// instead of two for each key. A set opened in place from a key store
+// has no arena, and its inner keys point into the store instead.
+//
+
+struct pfss_key_set {
+  std::vector<pfss_key> keys;
+  std::vector<pfss_key const *> key_ptrs;
+  void * arena = nullptr;
+
+  pfss_key_set() = default;
+  pfss_key_set(pfss_key_set const &) = delete;
+  pfss_key_set & operator=(pfss_key_set const &) = delete;
+
+  ~pfss_key_set() {
+    if (arena != nullptr) {
+      keys[0].ops->destroy_key_set(this);
+    }
+  }
+
+  uint32_t keys_count() const noexcept {
+    return static_cast<uint32_t>(keys.size());
+  }
+};
+
+namespace {
+
+//
+// Let the functions that take an array of keys take a key set instead.
+// A null key set gives a null array, which those functions reject.
+//
+
+pfss_key const * const *
+key_set_keys(pfss_key_set const * const key_set) noexcept {
+  return key_set == nullptr ? nullptr : key_set->key_ptrs.data();
+}
+
+uint32_t key_set_keys_count(pfss_key_set const * const key_set) noexcept {
+  return key_set == nullptr ? 0 : key_set->keys_count();
+}
+
+// pfss_parse_keys gives each thread at least this many keys.
+constexpr std::size_t parse_keys_min_task = 256;
+
+// When pfss_parse_keys runs on more than one thread, it splits the keys
+// into about 2^parse_keys_slack_bits tasks per thread.
+constexpr int parse_keys_slack_bits = 2;
+
+template<class Scheme>
+void destroy_key_set_op(pfss_key_set * const key_set) {
+  using key_type = typename Scheme::key_type;
+  key_type * const arena = static_cast<key_type *>(key_set->arena);
+  std::size_t const n = key_set->keys.size();
+  for (std::size_t i = 0; i != n; ++i) {
+    arena[i].~key_type();
+  }
+  std::allocator<key_type>().deallocate(arena, n);
+}
+
+//
+// Parses keys_count blobs of key_blob_size bytes each into key_set on
+// up to thread_count threads, where blob i starts at key_blobs + i *
+// blob_stride. Each task checks,
+// constructs, and parses its own keys, so every blob is only touched by
+// one thread. If any task fails, the keys that were constructed are
+// destroyed before the exception is passed on.
+//
+
+template<class Scheme>
+void parse_keys_op(pfss_eval_context & context,
+                   pfss_key_set & key_set,
+                   uint8_t const * const key_blobs,
+                   uint32_t const keys_count,
+                   uint32_t const key_blob_size,
+                   std::size_t const blob_stride,
+                   uint32_t const thread_count) {
+  using key_type = typename Scheme::key_type;
+  int const domain_bits = static_cast<int>(key_blobs[1]);
+  int const range_bits = static_cast<int>(key_blobs[2]);
+  Scheme const scheme(domain_bits, range_bits);
+  if (key_blob_size != scheme.key_blob_size()) {
+    throw error(PFSS_MALFORMED_KEY);
+  }
+  std::size_t const n = keys_count;
+  std::size_t const max_threads = n / parse_keys_min_task + 1;
+  std::size_t const num_threads =
+      pfss::unsigned_lt(thread_count, max_threads) ?
+          static_cast<std::size_t>(thread_count) :
+          max_threads;
+  std::size_t const tasks =
+      num_threads == 1 ?
+          1 :
+          pfss::min(n, num_threads << parse_keys_slack_bits);
+  auto const first = [=](std::size_t const t) -> std::size_t {
+    return t * (n / tasks) + pfss::min(t, n % tasks);
+  };
+  key_set.keys.resize(n);
+  key_set.key_ptrs.resize(n);
+  key_ops const * const ops = get_key_ops<Scheme>();
+  key_type * const arena = std::allocator<key_type>().allocate(n);
+  // built[t] is the number of keys that task t has constructed.
+  std::vector<std::size_t> built(tasks);
+  try {
+    context.run(
+        num_threads,
+        tasks,
+        [&](std::size_t const t, eval_scratch &) {
+          for (std::size_t i = first(t); i != first(t + 1); ++i) {
+            uint8_t const * const key_blob = key_blobs + i * blob_stride;
+            if (key_blob[0] != key_blobs[0]
+                || key_blob[1] != key_blobs[1]
+                || key_blob[2] != key_blobs[2]) {
+              throw error(PFSS_INVALID_ARGUMENT);
+            }
+            key_type * const inner_key =
+                ::new (static_cast<void *>(arena + i))
+                    key_type(scheme.make_key());
+            ++built[t];
+            inner_key->parse(key_blob);
+            pfss_key & key = key_set.keys[i];
+            std::copy_n(key_blob, 1, key.header.begin());
+            key.domain_bits = domain_bits;
+            key.range_bits = range_bits;
+            key.inner_key = inner_key;
+            key.ops = ops;
+            key_set.key_ptrs[i] = &key;
+          }
+        });
+  } catch (...) {
+    for (std::size_t t = 0; t != tasks; ++t) {
+      for (std::size_t i = first(t); i != first(t) + built[t]; ++i) {
+        arena[i].~key_type();
+      }
+    }
+    std::allocator<key_type>().deallocate(arena, n);
+    throw;
+  }
+  key_set.arena = arena;
+}
+
+#define COMMON_CODE() \
+  do { \
+    parse_keys_op<Scheme>(context, \
+                          *key_set, \
+                          key_blobs, \
+                          keys_count, \
+                          key_blob_size, \
+                          key_blob_size, \
+                          thread_count); \
+  } while (0)
 
 #define TEMPLATE_CODE(DomainBits, RangeBits) \
   do { \
@@ -929,20 +1773,42 @@ namespace {
     COMMON_CODE(); \
   } while (0)
 
-pfss_status pfss_destroy_key_nolog(pfss_key * const key) {
+pfss_status pfss_parse_keys_nolog(pfss_key_set ** const p_key_set,
+                                  uint8_t const * const key_blobs,
+                                  uint32_t const keys_count,
+                                  uint32_t const key_blob_size,
+                                  uint32_t const thread_count) {
   try {
-    validate_pointer(key);
-    std::unique_ptr<pfss_key> k(key);
-    if (k->header[0] == 0) {
+    validate_pointer(p_key_set);
+    validate_pointer(key_blobs);
+    validate_size(keys_count);
+    validate_size(key_blob_size);
+    validate_size(thread_count);
+    if (!pfss::unsigned_le(
+            keys_count,
+            pfss::type_max<std::size_t>::value / key_blob_size)) {
+      throw error(PFSS_INVALID_ARGUMENT);
+    }
+    std::unique_ptr<pfss_key_set> key_set(new pfss_key_set);
+    if (key_blobs[0] == 0) {
+      if (key_blob_size < 3) {
+        throw error(PFSS_MALFORMED_KEY);
+      }
+      pfss_eval_context context;
+      std::lock_guard<std::mutex> const lock(context.mutex);
 #define SCHEME_CLASS pfss::bgi1
 #define SCHEME_CLASS_V pfss::bgi1_v
       PFSS_SWITCH_DB_RB(
-          k->domain_bits, k->range_bits, TEMPLATE_CODE, STANDARD_CODE);
+          static_cast<int>(key_blobs[1]),
+          static_cast<int>(key_blobs[2]),
+          TEMPLATE_CODE,
+          STANDARD_CODE);
 #undef SCHEME_CLASS_V
 #undef SCHEME_CLASS
     } else {
       throw error(PFSS_UNKNOWN_ERROR);
     }
+    *p_key_set = key_set.release();
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -957,12 +1823,20 @@ pfss_status pfss_destroy_key_nolog(pfss_key * const key) {
 
 #undef COMMON_CODE
 
-}
+} // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_destroy_key(pfss_key * const key) {
+pfss_status pfss_parse_keys(pfss_key_set ** const p_key_set,
+                            uint8_t const * const key_blobs,
+                            uint32_t const keys_count,
+                            uint32_t const key_blob_size,
+                            uint32_t const thread_count) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_destroy_key_nolog(key);
+  auto const ret = pfss_parse_keys_nolog(p_key_set,
+                                         key_blobs,
+                                         keys_count,
+                                         key_blob_size,
+                                         thread_count);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -972,28 +1846,26 @@ pfss_status pfss_destroy_key(pfss_key * const key) {
                  post_call_info,
                  __func__,
                  boxed_status(ret),
-                 key);
+                 p_key_set,
+                 key_blobs,
+                 keys_count,
+                 key_blob_size,
+                 thread_count);
     }
   }
   return ret;
 }
 
 //----------------------------------------------------------------------
-// pfss_get_domain_bits
+// pfss_destroy_key_set
 //----------------------------------------------------------------------
 
 namespace {
 
-pfss_status pfss_get_domain_bits_nolog(pfss_key const * const key,
-                                       uint32_t * const domain_bits) {
+pfss_status pfss_destroy_key_set_nolog(pfss_key_set * const key_set) {
   try {
-    validate_pointer(key);
-    validate_pointer(domain_bits);
-    if (key->header[0] == 0) {
-      *domain_bits = static_cast<uint32_t>(key->domain_bits);
-    } else {
-      throw error(PFSS_UNKNOWN_ERROR);
-    }
+    validate_pointer(key_set);
+    delete key_set;
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -1005,10 +1877,9 @@ pfss_status pfss_get_domain_bits_nolog(pfss_key const * const key,
 } // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_get_domain_bits(pfss_key const * const key,
-                                 uint32_t * const domain_bits) {
+pfss_status pfss_destroy_key_set(pfss_key_set * const key_set) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_get_domain_bits_nolog(key, domain_bits);
+  auto const ret = pfss_destroy_key_set_nolog(key_set);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -1018,29 +1889,28 @@ pfss_status pfss_get_domain_bits(pfss_key const * const key,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
-                 key,
-                 domain_bits);
+                 key_set);
     }
   }
   return ret;
 }
 
 //----------------------------------------------------------------------
-// pfss_get_range_bits
+// pfss_get_key_set_key
 //----------------------------------------------------------------------
 
 namespace {
 
-pfss_status pfss_get_range_bits_nolog(pfss_key const * const key,
-                                      uint32_t * const range_bits) {
+pfss_status pfss_get_key_set_key_nolog(pfss_key_set const * const key_set,
+                                       uint32_t const i,
+                                       pfss_key const ** const p_key) {
   try {
-    validate_pointer(key);
-    validate_pointer(range_bits);
-    if (key->header[0] == 0) {
-      *range_bits = static_cast<uint32_t>(key->range_bits);
-    } else {
-      throw error(PFSS_UNKNOWN_ERROR);
+    validate_pointer(key_set);
+    validate_pointer(p_key);
+    if (i >= key_set->keys_count()) {
+      throw error(PFSS_INVALID_ARGUMENT);
     }
+    *p_key = key_set->key_ptrs[i];
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -1052,10 +1922,11 @@ pfss_status pfss_get_range_bits_nolog(pfss_key const * const key,
 } // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_get_range_bits(pfss_key const * const key,
-                                uint32_t * const range_bits) {
+pfss_status pfss_get_key_set_key(pfss_key_set const * const key_set,
+                                 uint32_t const i,
+                                 pfss_key const ** const p_key) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_get_range_bits_nolog(key, range_bits);
+  auto const ret = pfss_get_key_set_key_nolog(key_set, i, p_key);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -1065,76 +1936,152 @@ pfss_status pfss_get_range_bits(pfss_key const * const key,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
-                 key,
-                 range_bits);
+                 key_set,
+                 i,
+                 p_key);
     }
   }
   return ret;
 }
 
 //----------------------------------------------------------------------
-// pfss_eval
+// pfss_key_store_size
 //----------------------------------------------------------------------
 
+//
+// A key store is a byte image of a key set that can be mapped from a
+// file and opened in place. It starts with a key_store_header_size-byte
+// header, with all integers little-endian:
+//
+//   bytes  0..7    "PFSSKEYS"
+//   bytes  8..11   key_store_version
+//   bytes 12..15   key_store_header_size
+//   bytes 16..23   keys_count
+//   bytes 24..27   key_blob_size
+//   bytes 28..31   record_size
+//   bytes 32..35   image_size
+//   bytes 36..39   image_align
+//   byte  40       the key header
+//   byte  41       domain_bits
+//   byte  42       range_bits
+//   byte  43       1 if the images are little-endian, otherwise 0
+//   bytes 44..63   zero
+//
+// Record i follows at key_store_header_size + i * record_size, where
+// record_size is a multiple of key_store_align. It holds the image of
+// key i, which is the in-memory key_type of the writer's build, then
+// the key blob of key i, then zeros. Schemes whose key_type is not
+// trivially copyable have no image, and image_size is zero.
+//
+// pfss_open_key_store uses the images in place if the store was written
+// by a build with the same key_type layout, and otherwise parses the
+// key blobs, so a store is portable either way.
+//
+
 namespace {
 
-#define COMMON_CODE() \
-  do { \
-    Scheme const scheme(key->domain_bits, key->range_bits); \
-    Scheme::rand_perm_type rand_perm; \
-    inner_eval<Scheme>( \
-        scheme, \
-        scheme.as_key(key->inner_key), \
-        rand_perm, \
-        x, \
-        x_size, \
-        x_is_little_endian, \
-        y, \
-        y_size, \
-        y_is_little_endian); \
-  } while (0)
+constexpr std::size_t key_store_header_size = 64;
+constexpr std::size_t key_store_align = 64;
+constexpr uint32_t key_store_version = 1;
+constexpr char key_store_magic[8] = {'P', 'F', 'S', 'S', 'K', 'E', 'Y', 'S'};
+
+template<class T>
+void key_store_put(uint8_t * const p, T const x) noexcept {
+  for (std::size_t i = 0; i != sizeof(T); ++i) {
+    p[i] = static_cast<uint8_t>(x >> (i * 8));
+  }
+}
+
+template<class T>
+T key_store_get(uint8_t const * const p) noexcept {
+  T x = 0;
+  for (std::size_t i = 0; i != sizeof(T); ++i) {
+    x |= static_cast<T>(static_cast<T>(p[i]) << (i * 8));
+  }
+  return x;
+}
+
+template<class Scheme>
+struct key_image {
+  using key_type = typename Scheme::key_type;
+  using enabled = std::integral_constant<
+      bool,
+      std::is_trivially_copyable<key_type>::value
+          && alignof(key_type) <= key_store_align>;
+  static constexpr std::size_t size = enabled::value ? sizeof(key_type) : 0;
+  static constexpr std::size_t align = enabled::value ? alignof(key_type) : 0;
+};
+
+template<class Scheme>
+constexpr std::size_t key_image<Scheme>::size;
+
+template<class Scheme>
+constexpr std::size_t key_image<Scheme>::align;
+
+//
+// Writes the image of the key in key_blob to image. The key is
+// value-initialized in zeroed storage before it is parsed, so the same
+// blob always gives the same image bytes, padding included.
+//
+
+template<class Scheme>
+void write_key_image(uint8_t const * const key_blob,
+                     uint8_t * const image,
+                     std::true_type) {
+  using key_type = typename Scheme::key_type;
+  typename std::aligned_storage<sizeof(key_type), alignof(key_type)>::type
+      storage;
+  std::memset(&storage, 0, sizeof(storage));
+  key_type * const key = ::new (static_cast<void *>(&storage)) key_type();
+  key->parse(key_blob);
+  std::memcpy(image, key, sizeof(key_type));
+}
+
+template<class Scheme>
+void write_key_image(uint8_t const *, uint8_t *, std::false_type) {
+}
+
+template<class Scheme>
+std::size_t key_store_record_size(Scheme const & scheme) {
+  std::size_t const n = key_image<Scheme>::size + scheme.key_blob_size();
+  return (n + key_store_align - 1) / key_store_align * key_store_align;
+}
 
 #define TEMPLATE_CODE(DomainBits, RangeBits) \
   do { \
     using Scheme = scheme_type<SCHEME_CLASS, DomainBits, RangeBits>; \
-    COMMON_CODE(); \
+    record_size = key_store_record_size(Scheme()); \
   } while (0)
 
 #define STANDARD_CODE() \
   do { \
     using Scheme = scheme_type_v<SCHEME_CLASS_V>; \
-    COMMON_CODE(); \
+    record_size = key_store_record_size(Scheme( \
+        static_cast<int>(domain_bits), \
+        static_cast<int>(range_bits))); \
   } while (0)
 
-pfss_status pfss_eval_nolog(
-    pfss_key const * const key,
-    uint8_t const * const x,
-    uint32_t const x_size,
-    pfss_endianness const x_endianness,
-    uint8_t * const y,
-    uint32_t const y_size,
-    pfss_endianness const y_endianness) {
+pfss_status pfss_key_store_size_nolog(uint32_t const domain_bits,
+                                      uint32_t const range_bits,
+                                      uint32_t const keys_count,
+                                      uint64_t * const store_size) {
   try {
-    validate_pointer(key);
-    validate_pointer(x);
-    validate_size(x_size);
-    bool const x_is_little_endian = validate_endianness(x_endianness);
-    validate_pointer(y);
-    validate_byte_size(y_size, key->range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
-    if (key->header[0] == 0) {
+    validate_domain_bits(domain_bits);
+    validate_range_bits(range_bits);
+    validate_size(keys_count);
+    validate_pointer(store_size);
+    std::size_t record_size;
 #define SCHEME_CLASS pfss::bgi1
 #define SCHEME_CLASS_V pfss::bgi1_v
-      PFSS_SWITCH_DB_RB(
-          key->domain_bits,
-          key->range_bits,
-          TEMPLATE_CODE,
-          STANDARD_CODE);
+    PFSS_SWITCH_DB_RB(domain_bits,
+                      range_bits,
+                      TEMPLATE_CODE,
+                      STANDARD_CODE);
 #undef SCHEME_CLASS_V
 #undef SCHEME_CLASS
-    } else {
-      throw error(PFSS_UNKNOWN_ERROR);
-    }
+    *store_size = static_cast<uint64_t>(key_store_header_size)
+                  + static_cast<uint64_t>(keys_count)
+                        * static_cast<uint64_t>(record_size);
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -1147,26 +2094,18 @@ pfss_status pfss_eval_nolog(
 
 #undef TEMPLATE_CODE
 
-#undef COMMON_CODE
-
-}
+} // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_eval(pfss_key const * const key,
-                      uint8_t const * const x,
-                      uint32_t const x_size,
-                      pfss_endianness const x_endianness,
-                      uint8_t * const y,
-                      uint32_t const y_size,
-                      pfss_endianness const y_endianness) {
+pfss_status pfss_key_store_size(uint32_t const domain_bits,
+                                uint32_t const range_bits,
+                                uint32_t const keys_count,
+                                uint64_t * const store_size) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_eval_nolog(key,
-                                   x,
-                                   x_size,
-                                   x_endianness,
-                                   y,
-                                   y_size,
-                                   y_endianness);
+  auto const ret = pfss_key_store_size_nolog(domain_bits,
+                                             range_bits,
+                                             keys_count,
+                                             store_size);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -1176,37 +2115,89 @@ pfss_status pfss_eval(pfss_key const * const key,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
-                 key,
-                 x,
-                 x_size,
-                 x_endianness,
-                 y,
-                 y_size,
-                 y_endianness);
+                 domain_bits,
+                 range_bits,
+                 keys_count,
+                 store_size);
     }
   }
   return ret;
 }
 
 //----------------------------------------------------------------------
-// pfss_map_eval
+// pfss_write_key_store
 //----------------------------------------------------------------------
 
 namespace {
 
-#define COMMON_CODE() \
-  do { \
-    Scheme const scheme(key->domain_bits, key->range_bits); \
-    Scheme::rand_perm_type rand_perm; \
-    while (xs_count--) { \
-      uint_buf_type const x_buf(xs, x_size, x_is_little_endian); \
-      uint_buf_type y_buf(ys, y_size, y_is_little_endian); \
-      y_buf = scheme.eval( \
-          scheme.as_key(key->inner_key), x_buf, rand_perm); \
-      xs += x_size; \
-      ys += y_size; \
-    } \
-  } while (0)
+template<class Scheme>
+void write_key_store_op(pfss_eval_context & context,
+                        uint8_t const * const key_blobs,
+                        uint32_t const keys_count,
+                        uint32_t const key_blob_size,
+                        uint8_t * const store,
+                        uint64_t const store_size,
+                        uint32_t const thread_count) {
+  Scheme const scheme(static_cast<int>(key_blobs[1]),
+                      static_cast<int>(key_blobs[2]));
+  if (key_blob_size != scheme.key_blob_size()) {
+    throw error(PFSS_MALFORMED_KEY);
+  }
+  std::size_t const image_size = key_image<Scheme>::size;
+  std::size_t const record_size = key_store_record_size(scheme);
+  if (store_size
+      < static_cast<uint64_t>(key_store_header_size)
+            + static_cast<uint64_t>(keys_count)
+                  * static_cast<uint64_t>(record_size)) {
+    throw error(PFSS_INVALID_ARGUMENT);
+  }
+  std::memset(store, 0, key_store_header_size);
+  std::memcpy(store, key_store_magic, sizeof(key_store_magic));
+  key_store_put(store + 8, key_store_version);
+  key_store_put(store + 12, static_cast<uint32_t>(key_store_header_size));
+  key_store_put(store + 16, static_cast<uint64_t>(keys_count));
+  key_store_put(store + 24, key_blob_size);
+  key_store_put(store + 28, static_cast<uint32_t>(record_size));
+  key_store_put(store + 32, static_cast<uint32_t>(image_size));
+  key_store_put(store + 36,
+                static_cast<uint32_t>(key_image<Scheme>::align));
+  store[40] = key_blobs[0];
+  store[41] = key_blobs[1];
+  store[42] = key_blobs[2];
+  store[43] = system_is_little_endian() ? 1 : 0;
+  std::size_t const n = keys_count;
+  std::size_t const max_threads = n / parse_keys_min_task + 1;
+  std::size_t const num_threads =
+      pfss::unsigned_lt(thread_count, max_threads) ?
+          static_cast<std::size_t>(thread_count) :
+          max_threads;
+  std::size_t const tasks =
+      num_threads == 1 ?
+          1 :
+          pfss::min(n, num_threads << parse_keys_slack_bits);
+  auto const first = [=](std::size_t const t) -> std::size_t {
+    return t * (n / tasks) + pfss::min(t, n % tasks);
+  };
+  context.run(
+      num_threads,
+      tasks,
+      [&](std::size_t const t, eval_scratch &) {
+        for (std::size_t i = first(t); i != first(t + 1); ++i) {
+          uint8_t const * const key_blob = key_blobs + i * key_blob_size;
+          if (key_blob[0] != key_blobs[0] || key_blob[1] != key_blobs[1]
+              || key_blob[2] != key_blobs[2]) {
+            throw error(PFSS_INVALID_ARGUMENT);
+          }
+          uint8_t * const record =
+              store + key_store_header_size + i * record_size;
+          std::memset(record, 0, record_size);
+          write_key_image<Scheme>(key_blob,
+                                  record,
+                                  typename key_image<Scheme>::enabled());
+          std::memcpy(record + image_size, key_blob, key_blob_size);
+        }
+      });
+}
 
 #define TEMPLATE_CODE(DomainBits, RangeBits) \
   do { \
@@ -1220,30 +2211,44 @@ namespace {
     COMMON_CODE(); \
   } while (0)
 
-pfss_status pfss_map_eval_nolog(
-    pfss_key const * const key,
-    uint8_t const * xs,
-    uint32_t xs_count,
-    uint32_t const x_size,
-    pfss_endianness const x_endianness,
-    uint8_t * ys,
-    uint32_t const y_size,
-    pfss_endianness const y_endianness) {
-  try {
-    validate_pointer(key);
-    validate_pointer(xs);
-    validate_size(xs_count);
-    validate_size(x_size);
-    bool const x_is_little_endian = validate_endianness(x_endianness);
-    validate_pointer(ys);
-    validate_byte_size(y_size, key->range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
-    if (key->header[0] == 0) {
+#define COMMON_CODE() \
+  do { \
+    write_key_store_op<Scheme>(context, \
+                               key_blobs, \
+                               keys_count, \
+                               key_blob_size, \
+                               store, \
+                               store_size, \
+                               thread_count); \
+  } while (0)
+
+pfss_status pfss_write_key_store_nolog(uint8_t const * const key_blobs,
+                                       uint32_t const keys_count,
+                                       uint32_t const key_blob_size,
+                                       uint8_t * const store,
+                                       uint64_t const store_size,
+                                       uint32_t const thread_count) {
+  try {
+    validate_pointer(key_blobs);
+    validate_size(keys_count);
+    validate_size(key_blob_size);
+    validate_pointer(store);
+    validate_size(thread_count);
+    if (!pfss::unsigned_le(store_size,
+                           pfss::type_max<std::size_t>::value)) {
+      throw error(PFSS_INVALID_ARGUMENT);
+    }
+    if (key_blobs[0] == 0) {
+      if (key_blob_size < 3) {
+        throw error(PFSS_MALFORMED_KEY);
+      }
+      pfss_eval_context context;
+      std::lock_guard<std::mutex> const lock(context.mutex);
 #define SCHEME_CLASS pfss::bgi1
 #define SCHEME_CLASS_V pfss::bgi1_v
       PFSS_SWITCH_DB_RB(
-          key->domain_bits,
-          key->range_bits,
+          static_cast<int>(key_blobs[1]),
+          static_cast<int>(key_blobs[2]),
           TEMPLATE_CODE,
           STANDARD_CODE);
 #undef SCHEME_CLASS_V
@@ -1259,32 +2264,28 @@ pfss_status pfss_map_eval_nolog(
   return PFSS_OK;
 }
 
+#undef COMMON_CODE
+
 #undef STANDARD_CODE
 
 #undef TEMPLATE_CODE
 
-#undef COMMON_CODE
-
-}
+} // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_map_eval(pfss_key const * const key,
-                          uint8_t const * xs,
-                          uint32_t xs_count,
-                          uint32_t const x_size,
-                          pfss_endianness const x_endianness,
-                          uint8_t * ys,
-                          uint32_t const y_size,
-                          pfss_endianness const y_endianness) {
+pfss_status pfss_write_key_store(uint8_t const * const key_blobs,
+                                 uint32_t const keys_count,
+                                 uint32_t const key_blob_size,
+                                 uint8_t * const store,
+                                 uint64_t const store_size,
+                                 uint32_t const thread_count) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_map_eval_nolog(key,
-                                       xs,
-                                       xs_count,
-                                       x_size,
-                                       x_endianness,
-                                       ys,
-                                       y_size,
-                                       y_endianness);
+  auto const ret = pfss_write_key_store_nolog(key_blobs,
+                                              keys_count,
+                                              key_blob_size,
+                                              store,
+                                              store_size,
+                                              thread_count);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -1294,189 +2295,103 @@ pfss_status pfss_map_eval(pfss_key const * const key,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
-                 key,
-                 xs,
-                 xs_count,
-                 x_size,
-                 x_endianness,
-                 ys,
-                 y_size,
-                 y_endianness);
+                 key_blobs,
+                 keys_count,
+                 key_blob_size,
+                 store,
+                 store_size,
+                 thread_count);
     }
   }
   return ret;
 }
 
 //----------------------------------------------------------------------
-// pfss_reduce_sum
+// pfss_open_key_store
 //----------------------------------------------------------------------
 
-// TODO: We should be able to use uint_buf here somehow.
-
 namespace {
 
-template<class Y, bool Aligned, bool Reverse>
-Y reduce_sum(
-    uint32_t const range_bits,
-    uint8_t const * ys,
-    uint32_t ys_count) noexcept {
-  PFSS_SST_STATIC_ASSERT(
-      (std::is_same<Y, std::uint8_t>::value ||
-       std::is_same<Y, std::uint16_t>::value ||
-       std::is_same<Y, std::uint32_t>::value ||
-       std::is_same<Y, std::uint64_t>::value));
-  assert(range_bits > 0);
-  assert(bits_to_bytes(range_bits) <= sizeof(Y));
-  assert(ys != nullptr);
-  assert(ys_count > 0);
-  typename promote_unsigned<Y>::type sum = 0;
-  while (ys_count--) {
-    Y y;
-    if (Aligned) {
-      auto const p = reinterpret_cast<Y const *>(ys);
-      if (Reverse) {
-        y = reverse_bytes(*p);
-      } else {
-        y = *p;
-      }
-    } else {
-      auto const q = reinterpret_cast<uint8_t *>(&y);
-      if (Reverse) {
-        std::reverse_copy(ys, ys + sizeof(Y), q);
-      } else {
-        std::copy(ys, ys + sizeof(Y), q);
-      }
-    }
-    sum += y;
-    ys += sizeof(Y);
-  }
-  return static_cast<Y>(
-      sum & get_mask<Y>(static_cast<int>(range_bits)));
-}
+//
+// Returns true if the images of a store can be used in place by this
+// build: they must have the size, alignment, and byte order of this
+// build's key_type, store must be aligned for it, and the image of
+// record 0 must be the image that this build writes for the blob of
+// record 0. The last check catches key_type layouts that differ in ways
+// the header cannot describe, such as a different block_type.
+//
 
-pfss_status pfss_reduce_sum_nolog(
-    uint32_t const range_bits,
-    uint8_t const * const ys,
-    uint32_t const ys_count,
-    uint32_t const y_size,
-    pfss_endianness const y_endianness,
-    uint8_t * const z,
-    uint32_t const z_size,
-    pfss_endianness const z_endianness) {
-  try {
-    validate_range_bits(range_bits);
-    validate_pointer(ys);
-    validate_size(ys_count);
-    validate_byte_size(y_size, range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
-    validate_pointer(z);
-    validate_byte_size(z_size, range_bits);
-    bool const z_is_little_endian = validate_endianness(z_endianness);
-    uint_buf_type z_buf(z, z_size, z_is_little_endian);
-    switch (y_size) {
-      case 1: {
-        z_buf = reduce_sum<std::uint8_t, true, false>(
-            range_bits, ys, ys_count);
-      } break;
-#define C(Y) \
-  case sizeof(Y): { \
-    bool const aligned = is_aligned<Y>(ys); \
-    bool const reverse = \
-        y_is_little_endian != system_is_little_endian(); \
-    if (aligned) { \
-      if (reverse) { \
-        z_buf = reduce_sum<Y, true, true>(range_bits, ys, ys_count); \
-      } else { \
-        z_buf = reduce_sum<Y, true, false>(range_bits, ys, ys_count); \
-      } \
-    } else { \
-      if (reverse) { \
-        z_buf = reduce_sum<Y, false, true>(range_bits, ys, ys_count); \
-      } else { \
-        z_buf = reduce_sum<Y, false, false>(range_bits, ys, ys_count); \
-      } \
-    } \
-  } break
-        C(std::uint16_t);
-        C(std::uint32_t);
-        C(std::uint64_t);
-#undef C
-      default: {
-        throw error(PFSS_UNKNOWN_ERROR);
-      } break;
-    }
-  } catch (error const & e) {
-    return e.status;
-  } catch (...) {
-    return PFSS_UNKNOWN_ERROR;
+template<class Scheme>
+bool key_store_images_fit(uint8_t const * const store,
+                          std::true_type) {
+  using key_type = typename Scheme::key_type;
+  if (key_store_get<uint32_t>(store + 32) != sizeof(key_type)
+      || key_store_get<uint32_t>(store + 36) != alignof(key_type)
+      || store[43] != (system_is_little_endian() ? 1 : 0)
+      || reinterpret_cast<std::uintptr_t>(store) % alignof(key_type)
+             != 0) {
+    return false;
   }
-  return PFSS_OK;
+  uint8_t const * const record = store + key_store_header_size;
+  std::vector<uint8_t> image(sizeof(key_type));
+  write_key_image<Scheme>(record + sizeof(key_type),
+                          image.data(),
+                          std::true_type());
+  return std::memcmp(image.data(), record, sizeof(key_type)) == 0;
 }
 
-} // namespace
+template<class Scheme>
+bool key_store_images_fit(uint8_t const *, std::false_type) {
+  return false;
+}
 
-PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_reduce_sum(uint32_t const range_bits,
-                            uint8_t const * const ys,
-                            uint32_t const ys_count,
-                            uint32_t const y_size,
-                            pfss_endianness const y_endianness,
-                            uint8_t * const z,
-                            uint32_t const z_size,
-                            pfss_endianness const z_endianness) {
-  pre_call_info_t pre_call_info;
-  auto const ret = pfss_reduce_sum_nolog(range_bits,
-                                         ys,
-                                         ys_count,
-                                         y_size,
-                                         y_endianness,
-                                         z,
-                                         z_size,
-                                         z_endianness);
-  post_call_info_t post_call_info;
-  if (PFSS_WITH_LOGGING) {
-    FILE * const log_file = g_log_file.load();
-    if (log_file != nullptr) {
-      print_call(log_file,
-                 pre_call_info,
-                 post_call_info,
-                 __func__,
-                 boxed_status(ret),
-                 range_bits,
-                 ys,
-                 ys_count,
-                 y_size,
-                 y_endianness,
-                 z,
-                 z_size,
-                 z_endianness);
-    }
+template<class Scheme>
+void open_key_store_op(pfss_eval_context & context,
+                       pfss_key_set & key_set,
+                       uint8_t const * const store,
+                       uint32_t const keys_count,
+                       uint32_t const key_blob_size,
+                       std::size_t const record_size,
+                       std::size_t const image_size,
+                       uint32_t const thread_count) {
+  int const domain_bits = static_cast<int>(store[41]);
+  int const range_bits = static_cast<int>(store[42]);
+  Scheme const scheme(domain_bits, range_bits);
+  if (key_blob_size != scheme.key_blob_size()) {
+    throw error(PFSS_MALFORMED_KEY);
+  }
+  uint8_t const * const records = store + key_store_header_size;
+  if (!std::equal(store + 40, store + 43, records + image_size)) {
+    throw error(PFSS_MALFORMED_KEY);
+  }
+  if (!key_store_images_fit<Scheme>(
+          store,
+          typename key_image<Scheme>::enabled())) {
+    parse_keys_op<Scheme>(context,
+                          key_set,
+                          records + image_size,
+                          keys_count,
+                          key_blob_size,
+                          record_size,
+                          thread_count);
+    return;
+  }
+  std::size_t const n = keys_count;
+  key_set.keys.resize(n);
+  key_set.key_ptrs.resize(n);
+  key_ops const * const ops = get_key_ops<Scheme>();
+  for (std::size_t i = 0; i != n; ++i) {
+    pfss_key & key = key_set.keys[i];
+    key.header[0] = store[40];
+    key.domain_bits = domain_bits;
+    key.range_bits = range_bits;
+    key.inner_key =
+        const_cast<uint8_t *>(records + i * record_size);
+    key.ops = ops;
+    key_set.key_ptrs[i] = &key;
   }
-  return ret;
 }
 
-//----------------------------------------------------------------------
-// pfss_map_eval_reduce_sum
-//----------------------------------------------------------------------
-
-namespace {
-
-#define COMMON_CODE() \
-  do { \
-    Scheme const scheme(key->domain_bits, key->range_bits); \
-    auto const & k = scheme.as_key(key->inner_key); \
-    Scheme::rand_perm_type rand_perm; \
-    typename promote_unsigned<typename Scheme::range_type>::type sum = \
-        0; \
-    uint_buf_type y_buf(y, y_size, y_is_little_endian); \
-    while (xs_count--) { \
-      uint_buf_type const x_buf(xs, x_size, x_is_little_endian); \
-      sum += scheme.eval(k, x_buf, rand_perm); \
-      xs += x_size; \
-    } \
-    y_buf = sum & get_mask<decltype(sum)>(scheme.range_bits); \
-  } while (0)
-
 #define TEMPLATE_CODE(DomainBits, RangeBits) \
   do { \
     using Scheme = scheme_type<SCHEME_CLASS, DomainBits, RangeBits>; \
@@ -1489,30 +2404,59 @@ namespace {
     COMMON_CODE(); \
   } while (0)
 
-pfss_status pfss_map_eval_reduce_sum_nolog(
-    pfss_key const * const key,
-    uint8_t const * xs,
-    uint32_t xs_count,
-    uint32_t const x_size,
-    pfss_endianness const x_endianness,
-    uint8_t * const y,
-    uint32_t const y_size,
-    pfss_endianness const y_endianness) {
+#define COMMON_CODE() \
+  do { \
+    open_key_store_op<Scheme>(context, \
+                              *key_set, \
+                              store, \
+                              static_cast<uint32_t>(keys_count), \
+                              key_blob_size, \
+                              record_size, \
+                              image_size, \
+                              thread_count); \
+  } while (0)
+
+pfss_status pfss_open_key_store_nolog(pfss_key_set ** const p_key_set,
+                                      uint8_t const * const store,
+                                      uint64_t const store_size,
+                                      uint32_t const thread_count) {
   try {
-    validate_pointer(key);
-    validate_pointer(xs);
-    validate_size(xs_count);
-    validate_size(x_size);
-    bool const x_is_little_endian = validate_endianness(x_endianness);
-    validate_pointer(y);
-    validate_byte_size(y_size, key->range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
-    if (key->header[0] == 0) {
+    validate_pointer(p_key_set);
+    validate_pointer(store);
+    validate_size(thread_count);
+    if (store_size < key_store_header_size
+        || std::memcmp(store, key_store_magic, sizeof(key_store_magic))
+               != 0
+        || key_store_get<uint32_t>(store + 8) != key_store_version
+        || key_store_get<uint32_t>(store + 12) != key_store_header_size) {
+      throw error(PFSS_MALFORMED_KEY);
+    }
+    uint64_t const keys_count = key_store_get<uint64_t>(store + 16);
+    uint32_t const key_blob_size = key_store_get<uint32_t>(store + 24);
+    uint32_t const record_size = key_store_get<uint32_t>(store + 28);
+    uint32_t const image_size = key_store_get<uint32_t>(store + 32);
+    if (keys_count < 1 || keys_count > pfss::type_max<uint32_t>::value
+        || key_blob_size < 3 || record_size % key_store_align != 0
+        || static_cast<uint64_t>(image_size) + key_blob_size
+               > record_size
+        || (store_size - key_store_header_size) / record_size
+               < keys_count
+        || !pfss::unsigned_le(store_size,
+                              pfss::type_max<std::size_t>::value)) {
+      throw error(PFSS_MALFORMED_KEY);
+    }
+    std::unique_ptr<pfss_key_set> key_set(new pfss_key_set);
+    if (store[40] == 0) {
+      if (store[41] == 0 || store[42] == 0) {
+        throw error(PFSS_MALFORMED_KEY);
+      }
+      pfss_eval_context context;
+      std::lock_guard<std::mutex> const lock(context.mutex);
 #define SCHEME_CLASS pfss::bgi1
 #define SCHEME_CLASS_V pfss::bgi1_v
       PFSS_SWITCH_DB_RB(
-          key->domain_bits,
-          key->range_bits,
+          static_cast<int>(store[41]),
+          static_cast<int>(store[42]),
           TEMPLATE_CODE,
           STANDARD_CODE);
 #undef SCHEME_CLASS_V
@@ -1520,6 +2464,7 @@ pfss_status pfss_map_eval_reduce_sum_nolog(
     } else {
       throw error(PFSS_UNKNOWN_ERROR);
     }
+    *p_key_set = key_set.release();
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -1528,33 +2473,73 @@ pfss_status pfss_map_eval_reduce_sum_nolog(
   return PFSS_OK;
 }
 
+#undef COMMON_CODE
+
 #undef STANDARD_CODE
 
 #undef TEMPLATE_CODE
 
-#undef COMMON_CODE
-
-}
+} // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status
-pfss_map_eval_reduce_sum(pfss_key const * const key,
-                         uint8_t const * xs,
-                         uint32_t xs_count,
-                         uint32_t const x_size,
-                         pfss_endianness const x_endianness,
-                         uint8_t * const y,
-                         uint32_t const y_size,
-                         pfss_endianness const y_endianness) {
+pfss_status pfss_open_key_store(pfss_key_set ** const p_key_set,
+                                uint8_t const * const store,
+                                uint64_t const store_size,
+                                uint32_t const thread_count) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_map_eval_reduce_sum_nolog(key,
-                                                  xs,
-                                                  xs_count,
-                                                  x_size,
-                                                  x_endianness,
-                                                  y,
-                                                  y_size,
-                                                  y_endianness);
+  auto const ret = pfss_open_key_store_nolog(p_key_set,
+                                             store,
+                                             store_size,
+                                             thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 p_key_set,
+                 store,
+                 store_size,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_get_domain_bits
+//----------------------------------------------------------------------
+
+namespace {
+
+pfss_status pfss_get_domain_bits_nolog(pfss_key const * const key,
+                                       uint32_t * const domain_bits) {
+  try {
+    validate_pointer(key);
+    validate_pointer(domain_bits);
+    if (key->header[0] == 0) {
+      *domain_bits = static_cast<uint32_t>(key->domain_bits);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_get_domain_bits(pfss_key const * const key,
+                                 uint32_t * const domain_bits) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_get_domain_bits_nolog(key, domain_bits);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -1565,8 +2550,150 @@ pfss_map_eval_reduce_sum(pfss_key const * const key,
                  __func__,
                  boxed_status(ret),
                  key,
-                 xs,
-                 xs_count,
+                 domain_bits);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_get_range_bits
+//----------------------------------------------------------------------
+
+namespace {
+
+pfss_status pfss_get_range_bits_nolog(pfss_key const * const key,
+                                      uint32_t * const range_bits) {
+  try {
+    validate_pointer(key);
+    validate_pointer(range_bits);
+    if (key->header[0] == 0) {
+      *range_bits = static_cast<uint32_t>(key->range_bits);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_get_range_bits(pfss_key const * const key,
+                                uint32_t * const range_bits) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_get_range_bits_nolog(key, range_bits);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 range_bits);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_eval
+//----------------------------------------------------------------------
+
+namespace {
+
+template<class Scheme>
+void eval_op(pfss_key const * const key,
+             uint8_t const * const x,
+             uint32_t const x_size,
+             bool const x_is_little_endian,
+             uint8_t * const y,
+             uint32_t const y_size,
+             bool const y_is_little_endian) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  typename Scheme::rand_perm_type rand_perm;
+  inner_eval<Scheme>(scheme,
+                     scheme.as_key(key->inner_key),
+                     rand_perm,
+                     x,
+                     x_size,
+                     x_is_little_endian,
+                     y,
+                     y_size,
+                     y_is_little_endian);
+}
+
+pfss_status pfss_eval_nolog(
+    pfss_key const * const key,
+    uint8_t const * const x,
+    uint32_t const x_size,
+    pfss_endianness const x_endianness,
+    uint8_t * const y,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness) {
+  try {
+    validate_pointer(key);
+    validate_pointer(x);
+    validate_size(x_size);
+    bool const x_is_little_endian = validate_endianness(x_endianness);
+    validate_pointer(y);
+    validate_byte_size(y_size, key->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    if (key->header[0] == 0) {
+      key->ops->eval(key,
+                     x,
+                     x_size,
+                     x_is_little_endian,
+                     y,
+                     y_size,
+                     y_is_little_endian);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval(pfss_key const * const key,
+                      uint8_t const * const x,
+                      uint32_t const x_size,
+                      pfss_endianness const x_endianness,
+                      uint8_t * const y,
+                      uint32_t const y_size,
+                      pfss_endianness const y_endianness) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_nolog(key,
+                                   x,
+                                   x_size,
+                                   x_endianness,
+                                   y,
+                                   y_size,
+                                   y_endianness);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 x,
                  x_size,
                  x_endianness,
                  y,
@@ -1578,139 +2705,2503 @@ pfss_map_eval_reduce_sum(pfss_key const * const key,
 }
 
 //----------------------------------------------------------------------
-// pfss_eval_all
+// pfss_map_eval
 //----------------------------------------------------------------------
 
 namespace {
 
-#define PFSS_EVAL_ALL_COMMON_CODE() \
-  do { \
-    Scheme const scheme(key->domain_bits, key->range_bits); \
-    auto const & k = scheme.as_key(key->inner_key); \
-    Scheme::rand_perm_type rand_perm; \
-    auto cache = scheme.make_pack_eval_cache(); \
-    int b = 0; \
-    while (true) { \
-      if (false && (x & to_unsigned(scheme.pack_mask)) == 0 \
-          && x_last - x >= 3 \
-          && unsigned_ge((x_last - x - 3) / 4, scheme.pack_mask)) { \
-        /* \
-        auto const x0 = x; \
-        auto const x1 = x0 + to_unsigned(scheme.pack_count); \
-        auto const x2 = x1 + to_unsigned(scheme.pack_count); \
-        auto const x3 = x2 + to_unsigned(scheme.pack_count); \
-        uint_buf_type const & x0_buf = x_buf; \
-        uint_buf_type const x1_buf(&x1, \
-                                   sizeof(x1), \
-                                   system_is_little_endian()); \
-        uint_buf_type const x2_buf(&x2, \
-                                   sizeof(x2), \
-                                   system_is_little_endian()); \
-        uint_buf_type const x3_buf(&x3, \
-                                   sizeof(x3), \
-                                   system_is_little_endian()); \
-        out = scheme.pack_eval_x4(k, \
-                                  x0_buf, \
-                                  x1_buf, \
-                                  x2_buf, \
-                                  x3_buf, \
-                                  rand_perm, \
-                                  out); \
-        x = x3 | to_unsigned(scheme.pack_mask); \
-        if (x == x_last) { \
-          break; \
-        } \
-        ++x; \
-        */ \
-      } else if ((x & to_unsigned(scheme.pack_mask)) == 0 \
-                 && unsigned_ge(x_last - x, scheme.pack_mask)) { \
-        out = scheme.pack_eval(k, x_buf, rand_perm, cache, b, out); \
-        auto const x_prev = x; \
-        x |= pfss::to_unsigned(scheme.pack_mask); \
-        if (x == x_last) { \
-          break; \
-        } \
-        ++x; \
-        b = scheme.v - 1 \
-            - pfss::bit_scan_reverse((x_prev ^ x) \
-                                     >> scheme.n_minus_v); \
-      } else { \
-        *out++ = scheme.eval(k, x_buf, rand_perm); \
-        if (x == x_last) { \
-          break; \
-        } \
-        ++x; \
-        b = 0; \
-      } \
-    } \
-  } while (0)
+// The number of domain elements that pfss_map_eval and
+// pfss_map_eval_reduce_sum walk down the tree in lockstep. Eight
+// independent blocks are enough to hide the AES round latency on
+// current x86 and ARM cores.
+constexpr int map_eval_lanes = 8;
 
-#define PFSS_EVAL_ALL_TEMPLATE_CODE(DomainBits, RangeBits) \
-  do { \
-    using Scheme = scheme_type<SCHEME_CLASS, DomainBits, RangeBits>; \
-    PFSS_EVAL_ALL_COMMON_CODE(); \
-  } while (0)
+// pfss_map_eval{,_reduce_sum} give each thread at least this many
+// domain elements, as waking a thread for fewer costs more than it
+// saves.
+constexpr std::size_t map_eval_min_task = 1024;
+
+// pfss_map_eval{,_reduce_sum} split the domain elements into about
+// 2^map_eval_slack_bits tasks per thread so that a slow thread holds
+// up the others less.
+constexpr int map_eval_slack_bits = 2;
+
+//
+// Splits xs_count domain elements into tasks of whole lane groups.
+// Task t covers elements [first(t), first(t + 1)).
+//
+
+struct map_eval_plan {
+  std::size_t count;
+  std::size_t num_threads;
+  std::size_t tasks;
+
+  std::size_t first(std::size_t const t) const noexcept {
+    std::size_t const lanes = map_eval_lanes;
+    std::size_t const units = count / lanes + (count % lanes != 0);
+    std::size_t const q = units / tasks;
+    std::size_t const r = units % tasks;
+    std::size_t const i = (t * q + pfss::min(t, r)) * lanes;
+    return pfss::min(i, count);
+  }
+};
+
+template<class T1, class T2>
+map_eval_plan get_map_eval_plan(T1 const xs_count,
+                                T2 const thread_count) {
+  if (!pfss::unsigned_le(xs_count,
+                         pfss::type_max<std::size_t>::value)) {
+    throw error(PFSS_INVALID_ARGUMENT);
+  }
+  map_eval_plan plan;
+  plan.count = static_cast<std::size_t>(xs_count);
+  std::size_t const lanes = map_eval_lanes;
+  std::size_t const units = plan.count / lanes + 1;
+  std::size_t const max_threads =
+      plan.count / map_eval_min_task + 1;
+  plan.num_threads =
+      pfss::unsigned_lt(thread_count, max_threads) ?
+          static_cast<std::size_t>(thread_count) :
+          max_threads;
+  plan.tasks = plan.num_threads == 1 ?
+                   1 :
+                   pfss::min(units,
+                             plan.num_threads << map_eval_slack_bits);
+  return plan;
+}
+
+template<class Scheme>
+void map_eval_range(Scheme const & scheme,
+                    typename Scheme::key_type const & k,
+                    uint8_t const * xs,
+                    std::size_t xs_count,
+                    uint32_t const x_size,
+                    bool const x_is_little_endian,
+                    uint8_t * const ys,
+                    uint32_t const y_size,
+                    bool const y_is_little_endian,
+                    typename Scheme::rand_perm_type & rand_perm) {
+  using domain_type = typename Scheme::domain_type;
+  uint_buf_iterator<uint32_t> out(ys, y_size, y_is_little_endian);
+  domain_batch<domain_type> lane_xs;
+  for (; xs_count >= map_eval_lanes; xs_count -= map_eval_lanes) {
+    out = scheme.template eval_xn<map_eval_lanes>(
+        k,
+        lane_xs.load(xs, map_eval_lanes, x_size, x_is_little_endian),
+        rand_perm,
+        out);
+    xs += map_eval_lanes * x_size;
+  }
+  while (xs_count--) {
+    uint_buf_type const x_buf(xs, x_size, x_is_little_endian);
+    *out++ = scheme.eval(k, to_domain<domain_type>(x_buf), rand_perm);
+    xs += x_size;
+  }
+}
+
+template<class Scheme>
+void map_eval_op(pfss_eval_context * const context,
+                 pfss_key const * const key,
+                 uint8_t const * const xs,
+                 uint32_t const x_size,
+                 bool const x_is_little_endian,
+                 uint8_t * const ys,
+                 uint32_t const y_size,
+                 bool const y_is_little_endian,
+                 map_eval_plan const & plan) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  auto const & k = scheme.as_key(key->inner_key);
+  context->run(
+      plan.num_threads,
+      plan.tasks,
+      [&](std::size_t const t, eval_scratch & scratch) {
+        std::size_t const first = plan.first(t);
+        map_eval_range(scheme,
+                       k,
+                       xs + first * x_size,
+                       plan.first(t + 1) - first,
+                       x_size,
+                       x_is_little_endian,
+                       ys + first * y_size,
+                       y_size,
+                       y_is_little_endian,
+                       scratch.rand_perm);
+      });
+}
+
+pfss_status pfss_map_eval_nolog(
+    pfss_eval_context * const context,
+    pfss_key const * const key,
+    uint8_t const * const xs,
+    uint64_t const xs_count,
+    uint32_t const x_size,
+    pfss_endianness const x_endianness,
+    uint8_t * const ys,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    uint32_t const thread_count) {
+  try {
+    validate_pointer(context);
+    validate_pointer(key);
+    validate_pointer(xs);
+    validate_size(xs_count);
+    validate_size(x_size);
+    bool const x_is_little_endian = validate_endianness(x_endianness);
+    validate_pointer(ys);
+    validate_byte_size(y_size, key->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    validate_size(thread_count);
+    map_eval_plan const plan =
+        get_map_eval_plan(xs_count, thread_count);
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    if (key->header[0] == 0) {
+      key->ops->map_eval(context,
+                         key,
+                         xs,
+                         x_size,
+                         x_is_little_endian,
+                         ys,
+                         y_size,
+                         y_is_little_endian,
+                         plan);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval(pfss_key const * const key,
+                          uint8_t const * const xs,
+                          uint32_t const xs_count,
+                          uint32_t const x_size,
+                          pfss_endianness const x_endianness,
+                          uint8_t * const ys,
+                          uint32_t const y_size,
+                          pfss_endianness const y_endianness) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_eval_nolog(&context,
+                                       key,
+                                       xs,
+                                       xs_count,
+                                       x_size,
+                                       x_endianness,
+                                       ys,
+                                       y_size,
+                                       y_endianness,
+                                       1);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_mt(pfss_key const * const key,
+                             uint8_t const * const xs,
+                             uint64_t const xs_count,
+                             uint32_t const x_size,
+                             pfss_endianness const x_endianness,
+                             uint8_t * const ys,
+                             uint32_t const y_size,
+                             pfss_endianness const y_endianness,
+                             uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_eval_nolog(&context,
+                                       key,
+                                       xs,
+                                       xs_count,
+                                       x_size,
+                                       x_endianness,
+                                       ys,
+                                       y_size,
+                                       y_endianness,
+                                       thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_ctx(pfss_eval_context * const context,
+                              pfss_key const * const key,
+                              uint8_t const * const xs,
+                              uint64_t const xs_count,
+                              uint32_t const x_size,
+                              pfss_endianness const x_endianness,
+                              uint8_t * const ys,
+                              uint32_t const y_size,
+                              pfss_endianness const y_endianness,
+                              uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_map_eval_nolog(context,
+                                       key,
+                                       xs,
+                                       xs_count,
+                                       x_size,
+                                       x_endianness,
+                                       ys,
+                                       y_size,
+                                       y_endianness,
+                                       thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_map_eval_sorted
+//----------------------------------------------------------------------
+
+namespace {
+
+// Returns the top min(domain_bits, 64) bits of x, which is enough to
+// put domain elements that share long prefixes next to each other.
+std::uint64_t get_sort_key(uint_buf_type const & x,
+                           int const domain_bits) noexcept {
+  if (domain_bits <= 64) {
+    return x.get_as<std::uint64_t>();
+  }
+  std::uint64_t k = 0;
+  for (int i = 0; i != 64; ++i) {
+    k <<= 1;
+    k |= static_cast<std::uint64_t>(getbitx(x, domain_bits - 1 - i));
+  }
+  return k;
+}
+
+// pfss_map_eval_sorted hands the points of a task to eval_sorted in
+// chunks of this many, which keeps the two levels of frontier that
+// eval_sorted works in around the size of the L2 cache. Only the first
+// point of each chunk walks down from the root.
+constexpr std::size_t map_eval_sorted_chunk = 4096;
+
+//
+// Lets eval_sorted index into the domain or range elements of a batch
+// in sorted order, starting at sorted position first. Sorted position
+// i is element order[i].second, or element i if order is null.
+//
+
+class sorted_uint_bufs {
+  uint8_t const * const bufs_;
+  uint32_t const buf_size_;
+  bool const is_little_endian_;
+  std::pair<std::uint64_t, std::size_t> const * const order_;
+  std::size_t const first_;
+
+public:
+  explicit sorted_uint_bufs(
+      uint8_t const * const bufs,
+      uint32_t const buf_size,
+      bool const is_little_endian,
+      std::pair<std::uint64_t, std::size_t> const * const order,
+      std::size_t const first) noexcept
+      : bufs_(bufs),
+        buf_size_(buf_size),
+        is_little_endian_(is_little_endian),
+        order_(order),
+        first_(first) {
+  }
+
+  uint_buf_type operator[](std::size_t const j) const noexcept {
+    std::size_t const i =
+        order_ == nullptr ? first_ + j : order_[first_ + j].second;
+    return uint_buf_type(
+        bufs_ + i * buf_size_, buf_size_, is_little_endian_);
+  }
+};
+
+//
+// Evaluates the domain elements at positions [first, last) of the
+// sorted order, where position j is element order[j].second, or
+// element j if order is empty.
+//
+
+template<class Scheme>
+void map_eval_sorted_range(
+    Scheme const & scheme,
+    typename Scheme::key_type const & k,
+    std::vector<std::pair<std::uint64_t, std::size_t>> const & order,
+    std::size_t const first,
+    std::size_t const last,
+    uint8_t const * const xs,
+    uint32_t const x_size,
+    bool const x_is_little_endian,
+    uint8_t * const ys,
+    uint32_t const y_size,
+    bool const y_is_little_endian,
+    eval_scratch & scratch) {
+  auto const * const p = order.empty() ? nullptr : order.data();
+  domain_batch<typename Scheme::domain_type> chunk_xs;
+  for (std::size_t i = first; i < last; i += map_eval_sorted_chunk) {
+    std::size_t const n = pfss::min(map_eval_sorted_chunk, last - i);
+    sorted_uint_bufs const x_bufs(xs, x_size, x_is_little_endian, p, i);
+    sorted_uint_bufs const y_bufs(ys, y_size, y_is_little_endian, p, i);
+    scheme.eval_sorted(k,
+                       chunk_xs.load(x_bufs, n),
+                       n,
+                       scratch.rand_perm,
+                       scratch.eval_all,
+                       y_bufs);
+  }
+}
+
+template<class Scheme>
+void map_eval_sorted_op(pfss_eval_context * const context,
+                        pfss_key const * const key,
+                        uint8_t const * const xs,
+                        uint32_t const x_size,
+                        bool const x_is_little_endian,
+                        uint8_t * const ys,
+                        uint32_t const y_size,
+                        bool const y_is_little_endian,
+                        int const xs_are_sorted,
+                        map_eval_plan const & plan) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  auto const & k = scheme.as_key(key->inner_key);
+  std::vector<std::pair<std::uint64_t, std::size_t>> order;
+  if (!xs_are_sorted) {
+    order.resize(plan.count);
+    for (std::size_t i = 0; i != plan.count; ++i) {
+      uint_buf_type const x_buf(
+          xs + i * x_size, x_size, x_is_little_endian);
+      order[i].first = get_sort_key(x_buf, scheme.domain_bits);
+      order[i].second = i;
+    }
+    std::sort(order.begin(), order.end());
+  }
+  context->run(
+      plan.num_threads,
+      plan.tasks,
+      [&](std::size_t const t, eval_scratch & scratch) {
+        map_eval_sorted_range(scheme,
+                              k,
+                              order,
+                              plan.first(t),
+                              plan.first(t + 1),
+                              xs,
+                              x_size,
+                              x_is_little_endian,
+                              ys,
+                              y_size,
+                              y_is_little_endian,
+                              scratch);
+      });
+}
+
+pfss_status pfss_map_eval_sorted_nolog(
+    pfss_eval_context * const context,
+    pfss_key const * const key,
+    uint8_t const * const xs,
+    uint64_t const xs_count,
+    uint32_t const x_size,
+    pfss_endianness const x_endianness,
+    uint8_t * const ys,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    int const xs_are_sorted,
+    uint32_t const thread_count) {
+  try {
+    validate_pointer(context);
+    validate_pointer(key);
+    validate_pointer(xs);
+    validate_size(xs_count);
+    validate_size(x_size);
+    bool const x_is_little_endian = validate_endianness(x_endianness);
+    validate_pointer(ys);
+    validate_byte_size(y_size, key->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    validate_size(thread_count);
+    map_eval_plan const plan =
+        get_map_eval_plan(xs_count, thread_count);
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    if (key->header[0] == 0) {
+      key->ops->map_eval_sorted(context,
+                                key,
+                                xs,
+                                x_size,
+                                x_is_little_endian,
+                                ys,
+                                y_size,
+                                y_is_little_endian,
+                                xs_are_sorted,
+                                plan);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_sorted(pfss_key const * const key,
+                     uint8_t const * const xs,
+                     uint64_t const xs_count,
+                     uint32_t const x_size,
+                     pfss_endianness const x_endianness,
+                     uint8_t * const ys,
+                     uint32_t const y_size,
+                     pfss_endianness const y_endianness,
+                     int const xs_are_sorted,
+                     uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_eval_sorted_nolog(&context,
+                                              key,
+                                              xs,
+                                              xs_count,
+                                              x_size,
+                                              x_endianness,
+                                              ys,
+                                              y_size,
+                                              y_endianness,
+                                              xs_are_sorted,
+                                              thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 xs_are_sorted,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_sorted_ctx(pfss_eval_context * const context,
+                         pfss_key const * const key,
+                         uint8_t const * const xs,
+                         uint64_t const xs_count,
+                         uint32_t const x_size,
+                         pfss_endianness const x_endianness,
+                         uint8_t * const ys,
+                         uint32_t const y_size,
+                         pfss_endianness const y_endianness,
+                         int const xs_are_sorted,
+                         uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_map_eval_sorted_nolog(context,
+                                              key,
+                                              xs,
+                                              xs_count,
+                                              x_size,
+                                              x_endianness,
+                                              ys,
+                                              y_size,
+                                              y_endianness,
+                                              xs_are_sorted,
+                                              thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 xs_are_sorted,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_map_eval_keys
+//----------------------------------------------------------------------
+
+namespace {
+
+//
+// Lets eval_keys index into a batch of domain or range elements that
+// are scattered through memory, where element j starts at ptrs[j].
+//
+
+class scattered_uint_bufs {
+  uint8_t const * const * const ptrs_;
+  uint32_t const buf_size_;
+  bool const is_little_endian_;
+
+public:
+  explicit scattered_uint_bufs(uint8_t const * const * const ptrs,
+                               uint32_t const buf_size,
+                               bool const is_little_endian) noexcept
+      : ptrs_(ptrs),
+        buf_size_(buf_size),
+        is_little_endian_(is_little_endian) {
+  }
+
+  uint_buf_type operator[](std::size_t const j) const noexcept {
+    return uint_buf_type(ptrs_[j], buf_size_, is_little_endian_);
+  }
+};
+
+//
+// The work of pfss_map_eval_keys is a grid of tasks: the keys are split
+// into key_blocks blocks of key_block_size keys (the last block may be
+// shorter) and the domain elements are split into chunks. Task t
+// evaluates the keys of block t / chunks at the domain elements of
+// chunk t % chunks. The domain elements are split first, and the keys
+// are only split when there are fewer domain elements than tasks.
+//
+
+struct map_eval_keys_plan {
+  std::size_t keys_count;
+  std::size_t count;
+  std::size_t num_threads;
+  std::size_t key_blocks;
+  std::size_t key_block_size;
+  std::size_t chunks;
+
+  std::size_t tasks() const noexcept {
+    return key_blocks * chunks;
+  }
+
+  // Chunk c covers domain elements [first(c), first(c + 1)).
+  std::size_t first(std::size_t const c) const noexcept {
+    std::size_t const q = count / chunks;
+    std::size_t const r = count % chunks;
+    return c * q + pfss::min(c, r);
+  }
+};
+
+template<class T1, class T2>
+map_eval_keys_plan get_map_eval_keys_plan(uint32_t const keys_count,
+                                          T1 const xs_count,
+                                          uint32_t const y_size,
+                                          T2 const thread_count) {
+  assert(keys_count > 0);
+  assert(xs_count > 0);
+  assert(y_size > 0);
+  assert(thread_count > 0);
+  // Every cell of the matrix must be addressable.
+  std::size_t const max_count =
+      pfss::type_max<std::size_t>::value / keys_count / y_size;
+  if (!pfss::unsigned_le(xs_count, max_count)) {
+    throw error(PFSS_INVALID_ARGUMENT);
+  }
+  map_eval_keys_plan plan;
+  plan.keys_count = keys_count;
+  plan.count = static_cast<std::size_t>(xs_count);
+  std::size_t const max_threads =
+      plan.keys_count * plan.count / map_eval_min_task + 1;
+  plan.num_threads =
+      pfss::unsigned_lt(thread_count, max_threads) ?
+          static_cast<std::size_t>(thread_count) :
+          max_threads;
+  std::size_t const want = plan.num_threads == 1 ?
+                               1 :
+                               plan.num_threads << map_eval_slack_bits;
+  if (plan.count >= want) {
+    plan.chunks = want;
+    plan.key_blocks = 1;
+  } else {
+    plan.chunks = plan.count;
+    plan.key_blocks = pfss::min(plan.keys_count,
+                                (want + plan.count - 1) / plan.count);
+  }
+  plan.key_block_size =
+      (plan.keys_count + plan.key_blocks - 1) / plan.key_blocks;
+  plan.key_blocks = (plan.keys_count + plan.key_block_size - 1)
+                    / plan.key_block_size;
+  plan.num_threads = pfss::min(plan.num_threads, plan.tasks());
+  return plan;
+}
+
+//
+// Evaluates the keys ks[k_first], ..., ks[k_last - 1] at the domain
+// elements i_first, ..., i_last - 1, writing the result for key k and
+// domain element i to ys + k * key_stride + i * x_stride. The pairs
+// are taken one domain element at a time, and eval_keys walks each run
+// of Scheme::eval_keys_batch pairs down the tree together, so the lanes
+// stay full whether there are many keys or only one.
+//
+
+template<class Scheme>
+void map_eval_keys_range(
+    Scheme const & scheme,
+    typename Scheme::key_type const * const * const ks,
+    std::size_t const k_first,
+    std::size_t const k_last,
+    uint8_t const * const xs,
+    std::size_t const i_first,
+    std::size_t const i_last,
+    uint32_t const x_size,
+    bool const x_is_little_endian,
+    uint8_t * const ys,
+    std::size_t const key_stride,
+    std::size_t const x_stride,
+    uint32_t const y_size,
+    bool const y_is_little_endian,
+    typename Scheme::rand_perm_type & rand_perm) {
+  constexpr std::size_t batch = Scheme::eval_keys_batch;
+  typename Scheme::key_type const * lane_keys[batch];
+  uint8_t const * lane_xs[batch];
+  uint8_t const * lane_ys[batch];
+  scattered_uint_bufs const x_bufs(
+      lane_xs, x_size, x_is_little_endian);
+  scattered_uint_bufs y_bufs(lane_ys, y_size, y_is_little_endian);
+  domain_batch<typename Scheme::domain_type> lane_domain_xs;
+  std::size_t n = 0;
+  for (std::size_t i = i_first; i != i_last; ++i) {
+    for (std::size_t k = k_first; k != k_last; ++k) {
+      lane_keys[n] = ks[k];
+      lane_xs[n] = xs + i * x_size;
+      lane_ys[n] = ys + k * key_stride + i * x_stride;
+      if (++n == batch) {
+        scheme.eval_keys(n,
+                         lane_keys,
+                         lane_domain_xs.load(x_bufs, n),
+                         rand_perm,
+                         y_bufs);
+        n = 0;
+      }
+    }
+  }
+  if (n != 0) {
+    scheme.eval_keys(n,
+                     lane_keys,
+                     lane_domain_xs.load(x_bufs, n),
+                     rand_perm,
+                     y_bufs);
+  }
+}
+
+template<class Scheme>
+void map_eval_keys_op(pfss_eval_context * const context,
+                      pfss_key const * const * const keys,
+                      uint32_t const keys_count,
+                      uint8_t const * const xs,
+                      uint32_t const x_size,
+                      bool const x_is_little_endian,
+                      uint8_t * const ys,
+                      std::size_t const key_stride,
+                      std::size_t const x_stride,
+                      uint32_t const y_size,
+                      bool const y_is_little_endian,
+                      map_eval_keys_plan const & plan) {
+  Scheme const scheme(keys[0]->domain_bits, keys[0]->range_bits);
+  std::vector<typename Scheme::key_type const *> ks(keys_count);
+  for (uint32_t k = 0; k != keys_count; ++k) {
+    ks[k] = &scheme.as_key(keys[k]->inner_key);
+  }
+  context->run(
+      plan.num_threads,
+      plan.tasks(),
+      [&](std::size_t const t, eval_scratch & scratch) {
+        std::size_t const b = t / plan.chunks;
+        std::size_t const c = t % plan.chunks;
+        std::size_t const k_first = b * plan.key_block_size;
+        map_eval_keys_range(
+            scheme,
+            ks.data(),
+            k_first,
+            pfss::min(k_first + plan.key_block_size,
+                      plan.keys_count),
+            xs,
+            plan.first(c),
+            plan.first(c + 1),
+            x_size,
+            x_is_little_endian,
+            ys,
+            key_stride,
+            x_stride,
+            y_size,
+            y_is_little_endian,
+            scratch.rand_perm);
+      });
+}
+
+pfss_status pfss_map_eval_keys_nolog(
+    pfss_eval_context * const context,
+    pfss_key const * const * const keys,
+    uint32_t const keys_count,
+    uint8_t const * const xs,
+    uint64_t const xs_count,
+    uint32_t const x_size,
+    pfss_endianness const x_endianness,
+    uint8_t * const ys,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    pfss_layout const ys_layout,
+    uint32_t const thread_count) {
+  try {
+    validate_pointer(context);
+    validate_pointer(keys);
+    validate_size(keys_count);
+    for (uint32_t i = 0; i != keys_count; ++i) {
+      validate_pointer(keys[i]);
+      if (keys[i]->header[0] != keys[0]->header[0]) {
+        throw error(PFSS_INVALID_ARGUMENT);
+      }
+      if (keys[i]->domain_bits != keys[0]->domain_bits) {
+        throw error(PFSS_INVALID_ARGUMENT);
+      }
+      if (keys[i]->range_bits != keys[0]->range_bits) {
+        throw error(PFSS_INVALID_ARGUMENT);
+      }
+    }
+    validate_pointer(xs);
+    validate_size(xs_count);
+    validate_size(x_size);
+    bool const x_is_little_endian = validate_endianness(x_endianness);
+    validate_pointer(ys);
+    validate_byte_size(y_size, keys[0]->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    bool const point_major = validate_layout(ys_layout);
+    validate_size(thread_count);
+    map_eval_keys_plan const plan = get_map_eval_keys_plan(
+        keys_count, xs_count, y_size, thread_count);
+    std::size_t const key_stride =
+        point_major ? y_size : plan.count * y_size;
+    std::size_t const x_stride =
+        point_major ? plan.keys_count * y_size : y_size;
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    if (keys[0]->header[0] == 0) {
+      keys[0]->ops->map_eval_keys(context,
+                                  keys,
+                                  keys_count,
+                                  xs,
+                                  x_size,
+                                  x_is_little_endian,
+                                  ys,
+                                  key_stride,
+                                  x_stride,
+                                  y_size,
+                                  y_is_little_endian,
+                                  plan);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_map_eval_keys(pfss_key const * const * const keys,
+                               uint32_t const keys_count,
+                               uint8_t const * const xs,
+                               uint64_t const xs_count,
+                               uint32_t const x_size,
+                               pfss_endianness const x_endianness,
+                               uint8_t * const ys,
+                               uint32_t const y_size,
+                               pfss_endianness const y_endianness,
+                               pfss_layout const ys_layout,
+                               uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_eval_keys_nolog(&context,
+                                            keys,
+                                            keys_count,
+                                            xs,
+                                            xs_count,
+                                            x_size,
+                                            x_endianness,
+                                            ys,
+                                            y_size,
+                                            y_endianness,
+                                            ys_layout,
+                                            thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 keys,
+                 keys_count,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 ys_layout,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_keys_ctx(pfss_eval_context * const context,
+                       pfss_key const * const * const keys,
+                       uint32_t const keys_count,
+                       uint8_t const * const xs,
+                       uint64_t const xs_count,
+                       uint32_t const x_size,
+                       pfss_endianness const x_endianness,
+                       uint8_t * const ys,
+                       uint32_t const y_size,
+                       pfss_endianness const y_endianness,
+                       pfss_layout const ys_layout,
+                       uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_map_eval_keys_nolog(context,
+                                            keys,
+                                            keys_count,
+                                            xs,
+                                            xs_count,
+                                            x_size,
+                                            x_endianness,
+                                            ys,
+                                            y_size,
+                                            y_endianness,
+                                            ys_layout,
+                                            thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 keys,
+                 keys_count,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 ys_layout,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_key_set(pfss_eval_context * const context,
+                      pfss_key_set const * const key_set,
+                      uint8_t const * const xs,
+                      uint64_t const xs_count,
+                      uint32_t const x_size,
+                      pfss_endianness const x_endianness,
+                      uint8_t * const ys,
+                      uint32_t const y_size,
+                      pfss_endianness const y_endianness,
+                      pfss_layout const ys_layout,
+                      uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_map_eval_keys_nolog(context,
+                                            key_set_keys(key_set),
+                                            key_set_keys_count(key_set),
+                                            xs,
+                                            xs_count,
+                                            x_size,
+                                            x_endianness,
+                                            ys,
+                                            y_size,
+                                            y_endianness,
+                                            ys_layout,
+                                            thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key_set,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 ys_layout,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_reduce_sum
+//----------------------------------------------------------------------
+
+// TODO: We should be able to use uint_buf here somehow.
+
+namespace {
+
+template<class Y, bool Aligned, bool Reverse>
+Y reduce_sum(
+    uint32_t const range_bits,
+    uint8_t const * ys,
+    uint32_t ys_count) noexcept {
+  PFSS_SST_STATIC_ASSERT(
+      (std::is_same<Y, std::uint8_t>::value ||
+       std::is_same<Y, std::uint16_t>::value ||
+       std::is_same<Y, std::uint32_t>::value ||
+       std::is_same<Y, std::uint64_t>::value));
+  assert(range_bits > 0);
+  assert(bits_to_bytes(range_bits) <= sizeof(Y));
+  assert(ys != nullptr);
+  assert(ys_count > 0);
+  typename promote_unsigned<Y>::type sum = 0;
+  while (ys_count--) {
+    Y y;
+    if (Aligned) {
+      auto const p = reinterpret_cast<Y const *>(ys);
+      if (Reverse) {
+        y = reverse_bytes(*p);
+      } else {
+        y = *p;
+      }
+    } else {
+      auto const q = reinterpret_cast<uint8_t *>(&y);
+      if (Reverse) {
+        std::reverse_copy(ys, ys + sizeof(Y), q);
+      } else {
+        std::copy(ys, ys + sizeof(Y), q);
+      }
+    }
+    sum += y;
+    ys += sizeof(Y);
+  }
+  return static_cast<Y>(
+      sum & get_mask<Y>(static_cast<int>(range_bits)));
+}
+
+pfss_status pfss_reduce_sum_nolog(
+    uint32_t const range_bits,
+    uint8_t const * const ys,
+    uint32_t const ys_count,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    uint8_t * const z,
+    uint32_t const z_size,
+    pfss_endianness const z_endianness) {
+  try {
+    validate_range_bits(range_bits);
+    validate_pointer(ys);
+    validate_size(ys_count);
+    validate_byte_size(y_size, range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    validate_pointer(z);
+    validate_byte_size(z_size, range_bits);
+    bool const z_is_little_endian = validate_endianness(z_endianness);
+    uint_buf_type z_buf(z, z_size, z_is_little_endian);
+    switch (y_size) {
+      case 1: {
+        z_buf = reduce_sum<std::uint8_t, true, false>(
+            range_bits, ys, ys_count);
+      } break;
+#define C(Y) \
+  case sizeof(Y): { \
+    bool const aligned = is_aligned<Y>(ys); \
+    bool const reverse = \
+        y_is_little_endian != system_is_little_endian(); \
+    if (aligned) { \
+      if (reverse) { \
+        z_buf = reduce_sum<Y, true, true>(range_bits, ys, ys_count); \
+      } else { \
+        z_buf = reduce_sum<Y, true, false>(range_bits, ys, ys_count); \
+      } \
+    } else { \
+      if (reverse) { \
+        z_buf = reduce_sum<Y, false, true>(range_bits, ys, ys_count); \
+      } else { \
+        z_buf = reduce_sum<Y, false, false>(range_bits, ys, ys_count); \
+      } \
+    } \
+  } break
+        C(std::uint16_t);
+        C(std::uint32_t);
+        C(std::uint64_t);
+#undef C
+      default: {
+        throw error(PFSS_UNKNOWN_ERROR);
+      } break;
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_reduce_sum(uint32_t const range_bits,
+                            uint8_t const * const ys,
+                            uint32_t const ys_count,
+                            uint32_t const y_size,
+                            pfss_endianness const y_endianness,
+                            uint8_t * const z,
+                            uint32_t const z_size,
+                            pfss_endianness const z_endianness) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_reduce_sum_nolog(range_bits,
+                                         ys,
+                                         ys_count,
+                                         y_size,
+                                         y_endianness,
+                                         z,
+                                         z_size,
+                                         z_endianness);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 range_bits,
+                 ys,
+                 ys_count,
+                 y_size,
+                 y_endianness,
+                 z,
+                 z_size,
+                 z_endianness);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_map_eval_reduce_sum
+//----------------------------------------------------------------------
+
+namespace {
+
+template<class Scheme>
+typename promote_unsigned<typename Scheme::range_type>::type
+map_eval_reduce_sum_range(Scheme const & scheme,
+                          typename Scheme::key_type const & k,
+                          uint8_t const * xs,
+                          std::size_t xs_count,
+                          uint32_t const x_size,
+                          bool const x_is_little_endian,
+                          typename Scheme::rand_perm_type & rand_perm) {
+  using domain_type = typename Scheme::domain_type;
+  typename promote_unsigned<typename Scheme::range_type>::type sum = 0;
+  domain_batch<domain_type> lane_xs;
+  for (; xs_count >= map_eval_lanes; xs_count -= map_eval_lanes) {
+    typename Scheme::range_type lane_ys[map_eval_lanes];
+    scheme.template eval_xn<map_eval_lanes>(
+        k,
+        lane_xs.load(xs, map_eval_lanes, x_size, x_is_little_endian),
+        rand_perm,
+        lane_ys);
+    for (auto const lane_y : lane_ys) {
+      sum += lane_y;
+    }
+    xs += map_eval_lanes * x_size;
+  }
+  while (xs_count--) {
+    uint_buf_type const x_buf(xs, x_size, x_is_little_endian);
+    sum += scheme.eval(k, to_domain<domain_type>(x_buf), rand_perm);
+    xs += x_size;
+  }
+  return sum;
+}
+
+template<class Scheme>
+void map_eval_reduce_sum_op(pfss_eval_context * const context,
+                            pfss_key const * const key,
+                            uint8_t const * const xs,
+                            uint32_t const x_size,
+                            bool const x_is_little_endian,
+                            uint8_t * const y,
+                            uint32_t const y_size,
+                            bool const y_is_little_endian,
+                            map_eval_plan const & plan) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  auto const & k = scheme.as_key(key->inner_key);
+  using sum_type =
+      typename promote_unsigned<typename Scheme::range_type>::type;
+  std::vector<sum_type> partials(plan.tasks);
+  context->run(
+      plan.num_threads,
+      plan.tasks,
+      [&](std::size_t const t, eval_scratch & scratch) {
+        std::size_t const first = plan.first(t);
+        partials[t] =
+            map_eval_reduce_sum_range(scheme,
+                                      k,
+                                      xs + first * x_size,
+                                      plan.first(t + 1) - first,
+                                      x_size,
+                                      x_is_little_endian,
+                                      scratch.rand_perm);
+      });
+  sum_type sum = 0;
+  for (sum_type const partial : partials) {
+    sum += partial;
+  }
+  uint_buf_type y_buf(y, y_size, y_is_little_endian);
+  y_buf = sum & get_mask<sum_type>(scheme.range_bits);
+}
+
+pfss_status pfss_map_eval_reduce_sum_nolog(
+    pfss_eval_context * const context,
+    pfss_key const * const key,
+    uint8_t const * const xs,
+    uint64_t const xs_count,
+    uint32_t const x_size,
+    pfss_endianness const x_endianness,
+    uint8_t * const y,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    uint32_t const thread_count) {
+  try {
+    validate_pointer(context);
+    validate_pointer(key);
+    validate_pointer(xs);
+    validate_size(xs_count);
+    validate_size(x_size);
+    bool const x_is_little_endian = validate_endianness(x_endianness);
+    validate_pointer(y);
+    validate_byte_size(y_size, key->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    validate_size(thread_count);
+    map_eval_plan const plan =
+        get_map_eval_plan(xs_count, thread_count);
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    if (key->header[0] == 0) {
+      key->ops->map_eval_reduce_sum(context,
+                                    key,
+                                    xs,
+                                    x_size,
+                                    x_is_little_endian,
+                                    y,
+                                    y_size,
+                                    y_is_little_endian,
+                                    plan);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_reduce_sum(pfss_key const * const key,
+                         uint8_t const * const xs,
+                         uint32_t const xs_count,
+                         uint32_t const x_size,
+                         pfss_endianness const x_endianness,
+                         uint8_t * const y,
+                         uint32_t const y_size,
+                         pfss_endianness const y_endianness) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_eval_reduce_sum_nolog(&context,
+                                                  key,
+                                                  xs,
+                                                  xs_count,
+                                                  x_size,
+                                                  x_endianness,
+                                                  y,
+                                                  y_size,
+                                                  y_endianness,
+                                                  1);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 y,
+                 y_size,
+                 y_endianness);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_reduce_sum_mt(pfss_key const * const key,
+                            uint8_t const * const xs,
+                            uint64_t const xs_count,
+                            uint32_t const x_size,
+                            pfss_endianness const x_endianness,
+                            uint8_t * const y,
+                            uint32_t const y_size,
+                            pfss_endianness const y_endianness,
+                            uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_map_eval_reduce_sum_nolog(&context,
+                                                  key,
+                                                  xs,
+                                                  xs_count,
+                                                  x_size,
+                                                  x_endianness,
+                                                  y,
+                                                  y_size,
+                                                  y_endianness,
+                                                  thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 y,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_map_eval_reduce_sum_ctx(pfss_eval_context * const context,
+                             pfss_key const * const key,
+                             uint8_t const * const xs,
+                             uint64_t const xs_count,
+                             uint32_t const x_size,
+                             pfss_endianness const x_endianness,
+                             uint8_t * const y,
+                             uint32_t const y_size,
+                             pfss_endianness const y_endianness,
+                             uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_map_eval_reduce_sum_nolog(context,
+                                                  key,
+                                                  xs,
+                                                  xs_count,
+                                                  x_size,
+                                                  x_endianness,
+                                                  y,
+                                                  y_size,
+                                                  y_endianness,
+                                                  thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key,
+                 xs,
+                 xs_count,
+                 x_size,
+                 x_endianness,
+                 y,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// Utilities for pfss_eval_all{,_sum,_dot}
+//----------------------------------------------------------------------
+
+namespace {
+
+// Returns min(T1_max, thread_count, 2^domain_bits).
+template<class T1, class T2, class T3>
+T1 get_num_threads(T2 const thread_count,
+                   T3 const domain_bits) noexcept {
+  assert(thread_count > 0);
+  assert(domain_bits > 0);
+  constexpr T1 T1_max = pfss::type_max<T1>::value;
+  constexpr int T1_bits = pfss::width_bits<T1>::value;
+  T1 const n = pfss::unsigned_lt(thread_count, T1_max) ?
+                   T1(thread_count) :
+                   T1_max;
+  if (pfss::unsigned_ge(domain_bits, T1_bits)) {
+    return n;
+  }
+  T1 const domain_size = T1(T1(1) << domain_bits);
+  return pfss::min(n, domain_size);
+}
+
+// Thread i will own step + (i < slop) + 1 cells.
+template<class T1, class T2>
+std::pair<T1, T1> get_step_and_slop(T1 const num_threads,
+                                    T2 const domain_bits) noexcept {
+  assert(num_threads > 0);
+  assert(domain_bits > 0);
+  constexpr T1 T1_max = pfss::type_max<T1>::value;
+  constexpr int T1_bits = pfss::width_bits<T1>::value;
+  assert(pfss::unsigned_le(domain_bits, T1_bits));
+  if (num_threads == 1) {
+    return std::make_pair(get_mask<T1>(domain_bits), T1(0));
+  }
+  if (pfss::unsigned_eq(domain_bits, T1_bits)) {
+    return std::make_pair(T1(T1_max / num_threads - T1(1)),
+                          T1(T1_max % num_threads + T1(1)));
+  }
+  T1 const domain_size = T1(T1(1) << domain_bits);
+  return std::make_pair(T1(domain_size / num_threads - T1(1)),
+                        T1(domain_size % num_threads));
+}
+
+// pfss_eval_all_{sum,dot} evaluate every key over one tile of the
+// domain before moving on to the next tile, instead of evaluating each
+// key over the whole domain in turn. This keeps the part of ys that
+// the keys are adding into or reading from in the cache, so ys is only
+// streamed from memory once instead of once per key. A tile holds
+// ys_tile_bytes bytes of ys, which should fit comfortably in L2.
+constexpr std::size_t ys_tile_bytes = std::size_t(1) << 18;
+
+// Returns the last cell of the tile that starts at x, where tiles are
+// aligned to multiples of tile_size, which must be a power of two. A
+// tile_size of zero means that the whole range is one tile.
+inline std::size_t get_tile_last(std::size_t const x,
+                                 std::size_t const x_last,
+                                 std::size_t const tile_size) noexcept {
+  assert(x <= x_last);
+  if (tile_size == 0) {
+    return x_last;
+  }
+  assert((tile_size & (tile_size - 1)) == 0);
+  return pfss::min(x_last, x | (tile_size - 1));
+}
+
+// Returns the number of bits in the tiles of ys that hold y_size-byte
+// cells.
+inline int get_ys_tile_bits(uint32_t const y_size) noexcept {
+  assert(y_size > 0);
+  int bits = 0;
+  while ((ys_tile_bytes >> (bits + 1)) >= y_size) {
+    ++bits;
+  }
+  return bits;
+}
+
+//
+// A packed array of width-bit elements stores element i in bits
+// i * width to i * width + width - 1 of a bit string, least significant
+// bit first, where bit k of the bit string is bit k % 8 of byte k / 8.
+// The functions that take packed arrays support a width of at most 64
+// bits and a domain small enough that every bit index fits in a
+// std::size_t.
+//
+
+constexpr int max_packed_width = 64;
+
+template<class T>
+void validate_packed(int const domain_bits, T const width) {
+  if (unsigned_gt(width, max_packed_width)) {
+    throw error(PFSS_INVALID_ARGUMENT);
+  }
+  if (!unsigned_lt(domain_bits + 6, type_bits<std::size_t>())) {
+    throw error(PFSS_DOMAIN_OVERFLOW);
+  }
+}
+
+inline std::uint64_t get_packed(uint8_t const * const ys,
+                                std::size_t const i,
+                                int const width) noexcept {
+  std::size_t const bit = i * static_cast<std::size_t>(width);
+  uint8_t const * p = ys + bit / 8;
+  int have = 8 - static_cast<int>(bit % 8);
+  std::uint64_t x = *p >> (8 - have);
+  while (have < width) {
+    x |= static_cast<std::uint64_t>(*++p) << have;
+    have += 8;
+  }
+  return x & get_mask<std::uint64_t>(width);
+}
+
+inline void set_packed(uint8_t * const ys,
+                       std::size_t const i,
+                       int const width,
+                       std::uint64_t const y) noexcept {
+  std::size_t const bit = i * static_cast<std::size_t>(width);
+  uint8_t * p = ys + bit / 8;
+  int const r = static_cast<int>(bit % 8);
+  int done = pfss::min(8 - r, width);
+  unsigned int const m = ((1U << done) - 1) << r;
+  *p = static_cast<uint8_t>((*p & ~m) | ((y << r) & m));
+  while (done < width) {
+    int const n = pfss::min(8, width - done);
+    unsigned int const m2 = (1U << n) - 1;
+    ++p;
+    *p = static_cast<uint8_t>((*p & ~m2) | ((y >> done) & m2));
+    done += n;
+  }
+}
+
+//
+// Writes consecutive elements of a packed array. Whole bytes are
+// stored as soon as they fill up, and only the first and last bytes,
+// which may hold bits of neighboring elements, are read back and
+// merged, the last one by flush. Elements must already fit in width
+// bits.
+//
+
+class packed_writer {
+  uint8_t * p_;
+  std::uint64_t acc_;
+  int acc_bits_;
+  int width_;
+
+  void put_bits(std::uint64_t const y, int const n) noexcept {
+    acc_ |= y << acc_bits_;
+    acc_bits_ += n;
+    while (acc_bits_ >= 8) {
+      *p_++ = static_cast<uint8_t>(acc_);
+      acc_ >>= 8;
+      acc_bits_ -= 8;
+    }
+  }
+
+public:
+  packed_writer(uint8_t * const ys,
+                std::size_t const i,
+                int const width) noexcept
+      : p_(ys + i * static_cast<std::size_t>(width) / 8),
+        acc_(0),
+        acc_bits_(static_cast<int>(i * static_cast<std::size_t>(width)
+                                   % 8)),
+        width_(width) {
+    assert(width > 0);
+    assert(width <= max_packed_width);
+    acc_ = *p_ & get_mask<std::uint64_t>(acc_bits_);
+  }
+
+  packed_writer(packed_writer const &) = delete;
+  packed_writer & operator=(packed_writer const &) = delete;
+
+  void put(std::uint64_t const y) noexcept {
+    // acc_bits_ is below 8 here, so up to 56 bits fit in acc_.
+    if (width_ > 56) {
+      put_bits(y & get_mask<std::uint64_t>(32), 32);
+      put_bits(y >> 32, width_ - 32);
+    } else {
+      put_bits(y, width_);
+    }
+  }
+
+  void flush() noexcept {
+    if (acc_bits_ != 0) {
+      unsigned int const m = (1U << acc_bits_) - 1;
+      *p_ = static_cast<uint8_t>((*p_ & ~m) | (acc_ & m));
+    }
+  }
+};
+
+// Lets eval_all write to a packed_writer through uint_buf_iterator.
+class packed_writer_ref {
+  packed_writer * w_;
+
+public:
+  explicit packed_writer_ref(packed_writer * const w) noexcept : w_(w) {
+  }
+
+  void increment() noexcept {
+  }
+
+  template<class Arg,
+           typename std::enable_if<std::is_integral<Arg>::value,
+                                   int>::type = 0>
+  packed_writer_ref const & operator=(Arg const arg) const noexcept {
+    w_->put(static_cast<std::uint64_t>(arg));
+    return *this;
+  }
+};
+
+// pfss_eval_all_{sum,dot} aim for about 2^eval_all_task_slack_bits
+// tasks per thread, so that a thread that falls behind only holds up
+// the others for a fraction of its share.
+constexpr int eval_all_task_slack_bits = 2;
+
+//
+// The work of pfss_eval_all_{sum,dot} is a grid of tasks: the keys are
+// split into key_blocks blocks of key_block_size keys (the last block
+// may be shorter) and the domain is split into chunks of whole tiles.
+// Task t evaluates the keys of block t / chunks() over chunk
+// t % chunks(). The threads take tasks as they finish their previous
+// ones, so all of them stay busy whatever the shape of the batch.
+//
+// The domain is split first. The keys are only split when there are
+// fewer chunks than threads, which is the case for small domains, and
+// then into at most max_key_blocks blocks.
+//
+
+struct eval_all_plan {
+  std::size_t num_threads;
+  std::size_t key_blocks;
+  std::size_t key_block_size;
+  // Chunk i owns the cells from x_firsts[i] to x_firsts[i + 1] - 1.
+  // The last entry wraps to zero when the domain fills a std::size_t.
+  std::vector<std::size_t> x_firsts;
+
+  std::size_t chunks() const noexcept {
+    return x_firsts.size() - 1;
+  }
+
+  std::size_t tasks() const noexcept {
+    return key_blocks * chunks();
+  }
+};
+
+inline eval_all_plan get_eval_all_plan(uint32_t const thread_count,
+                                       uint32_t const keys_count,
+                                       int const domain_bits,
+                                       int const tile_bits,
+                                       std::size_t const max_key_blocks) {
+  assert(thread_count > 0);
+  assert(keys_count > 0);
+  assert(domain_bits > 0);
+  assert(tile_bits >= 0);
+  assert(max_key_blocks > 0);
+  constexpr int size_bits = pfss::width_bits<std::size_t>::value;
+  std::size_t const threads = thread_count;
+  std::size_t const want =
+      threads > (type_max<std::size_t>::value >> eval_all_task_slack_bits) ?
+          type_max<std::size_t>::value :
+          threads << eval_all_task_slack_bits;
+  int const tiles_bits =
+      domain_bits > tile_bits ? domain_bits - tile_bits : 0;
+  std::size_t const tiles = tiles_bits >= size_bits - 1 ?
+                                type_max<std::size_t>::value :
+                                std::size_t(1) << tiles_bits;
+  std::size_t chunks = 1;
+  std::size_t key_blocks = 1;
+  if (threads == 1) {
+    // Nothing to split.
+  } else if (tiles >= threads) {
+    chunks = pfss::min(want, tiles);
+  } else {
+    chunks = tiles;
+    key_blocks = (want + chunks - 1) / chunks;
+    key_blocks = pfss::min(key_blocks, std::size_t(keys_count));
+    key_blocks = pfss::min(key_blocks, max_key_blocks);
+  }
+  eval_all_plan plan;
+  plan.key_block_size = (keys_count + key_blocks - 1) / key_blocks;
+  plan.key_blocks =
+      (keys_count + plan.key_block_size - 1) / plan.key_block_size;
+  plan.x_firsts.resize(chunks + 1);
+  if (chunks == 1) {
+    plan.x_firsts[1] = unsigned_eq(domain_bits, size_bits) ?
+                           0 :
+                           std::size_t(1) << domain_bits;
+  } else {
+    std::pair<std::size_t, std::size_t> const step_and_slop =
+        get_step_and_slop(chunks, tiles_bits);
+    std::size_t const step = step_and_slop.first;
+    std::size_t const slop = step_and_slop.second;
+    std::size_t tiles = 0;
+    for (std::size_t i = 0; i != chunks; ++i) {
+      tiles += step + (i < slop) + 1;
+      plan.x_firsts[i + 1] = tiles << tile_bits;
+    }
+  }
+  plan.num_threads = pfss::min(threads, plan.tasks());
+  return plan;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------
+// pfss_eval_all
+//----------------------------------------------------------------------
+
+namespace {
+
+#define PFSS_EVAL_ALL_COMMON_CODE() \
+  do { \
+    Scheme const scheme(key->domain_bits, key->range_bits); \
+    out = scheme.eval_all(scheme.as_key(key->inner_key), \
+                          x, \
+                          x_last, \
+                          scratch.rand_perm, \
+                          scratch.eval_all, \
+                          out); \
+  } while (0)
+
+#define PFSS_EVAL_ALL_TEMPLATE_CODE(DomainBits, RangeBits) \
+  do { \
+    using Scheme = scheme_type<SCHEME_CLASS, DomainBits, RangeBits>; \
+    PFSS_EVAL_ALL_COMMON_CODE(); \
+  } while (0)
+
+#define PFSS_EVAL_ALL_STANDARD_CODE() \
+  do { \
+    using Scheme = scheme_type_v<SCHEME_CLASS_V>; \
+    PFSS_EVAL_ALL_COMMON_CODE(); \
+  } while (0)
+
+// When pfss_eval_all runs on more than one thread, it splits the tree
+// into about 2^eval_all_slack_bits subtrees per thread. The threads
+// take subtrees as they finish their previous ones, so a thread that
+// falls behind only holds up the others for a fraction of its share.
+constexpr int eval_all_slack_bits = 2;
+
+//
+// Where eval_all_threaded writes its outputs. An Output makes a sink
+// for the outputs that start at domain element x, hands its iterator to
+// eval_all, and is told when eval_all is done with it. Tasks start on
+// multiples of 2^min_task_bits domain elements.
+//
+
+struct cell_output {
+  uint8_t * ys;
+  uint32_t y_size;
+  bool y_is_little_endian;
+
+  static constexpr int min_task_bits = 0;
+
+  class sink {
+    uint_buf_iterator<uint32_t> out_;
+
+  public:
+    sink(cell_output const & o, std::size_t const x) noexcept
+        : out_(o.ys + x * o.y_size, o.y_size, o.y_is_little_endian) {
+    }
+
+    uint_buf_iterator<uint32_t> begin() const noexcept {
+      return out_;
+    }
+
+    void finish() noexcept {
+    }
+  };
+};
+
+// Tasks start on whole bytes, so no two threads write to the same byte.
+struct packed_output {
+  uint8_t * ys;
+  int width;
+
+  static constexpr int min_task_bits = 3;
+
+  class sink {
+    packed_writer w_;
+
+  public:
+    sink(packed_output const & o, std::size_t const x) noexcept
+        : w_(o.ys, x, o.width) {
+    }
+
+    uint_buf_iterator<packed_writer_ref> begin() noexcept {
+      return uint_buf_iterator<packed_writer_ref>(&w_);
+    }
+
+    void finish() noexcept {
+      w_.flush();
+    }
+  };
+};
+
+//
+// Evaluates the key at the 2^rbits domain elements that start at x on
+// up to num_threads threads. The top of the tree is expanded once,
+// down to a frontier with a few nodes per thread, and each thread then
+// expands whole subtrees from the frontier.
+//
+
+template<class Scheme, class Output>
+void eval_all_threaded(pfss_eval_context & context,
+                       Scheme const & scheme,
+                       typename Scheme::key_type const & key,
+                       std::size_t const x,
+                       int const rbits,
+                       std::size_t const num_threads,
+                       Output const & output) {
+  int const v = scheme.v;
+  int const n_minus_v = scheme.n_minus_v;
+  std::size_t const x_last = x | get_mask<std::size_t>(rbits);
+  int const node_bits = rbits > n_minus_v ? rbits - n_minus_v : 0;
+  int const task_bits = rbits > Output::min_task_bits ?
+                            rbits - Output::min_task_bits :
+                            0;
+  int const max_split_bits = pfss::min(node_bits, task_bits);
+  int split_bits = 0;
+  while (split_bits != max_split_bits
+         && (std::size_t(1) << split_bits) < num_threads) {
+    ++split_bits;
+  }
+  if (num_threads == 1 || split_bits == 0) {
+    eval_scratch & scratch = context.main_scratch();
+    typename Output::sink out(output, x);
+    scheme.eval_all(key,
+                    x,
+                    x_last,
+                    scratch.rand_perm,
+                    scratch.eval_all,
+                    out.begin());
+    out.finish();
+    return;
+  }
+  split_bits = min(split_bits + eval_all_slack_bits, max_split_bits);
+  int const root_depth = v - node_bits;
+  std::size_t const prefix =
+      unsigned_eq(rbits, type_bits<std::size_t>()) ? 0 : x >> rbits;
+  std::vector<typename Scheme::cache_entry_t> nodes(std::size_t(1)
+                                                    << split_bits);
+  scheme.eval_frontier(key,
+                       prefix,
+                       root_depth,
+                       split_bits,
+                       context.main_scratch().rand_perm,
+                       nodes.data());
+  int const sub_bits = rbits - split_bits;
+  context.run(
+      num_threads,
+      nodes.size(),
+      [&](std::size_t const j, eval_scratch & scratch) {
+        std::size_t const x_j = x + (j << sub_bits);
+        typename Output::sink out(output, x_j);
+        scheme.eval_all(key,
+                        root_depth + split_bits,
+                        nodes[j],
+                        x_j,
+                        x_j | get_mask<std::size_t>(sub_bits),
+                        scratch.rand_perm,
+                        scratch.eval_all,
+                        out.begin());
+        out.finish();
+      });
+}
+
+template<class Scheme>
+void eval_all_op(pfss_eval_context * const context,
+                 pfss_key const * const key,
+                 std::size_t const x,
+                 int const rbits,
+                 std::size_t const num_threads,
+                 uint8_t * const ys,
+                 uint32_t const y_size,
+                 bool const y_is_little_endian) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  cell_output const output = {ys, y_size, y_is_little_endian};
+  eval_all_threaded(*context,
+                    scheme,
+                    scheme.as_key(key->inner_key),
+                    x,
+                    rbits,
+                    num_threads,
+                    output);
+}
+
+template<class Scheme>
+void eval_all_packed_op(pfss_eval_context * const context,
+                        pfss_key const * const key,
+                        std::size_t const x,
+                        int const rbits,
+                        std::size_t const num_threads,
+                        uint8_t * const ys) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  packed_output const output = {ys, key->range_bits};
+  eval_all_threaded(*context,
+                    scheme,
+                    scheme.as_key(key->inner_key),
+                    x,
+                    rbits,
+                    num_threads,
+                    output);
+}
+
+//
+// If packed is true, ys is a packed array of range_bits-bit elements
+// and y_size and y_endianness are ignored.
+//
+
+pfss_status pfss_eval_all_nolog(
+    pfss_eval_context * const context,
+    pfss_key const * const key,
+    uint8_t const * const xp,
+    uint32_t const xp_bits,
+    pfss_endianness const xp_endianness,
+    uint8_t * const ys,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    uint32_t const thread_count,
+    bool const packed) {
+  try {
+    validate_pointer(context);
+    validate_pointer(key);
+    validate_pointer(xp);
+    bool const xp_is_little_endian = validate_endianness(xp_endianness);
+    validate_pointer(ys);
+    bool y_is_little_endian = false;
+    if (packed) {
+      validate_packed(key->domain_bits, key->range_bits);
+    } else {
+      validate_byte_size(y_size, key->range_bits);
+      y_is_little_endian = validate_endianness(y_endianness);
+    }
+    if (unsigned_gt(xp_bits, key->domain_bits)) {
+      throw error(PFSS_DOMAIN_OVERFLOW);
+    }
+    if (unsigned_gt(key->domain_bits, type_bits<std::size_t>())) {
+      throw error(PFSS_DOMAIN_OVERFLOW);
+    }
+    int const rbits = key->domain_bits - static_cast<int>(xp_bits);
+    std::size_t x = 0;
+    if (xp_bits != 0) {
+      uint_buf_type const xp_buf(
+          xp, bits_to_bytes(xp_bits), xp_is_little_endian);
+      for (decltype(+xp_bits) i = xp_bits; i != 0; --i) {
+        x <<= 1;
+        x |= static_cast<std::size_t>(xp_buf.getbitx(i - 1));
+      }
+      x <<= rbits;
+    }
+    validate_size(thread_count);
+    std::size_t const num_threads =
+        rbits == 0 ? 1 :
+                     get_num_threads<std::size_t>(thread_count, rbits);
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    if (key->header[0] != 0) {
+      throw error(PFSS_UNKNOWN_ERROR);
+    } else if (packed) {
+      key->ops->eval_all_packed(context, key, x, rbits, num_threads, ys);
+    } else {
+      key->ops->eval_all(context,
+                         key,
+                         x,
+                         rbits,
+                         num_threads,
+                         ys,
+                         y_size,
+                         y_is_little_endian);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all(pfss_key const * const key,
+                          uint8_t const * const xp,
+                          uint32_t const xp_bits,
+                          pfss_endianness const xp_endianness,
+                          uint8_t * const ys,
+                          uint32_t const y_size,
+                          pfss_endianness const y_endianness) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_eval_all_nolog(&context,
+                                       key,
+                                       xp,
+                                       xp_bits,
+                                       xp_endianness,
+                                       ys,
+                                       y_size,
+                                       y_endianness,
+                                       1,
+                                       false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xp,
+                 xp_bits,
+                 xp_endianness,
+                 ys,
+                 y_size,
+                 y_endianness);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_mt(pfss_key const * const key,
+                             uint8_t const * const xp,
+                             uint32_t const xp_bits,
+                             pfss_endianness const xp_endianness,
+                             uint8_t * const ys,
+                             uint32_t const y_size,
+                             pfss_endianness const y_endianness,
+                             uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_eval_all_nolog(&context,
+                                       key,
+                                       xp,
+                                       xp_bits,
+                                       xp_endianness,
+                                       ys,
+                                       y_size,
+                                       y_endianness,
+                                       thread_count,
+                                       false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 xp,
+                 xp_bits,
+                 xp_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_ctx(pfss_eval_context * const context,
+                              pfss_key const * const key,
+                              uint8_t const * const xp,
+                              uint32_t const xp_bits,
+                              pfss_endianness const xp_endianness,
+                              uint8_t * const ys,
+                              uint32_t const y_size,
+                              pfss_endianness const y_endianness,
+                              uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_nolog(context,
+                                       key,
+                                       xp,
+                                       xp_bits,
+                                       xp_endianness,
+                                       ys,
+                                       y_size,
+                                       y_endianness,
+                                       thread_count,
+                                       false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key,
+                 xp,
+                 xp_bits,
+                 xp_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_packed_ctx(pfss_eval_context * const context,
+                                     pfss_key const * const key,
+                                     uint8_t const * const xp,
+                                     uint32_t const xp_bits,
+                                     pfss_endianness const xp_endianness,
+                                     uint8_t * const ys,
+                                     uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_nolog(context,
+                                       key,
+                                       xp,
+                                       xp_bits,
+                                       xp_endianness,
+                                       ys,
+                                       0,
+                                       PFSS_NATIVE_ENDIAN,
+                                       thread_count,
+                                       true);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key,
+                 xp,
+                 xp_bits,
+                 xp_endianness,
+                 ys,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_eval_range
+//----------------------------------------------------------------------
+
+namespace {
+
+// When pfss_eval_range runs on more than one thread, it splits the
+// interval into about 2^eval_range_slack_bits tasks per thread.
+constexpr int eval_range_slack_bits = 2;
+
+//
+// Evaluates the key at every x in [x_lo, x_hi] on up to thread_count
+// threads and writes the output for x to cell x - x_lo of ys.
+//
+// Each task hands its part of the interval to eval_all, which covers it
+// with aligned subtrees and keeps the path down to the last subtree, so
+// the nodes shared by neighboring subtrees are only expanded once. The
+// task boundaries are aligned to the largest subtrees that eval_all
+// expands, so splitting the interval does not split any subtree that
+// eval_all would otherwise expand whole.
+//
+
+template<class Scheme>
+void eval_range_threaded(pfss_eval_context & context,
+                         Scheme const & scheme,
+                         typename Scheme::key_type const & key,
+                         std::size_t const x_lo,
+                         std::size_t const x_hi,
+                         uint32_t const thread_count,
+                         uint8_t * const ys,
+                         uint32_t const y_size,
+                         bool const y_is_little_endian) {
+  constexpr int size_bits = pfss::width_bits<std::size_t>::value;
+  int const tile_bits = Scheme::eval_all_tile_bits;
+  int const unit_bits = scheme.n_minus_v + tile_bits;
+  std::size_t const u_lo =
+      unit_bits >= size_bits ? 0 : x_lo >> unit_bits;
+  std::size_t const u_hi =
+      unit_bits >= size_bits ? 0 : x_hi >> unit_bits;
+  // The interval touches units u_lo to u_hi, and unit_bits is at least
+  // tile_bits, so counting them cannot overflow.
+  std::size_t const units = u_hi - u_lo + 1;
+  std::size_t const threads = thread_count;
+  std::size_t tasks = 1;
+  if (threads != 1) {
+    tasks = threads > (type_max<std::size_t>::value
+                       >> eval_range_slack_bits) ?
+                type_max<std::size_t>::value :
+                threads << eval_range_slack_bits;
+    tasks = pfss::min(tasks, units);
+  }
+  if (tasks == 1) {
+    eval_scratch & scratch = context.main_scratch();
+    uint_buf_iterator<uint32_t> const out(ys, y_size, y_is_little_endian);
+    scheme.eval_all(
+        key, x_lo, x_hi, scratch.rand_perm, scratch.eval_all, out);
+    return;
+  }
+  // Task t covers the units from first_unit(t) up to first_unit(t + 1),
+  // except that the first and last tasks are clipped to the interval.
+  std::size_t const step = units / tasks;
+  std::size_t const slop = units % tasks;
+  auto const first_unit = [=](std::size_t const t) -> std::size_t {
+    return u_lo + t * step + pfss::min(t, slop);
+  };
+  context.run(
+      pfss::min(threads, tasks),
+      tasks,
+      [&](std::size_t const t, eval_scratch & scratch) {
+        std::size_t const a =
+            t == 0 ? x_lo : first_unit(t) << unit_bits;
+        std::size_t const b = t == tasks - 1 ?
+                                  x_hi :
+                                  (first_unit(t + 1) << unit_bits) - 1;
+        uint_buf_iterator<uint32_t> const out(
+            ys + (a - x_lo) * y_size, y_size, y_is_little_endian);
+        scheme.eval_all(
+            key, a, b, scratch.rand_perm, scratch.eval_all, out);
+      });
+}
+
+template<class Scheme>
+void eval_range_op(pfss_eval_context * const context,
+                   pfss_key const * const key,
+                   std::size_t const x_lo,
+                   std::size_t const x_hi,
+                   uint32_t const thread_count,
+                   uint8_t * const ys,
+                   uint32_t const y_size,
+                   bool const y_is_little_endian) {
+  Scheme const scheme(key->domain_bits, key->range_bits);
+  eval_range_threaded(*context,
+                      scheme,
+                      scheme.as_key(key->inner_key),
+                      x_lo,
+                      x_hi,
+                      thread_count,
+                      ys,
+                      y_size,
+                      y_is_little_endian);
+}
+
+pfss_status pfss_eval_range_nolog(
+    pfss_eval_context * const context,
+    pfss_key const * const key,
+    uint8_t const * const x_lo_buf,
+    uint8_t const * const x_hi_buf,
+    uint32_t const x_size,
+    pfss_endianness const x_endianness,
+    uint8_t * const ys,
+    uint32_t const y_size,
+    pfss_endianness const y_endianness,
+    uint32_t const thread_count) {
+  try {
+    validate_pointer(context);
+    validate_pointer(key);
+    validate_pointer(x_lo_buf);
+    validate_pointer(x_hi_buf);
+    validate_size(x_size);
+    bool const x_is_little_endian = validate_endianness(x_endianness);
+    validate_pointer(ys);
+    validate_byte_size(y_size, key->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    validate_size(thread_count);
+    if (unsigned_gt(key->domain_bits, type_bits<std::size_t>())) {
+      throw error(PFSS_DOMAIN_OVERFLOW);
+    }
+    uint_buf_type const x_lo_value(x_lo_buf, x_size, x_is_little_endian);
+    uint_buf_type const x_hi_value(x_hi_buf, x_size, x_is_little_endian);
+    if (!x_lo_value.fits(key->domain_bits)
+        || !x_hi_value.fits(key->domain_bits)) {
+      throw error(PFSS_DOMAIN_OVERFLOW);
+    }
+    std::size_t const x_lo = x_lo_value.get_as<std::size_t>();
+    std::size_t const x_hi = x_hi_value.get_as<std::size_t>();
+    if (x_lo > x_hi) {
+      throw error(PFSS_INVALID_ARGUMENT);
+    }
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    if (key->header[0] == 0) {
+      key->ops->eval_range(context,
+                           key,
+                           x_lo,
+                           x_hi,
+                           thread_count,
+                           ys,
+                           y_size,
+                           y_is_little_endian);
+    } else {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
+  }
+  return PFSS_OK;
+}
+
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_range(pfss_key const * const key,
+                            uint8_t const * const x_lo,
+                            uint8_t const * const x_hi,
+                            uint32_t const x_size,
+                            pfss_endianness const x_endianness,
+                            uint8_t * const ys,
+                            uint32_t const y_size,
+                            pfss_endianness const y_endianness,
+                            uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  pfss_eval_context context;
+  auto const ret = pfss_eval_range_nolog(&context,
+                                         key,
+                                         x_lo,
+                                         x_hi,
+                                         x_size,
+                                         x_endianness,
+                                         ys,
+                                         y_size,
+                                         y_endianness,
+                                         thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 key,
+                 x_lo,
+                 x_hi,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_range_ctx(pfss_eval_context * const context,
+                                pfss_key const * const key,
+                                uint8_t const * const x_lo,
+                                uint8_t const * const x_hi,
+                                uint32_t const x_size,
+                                pfss_endianness const x_endianness,
+                                uint8_t * const ys,
+                                uint32_t const y_size,
+                                pfss_endianness const y_endianness,
+                                uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_range_nolog(context,
+                                         key,
+                                         x_lo,
+                                         x_hi,
+                                         x_size,
+                                         x_endianness,
+                                         ys,
+                                         y_size,
+                                         y_endianness,
+                                         thread_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key,
+                 x_lo,
+                 x_hi,
+                 x_size,
+                 x_endianness,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// pfss_eval_all_cursor
+//----------------------------------------------------------------------
 
-#define PFSS_EVAL_ALL_STANDARD_CODE() \
-  do { \
-    using Scheme = scheme_type_v<SCHEME_CLASS_V>; \
-    PFSS_EVAL_ALL_COMMON_CODE(); \
-  } while (0)
+//
+// A cursor walks the domain elements that pfss_eval_all would evaluate
+// in order and hands out their outputs a chunk at a time. Each chunk is
+// evaluated like an interval of pfss_eval_range, into the caller's
+// buffer, so the cursor itself only holds its position and an
+// evaluation context, whose buffers are bounded by the subtree tile
+// size and the depth of the tree.
+//
 
-pfss_status pfss_eval_all_nolog(
+struct pfss_eval_all_cursor {
+  pfss_eval_context context;
+  pfss_key const * key;
+  // The next domain element to evaluate, and the last one.
+  std::size_t x;
+  std::size_t x_last;
+  bool done;
+};
+
+namespace {
+
+pfss_status pfss_eval_all_cursor_create_nolog(
+    pfss_eval_all_cursor ** const p_cursor,
     pfss_key const * const key,
     uint8_t const * const xp,
     uint32_t const xp_bits,
-    pfss_endianness const xp_endianness,
-    uint8_t * const ys,
-    uint32_t const y_size,
-    pfss_endianness const y_endianness) {
+    pfss_endianness const xp_endianness) {
   try {
+    validate_pointer(p_cursor);
     validate_pointer(key);
     validate_pointer(xp);
     bool const xp_is_little_endian = validate_endianness(xp_endianness);
-    validate_pointer(ys);
-    validate_byte_size(y_size, key->range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
     if (unsigned_gt(xp_bits, key->domain_bits)) {
       throw error(PFSS_DOMAIN_OVERFLOW);
     }
     if (unsigned_gt(key->domain_bits, type_bits<std::size_t>())) {
       throw error(PFSS_DOMAIN_OVERFLOW);
     }
+    if (key->header[0] != 0) {
+      throw error(PFSS_UNKNOWN_ERROR);
+    }
     int const rbits = key->domain_bits - static_cast<int>(xp_bits);
     std::size_t x = 0;
     if (xp_bits != 0) {
       uint_buf_type const xp_buf(
           xp, bits_to_bytes(xp_bits), xp_is_little_endian);
-      for (decltype(+xp_bits) i = 0; i != xp_bits; ++i) {
+      for (decltype(+xp_bits) i = xp_bits; i != 0; --i) {
         x <<= 1;
-        x |= static_cast<std::size_t>(xp_buf.getbitx(i));
+        x |= static_cast<std::size_t>(xp_buf.getbitx(i - 1));
       }
       x <<= rbits;
     }
-    std::size_t const x_last = x | get_mask<std::size_t>(rbits);
-    // TODO: x_buf should go away after we make the scheme classes more
-    // flexible regarding the type of alpha and x, i.e., once DomainType
-    // is moved from a template class parameter to a template function
-    // parameter only on those functions. Because then we can use x
-    // directly.
-    uint_buf_type const x_buf(
-        &x, sizeof(x), system_is_little_endian());
-    uint_buf_iterator<uint32_t> out(ys + x * y_size, y_size, y_is_little_endian);
-    if (key->header[0] == 0) {
-#define SCHEME_CLASS pfss::bgi1
-#define SCHEME_CLASS_V pfss::bgi1_v
-      PFSS_SWITCH_DB_RB(
-          key->domain_bits,
-          key->range_bits,
-          PFSS_EVAL_ALL_TEMPLATE_CODE,
-          PFSS_EVAL_ALL_STANDARD_CODE);
-#undef SCHEME_CLASS_V
-#undef SCHEME_CLASS
-    } else {
-      throw error(PFSS_UNKNOWN_ERROR);
-    }
+    std::unique_ptr<pfss_eval_all_cursor> cursor(
+        new pfss_eval_all_cursor);
+    cursor->key = key;
+    cursor->x = x;
+    cursor->x_last = x | get_mask<std::size_t>(rbits);
+    cursor->done = false;
+    *p_cursor = cursor.release();
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -1719,24 +5210,21 @@ pfss_status pfss_eval_all_nolog(
   return PFSS_OK;
 }
 
-}
+} // namespace
 
 PFSS_PUBLIC_C_FUNCTION
-pfss_status pfss_eval_all(pfss_key const * const key,
-                          uint8_t const * const xp,
-                          uint32_t const xp_bits,
-                          pfss_endianness const xp_endianness,
-                          uint8_t * const ys,
-                          uint32_t const y_size,
-                          pfss_endianness const y_endianness) {
+pfss_status
+pfss_eval_all_cursor_create(pfss_eval_all_cursor ** const p_cursor,
+                            pfss_key const * const key,
+                            uint8_t const * const xp,
+                            uint32_t const xp_bits,
+                            pfss_endianness const xp_endianness) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_eval_all_nolog(key,
-                                       xp,
-                                       xp_bits,
-                                       xp_endianness,
-                                       ys,
-                                       y_size,
-                                       y_endianness);
+  auto const ret = pfss_eval_all_cursor_create_nolog(p_cursor,
+                                                     key,
+                                                     xp,
+                                                     xp_bits,
+                                                     xp_endianness);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -1746,65 +5234,142 @@ pfss_status pfss_eval_all(pfss_key const * const key,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
+                 p_cursor,
                  key,
                  xp,
                  xp_bits,
-                 xp_endianness,
-                 ys,
-                 y_size,
-                 y_endianness);
+                 xp_endianness);
     }
   }
   return ret;
 }
 
-//----------------------------------------------------------------------
-// Utilities for pfss_eval_all_{sum,dot}
-//----------------------------------------------------------------------
-
 namespace {
 
-// Returns min(T1_max, thread_count, 2^domain_bits).
-template<class T1, class T2, class T3>
-T1 get_num_threads(T2 const thread_count,
-                   T3 const domain_bits) noexcept {
-  assert(thread_count > 0);
-  assert(domain_bits > 0);
-  constexpr T1 T1_max = pfss::type_max<T1>::value;
-  constexpr int T1_bits = pfss::width_bits<T1>::value;
-  T1 const n = pfss::unsigned_lt(thread_count, T1_max) ?
-                   T1(thread_count) :
-                   T1_max;
-  if (pfss::unsigned_ge(domain_bits, T1_bits)) {
-    return n;
+pfss_status
+pfss_eval_all_cursor_next_nolog(pfss_eval_all_cursor * const cursor,
+                                uint8_t * const ys,
+                                uint32_t const ys_count,
+                                uint32_t const y_size,
+                                pfss_endianness const y_endianness,
+                                uint32_t const thread_count,
+                                uint32_t * const p_ys_count) {
+  try {
+    validate_pointer(cursor);
+    validate_pointer(ys);
+    validate_size(ys_count);
+    pfss_key const * const key = cursor->key;
+    validate_byte_size(y_size, key->range_bits);
+    bool const y_is_little_endian = validate_endianness(y_endianness);
+    validate_size(thread_count);
+    validate_pointer(p_ys_count);
+    if (cursor->done) {
+      *p_ys_count = 0;
+      return PFSS_OK;
+    }
+    std::size_t const x_lo = cursor->x;
+    std::size_t const x_hi =
+        cursor->x_last - x_lo < ys_count - std::size_t(1) ?
+            cursor->x_last :
+            x_lo + (ys_count - std::size_t(1));
+    pfss_eval_context & context = cursor->context;
+    std::lock_guard<std::mutex> const lock(context.mutex);
+    key->ops->eval_range(&context,
+                         key,
+                         x_lo,
+                         x_hi,
+                         thread_count,
+                         ys,
+                         y_size,
+                         y_is_little_endian);
+    cursor->done = x_hi == cursor->x_last;
+    cursor->x = x_hi + 1;
+    *p_ys_count = static_cast<uint32_t>(x_hi - x_lo + 1);
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
   }
-  T1 const domain_size = T1(T1(1) << domain_bits);
-  return pfss::min(n, domain_size);
+  return PFSS_OK;
 }
 
-// Thread i will own step + (i < slop) + 1 cells.
-template<class T1, class T2>
-std::pair<T1, T1> get_step_and_slop(T1 const num_threads,
-                                    T2 const domain_bits) noexcept {
-  assert(num_threads > 0);
-  assert(domain_bits > 0);
-  constexpr T1 T1_max = pfss::type_max<T1>::value;
-  constexpr int T1_bits = pfss::width_bits<T1>::value;
-  assert(pfss::unsigned_le(domain_bits, T1_bits));
-  if (num_threads == 1) {
-    return std::make_pair(get_mask<T1>(domain_bits), T1(0));
+} // namespace
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_cursor_next(pfss_eval_all_cursor * const cursor,
+                          uint8_t * const ys,
+                          uint32_t const ys_count,
+                          uint32_t const y_size,
+                          pfss_endianness const y_endianness,
+                          uint32_t const thread_count,
+                          uint32_t * const p_ys_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_cursor_next_nolog(cursor,
+                                                   ys,
+                                                   ys_count,
+                                                   y_size,
+                                                   y_endianness,
+                                                   thread_count,
+                                                   p_ys_count);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 cursor,
+                 ys,
+                 ys_count,
+                 y_size,
+                 y_endianness,
+                 thread_count,
+                 p_ys_count);
+    }
   }
-  if (pfss::unsigned_eq(domain_bits, T1_bits)) {
-    return std::make_pair(T1(T1_max / num_threads - T1(1)),
-                          T1(T1_max % num_threads + T1(1)));
+  return ret;
+}
+
+namespace {
+
+pfss_status
+pfss_eval_all_cursor_destroy_nolog(pfss_eval_all_cursor * const cursor) {
+  try {
+    validate_pointer(cursor);
+    delete cursor;
+  } catch (error const & e) {
+    return e.status;
+  } catch (...) {
+    return PFSS_UNKNOWN_ERROR;
   }
-  T1 const domain_size = T1(T1(1) << domain_bits);
-  return std::make_pair(T1(domain_size / num_threads - T1(1)),
-                        T1(domain_size % num_threads));
+  return PFSS_OK;
 }
 
 } // namespace
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_cursor_destroy(pfss_eval_all_cursor * const cursor) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_cursor_destroy_nolog(cursor);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 cursor);
+    }
+  }
+  return ret;
+}
+
 //----------------------------------------------------------------------
 // pfss_eval_all_sum
 //----------------------------------------------------------------------
@@ -1814,51 +5379,58 @@ namespace {
 template<class Y, bool Aligned, bool Reverse>
 void pfss_eval_all_sum_helper_2(pfss_key const * const * const keys,
                                 uint32_t const keys_count,
-                                std::size_t const x_first,
-                                std::size_t const x_last,
-                                uint8_t * const ys) {
+                                std::size_t const range_first,
+                                std::size_t const range_last,
+                                uint8_t * const ys,
+                                eval_scratch & scratch) {
   PFSS_SST_STATIC_ASSERT((std::is_same<Y, std::uint8_t>::value
                       || std::is_same<Y, std::uint16_t>::value
                       || std::is_same<Y, std::uint32_t>::value
                       || std::is_same<Y, std::uint64_t>::value));
   assert(keys != nullptr);
   assert(keys_count > 0);
-  assert(x_first <= x_last);
+  assert(range_first <= range_last);
   assert(ys != nullptr);
-  for (uint32_t i = 0; i != keys_count; ++i) {
-    pfss_key const * const key = keys[i];
-    std::size_t x = x_first;
-    uint_buf_type const x_buf(&x, sizeof(x), system_is_little_endian());
-    uint_buf_iterator<
-        uint_buf_add_eq<uint_buf<void, Y, Aligned, Reverse>>>
-        out(ys + x * sizeof(Y));
-    if (key->header[0] == 0) {
+  std::size_t const tile_size =
+      keys_count == 1 ? 0 : ys_tile_bytes / sizeof(Y);
+  auto const mask = get_mask<Y>(keys[0]->range_bits);
+  std::size_t tile_first = range_first;
+  while (true) {
+    std::size_t const x = tile_first;
+    std::size_t const x_last = get_tile_last(x, range_last, tile_size);
+    for (uint32_t i = 0; i != keys_count; ++i) {
+      pfss_key const * const key = keys[i];
+      uint_buf_iterator<
+          uint_buf_add_eq<uint_buf<void, Y, Aligned, Reverse>>>
+          out(ys + x * sizeof(Y));
+      if (key->header[0] == 0) {
 #define SCHEME_CLASS pfss::bgi1
 #define SCHEME_CLASS_V pfss::bgi1_v
-      PFSS_SWITCH_DB_RB(key->domain_bits,
-                        key->range_bits,
-                        PFSS_EVAL_ALL_TEMPLATE_CODE,
-                        PFSS_EVAL_ALL_STANDARD_CODE);
+        PFSS_SWITCH_DB_RB(key->domain_bits,
+                          key->range_bits,
+                          PFSS_EVAL_ALL_TEMPLATE_CODE,
+                          PFSS_EVAL_ALL_STANDARD_CODE);
 #undef SCHEME_CLASS_V
 #undef SCHEME_CLASS
-    } else {
-      throw error(PFSS_UNKNOWN_ERROR);
+      } else {
+        throw error(PFSS_UNKNOWN_ERROR);
+      }
     }
-  }
-  {
-    std::size_t x = x_first;
-    uint_buf_type const x_buf(&x, sizeof(x), system_is_little_endian());
-    uint_buf_iterator<
-        uint_buf_and_eq<uint_buf<void, Y, Aligned, Reverse>>>
-        out(ys + x * sizeof(Y));
-    auto const mask = get_mask<Y>(keys[0]->range_bits);
-    while (true) {
-      *out++ = mask;
-      if (x == x_last) {
-        break;
+    {
+      uint_buf_iterator<
+          uint_buf_and_eq<uint_buf<void, Y, Aligned, Reverse>>>
+          out(ys + x * sizeof(Y));
+      for (std::size_t j = x; true; ++j) {
+        *out++ = mask;
+        if (j == x_last) {
+          break;
+        }
       }
-      ++x;
     }
+    if (x_last == range_last) {
+      break;
+    }
+    tile_first = x_last + 1;
   }
 }
 
@@ -1868,14 +5440,16 @@ void pfss_eval_all_sum_helper_1(pfss_key const * const * const keys,
                                 std::size_t const x_last,
                                 uint8_t * const ys,
                                 uint32_t const y_size,
-                                bool const y_is_little_endian) {
+                                bool const y_is_little_endian,
+                                eval_scratch & scratch) {
   switch (y_size) {
     case 1: {
       pfss_eval_all_sum_helper_2<std::uint8_t, true, false>(keys,
                                                             keys_count,
                                                             x_first,
                                                             x_last,
-                                                            ys);
+                                                            ys,
+                                                            scratch);
     } break;
 #define C(Y)                                                           \
   case sizeof(Y): {                                                    \
@@ -1888,13 +5462,15 @@ void pfss_eval_all_sum_helper_1(pfss_key const * const * const keys,
                                                   keys_count,          \
                                                   x_first,             \
                                                   x_last,              \
-                                                  ys);                 \
+                                                  ys,                  \
+                                                  scratch);            \
       } else {                                                         \
         pfss_eval_all_sum_helper_2<Y, true, false>(keys,               \
                                                    keys_count,         \
                                                    x_first,            \
                                                    x_last,             \
-                                                   ys);                \
+                                                   ys,                 \
+                                                   scratch);           \
       }                                                                \
     } else {                                                           \
       if (reverse) {                                                   \
@@ -1902,13 +5478,179 @@ void pfss_eval_all_sum_helper_1(pfss_key const * const * const keys,
                                                    keys_count,         \
                                                    x_first,            \
                                                    x_last,             \
-                                                   ys);                \
+                                                   ys,                 \
+                                                   scratch);           \
       } else {                                                         \
         pfss_eval_all_sum_helper_2<Y, false, false>(keys,              \
                                                     keys_count,        \
                                                     x_first,           \
                                                     x_last,            \
-                                                    ys);               \
+                                                    ys,                \
+                                                    scratch);          \
+      }                                                                \
+    }                                                                  \
+  } break
+      C(std::uint16_t);
+      C(std::uint32_t);
+      C(std::uint64_t);
+#undef C
+    default: {
+      throw error(PFSS_UNKNOWN_ERROR);
+    } break;
+  }
+}
+
+//
+// Adds the outputs of the keys from range_first to range_last into the
+// packed array ys, a tile at a time. Each tile is summed in native
+// cells in scratch.packed_tile first, so every element of ys is read
+// and written once per tile instead of once per key.
+//
+
+void pfss_eval_all_sum_packed_helper(pfss_key const * const * const keys,
+                                     uint32_t const keys_count,
+                                     std::size_t const range_first,
+                                     std::size_t const range_last,
+                                     uint8_t * const ys,
+                                     eval_scratch & scratch) {
+  assert(keys != nullptr);
+  assert(keys_count > 0);
+  assert(range_first <= range_last);
+  assert(ys != nullptr);
+  using Y = std::uint64_t;
+  int const range_bits = keys[0]->range_bits;
+  auto const mask = get_mask<Y>(range_bits);
+  std::size_t const tile_size = ys_tile_bytes / sizeof(Y);
+  std::vector<Y> & tile = scratch.packed_tile;
+  if (tile.size() < tile_size) {
+    tile.resize(tile_size);
+  }
+  std::size_t tile_first = range_first;
+  while (true) {
+    std::size_t const x = tile_first;
+    std::size_t const x_last = get_tile_last(x, range_last, tile_size);
+    std::size_t const n = x_last - x + 1;
+    std::fill_n(tile.begin(), n, Y(0));
+    for (uint32_t i = 0; i != keys_count; ++i) {
+      pfss_key const * const key = keys[i];
+      uint_buf_iterator<uint_buf_add_eq<uint_buf<void, Y, true, false>>>
+          out(tile.data());
+      if (key->header[0] == 0) {
+#define SCHEME_CLASS pfss::bgi1
+#define SCHEME_CLASS_V pfss::bgi1_v
+        PFSS_SWITCH_DB_RB(key->domain_bits,
+                          key->range_bits,
+                          PFSS_EVAL_ALL_TEMPLATE_CODE,
+                          PFSS_EVAL_ALL_STANDARD_CODE);
+#undef SCHEME_CLASS_V
+#undef SCHEME_CLASS
+      } else {
+        throw error(PFSS_UNKNOWN_ERROR);
+      }
+    }
+    {
+      // Each element is read before put writes any byte that holds it.
+      packed_writer w(ys, x, range_bits);
+      for (std::size_t j = 0; j != n; ++j) {
+        w.put((get_packed(ys, x + j, range_bits) + tile[j]) & mask);
+      }
+      w.flush();
+    }
+    if (x_last == range_last) {
+      break;
+    }
+    tile_first = x_last + 1;
+  }
+}
+
+// Adds the cells of src into the cells of dst from x_first to x_last,
+// where both hold native Y values.
+template<class Y>
+void pfss_eval_all_sum_add_2(uint8_t * const dst,
+                             uint8_t const * const src,
+                             std::size_t const x_first,
+                             std::size_t const x_last) noexcept {
+  for (std::size_t x = x_first;; ++x) {
+    uint_buf<void, Y, true, false> y(dst + x * sizeof(Y));
+    y += uint_buf<void, Y const, true, false>(src + x * sizeof(Y));
+    if (x == x_last) {
+      break;
+    }
+  }
+}
+
+void pfss_eval_all_sum_add_1(uint8_t * const dst,
+                             uint8_t const * const src,
+                             std::size_t const x_first,
+                             std::size_t const x_last,
+                             uint32_t const y_size) {
+  switch (y_size) {
+#define C(Y)                                                           \
+  case sizeof(Y): {                                                    \
+    pfss_eval_all_sum_add_2<Y>(dst, src, x_first, x_last);             \
+  } break
+    C(std::uint8_t);
+    C(std::uint16_t);
+    C(std::uint32_t);
+    C(std::uint64_t);
+#undef C
+    default: {
+      throw error(PFSS_UNKNOWN_ERROR);
+    } break;
+  }
+}
+
+// Adds the cells of src, which hold native Y values, into the cells of
+// ys from x_first to x_last, reducing them modulo 2^range_bits.
+template<class Y, bool Aligned, bool Reverse>
+void pfss_eval_all_sum_merge_2(uint8_t * const ys,
+                               uint8_t const * const src,
+                               std::size_t const x_first,
+                               std::size_t const x_last,
+                               int const range_bits) noexcept {
+  auto const mask = get_mask<Y>(range_bits);
+  for (std::size_t x = x_first;; ++x) {
+    uint_buf<void, Y, Aligned, Reverse> y(ys + x * sizeof(Y));
+    y += uint_buf<void, Y const, true, false>(src + x * sizeof(Y));
+    y &= mask;
+    if (x == x_last) {
+      break;
+    }
+  }
+}
+
+void pfss_eval_all_sum_merge_1(uint8_t * const ys,
+                               uint8_t const * const src,
+                               std::size_t const x_first,
+                               std::size_t const x_last,
+                               int const range_bits,
+                               uint32_t const y_size,
+                               bool const y_is_little_endian) {
+  switch (y_size) {
+    case 1: {
+      pfss_eval_all_sum_merge_2<std::uint8_t, true, false>(
+          ys, src, x_first, x_last, range_bits);
+    } break;
+#define C(Y)                                                           \
+  case sizeof(Y): {                                                    \
+    bool const aligned = is_aligned<Y>(ys);                            \
+    bool const reverse =                                               \
+        y_is_little_endian != system_is_little_endian();               \
+    if (aligned) {                                                     \
+      if (reverse) {                                                   \
+        pfss_eval_all_sum_merge_2<Y, true, true>(                      \
+            ys, src, x_first, x_last, range_bits);                     \
+      } else {                                                         \
+        pfss_eval_all_sum_merge_2<Y, true, false>(                     \
+            ys, src, x_first, x_last, range_bits);                     \
+      }                                                                \
+    } else {                                                           \
+      if (reverse) {                                                   \
+        pfss_eval_all_sum_merge_2<Y, false, true>(                     \
+            ys, src, x_first, x_last, range_bits);                     \
+      } else {                                                         \
+        pfss_eval_all_sum_merge_2<Y, false, false>(                    \
+            ys, src, x_first, x_last, range_bits);                     \
       }                                                                \
     }                                                                  \
   } break
@@ -1922,76 +5664,126 @@ void pfss_eval_all_sum_helper_1(pfss_key const * const * const keys,
   }
 }
 
-void pfss_eval_all_sum_noval(pfss_key const * const * const keys,
+// When pfss_eval_all_sum splits the keys into blocks, the first block
+// adds into ys and every other block adds into its own copy of ys,
+// which is merged back afterwards. The keys are only split as far as
+// the copies take up at most this many bytes.
+constexpr std::size_t sum_copies_bytes = std::size_t(1) << 25;
+
+//
+// If packed is true, ys is a packed array of range_bits-bit elements
+// and y_size and y_is_little_endian are ignored. The keys are then
+// never split into blocks, and the chunks of the domain, which are made
+// of whole tiles, start on whole bytes of ys.
+//
+
+void pfss_eval_all_sum_noval(pfss_eval_context & context,
+                             pfss_key const * const * const keys,
                              uint32_t const keys_count,
                              uint8_t * const ys,
                              uint32_t const y_size,
                              bool const y_is_little_endian,
-                             uint32_t const thread_count) {
-  int const domain_bits = keys[0]->domain_bits;
-  std::size_t const num_threads =
-      get_num_threads<std::size_t>(thread_count, domain_bits);
-  std::pair<std::size_t, std::size_t> const step_and_slop =
-      get_step_and_slop(num_threads, domain_bits);
-  std::size_t const step = step_and_slop.first;
-  std::size_t const slop = step_and_slop.second;
-
-  std::vector<std::future<void>> futures;
-  futures.reserve(num_threads);
-
-  std::size_t x_first = 0;
-  for (std::size_t i = 0; i != num_threads; ++i) {
-    std::size_t const x_last = x_first + (step + (i < slop));
-    auto future = std::async(std::launch::async, [=] {
-      pfss_eval_all_sum_helper_1(keys,
-                                 keys_count,
-                                 x_first,
-                                 x_last,
-                                 ys,
-                                 y_size,
-                                 y_is_little_endian);
-    });
-    try {
-      futures.push_back(std::move(future));
-    } catch (...) {
-      try {
-        future.get();
-      } catch (...) {
-      }
-      for (std::size_t j = 0; j != i; ++j) {
-        try {
-          futures[j].get();
-        } catch (...) {
-        }
-      }
-      throw;
-    }
-    x_first = x_last + 1;
+                             uint32_t const thread_count,
+                             bool const packed) {
+  int const domain_bits = keys[0]->domain_bits;
+  int const range_bits = keys[0]->range_bits;
+  constexpr int size_bits = pfss::width_bits<std::size_t>::value;
+
+  std::size_t domain_bytes = 0;
+  std::size_t max_key_blocks = 1;
+  if (!packed && unsigned_lt(domain_bits, size_bits)
+      && (std::size_t(1) << domain_bits) <= sum_copies_bytes / y_size) {
+    domain_bytes = (std::size_t(1) << domain_bits) * y_size;
+    max_key_blocks = 1 + sum_copies_bytes / domain_bytes;
   }
-
-  for (std::size_t i = 0; i != num_threads; ++i) {
-    try {
-      futures[i].get();
-    } catch (...) {
-      for (std::size_t j = i + 1; j != num_threads; ++j) {
-        try {
-          futures[j].get();
-        } catch (...) {
+  eval_all_plan const plan = get_eval_all_plan(
+      thread_count,
+      keys_count,
+      domain_bits,
+      get_ys_tile_bits(packed ? sizeof(std::uint64_t) : y_size),
+      max_key_blocks);
+  std::size_t const chunks = plan.chunks();
+  std::vector<std::size_t> const & x_firsts = plan.x_firsts;
+
+  // Copy j holds the sum of key block j + 1 in native byte order.
+  std::size_t const copies_count = plan.key_blocks - 1;
+  std::vector<std::uint64_t> copies_buf(
+      (copies_count * domain_bytes + sizeof(std::uint64_t) - 1)
+      / sizeof(std::uint64_t));
+  uint8_t * const copies = reinterpret_cast<uint8_t *>(copies_buf.data());
+
+  context.run(
+      plan.num_threads,
+      plan.tasks(),
+      [&](std::size_t const t, eval_scratch & scratch) {
+        std::size_t const k = t / chunks;
+        std::size_t const c = t % chunks;
+        std::size_t const key_first = k * plan.key_block_size;
+        uint32_t const n = static_cast<uint32_t>(
+            pfss::min(plan.key_block_size, keys_count - key_first));
+        if (packed) {
+          pfss_eval_all_sum_packed_helper(keys + key_first,
+                                          n,
+                                          x_firsts[c],
+                                          x_firsts[c + 1] - 1,
+                                          ys,
+                                          scratch);
+          return;
         }
-      }
-      throw;
-    }
+        pfss_eval_all_sum_helper_1(
+            keys + key_first,
+            n,
+            x_firsts[c],
+            x_firsts[c + 1] - 1,
+            k == 0 ? ys : copies + (k - 1) * domain_bytes,
+            y_size,
+            k == 0 ? y_is_little_endian : system_is_little_endian(),
+            scratch);
+      });
+
+  // Merge the copies pairwise into copy 0, then copy 0 into ys.
+  for (std::size_t step = 1; step < copies_count; step *= 2) {
+    std::size_t const pairs =
+        (copies_count - step + 2 * step - 1) / (2 * step);
+    context.run(plan.num_threads,
+                pairs * chunks,
+                [&](std::size_t const t, eval_scratch &) {
+                  std::size_t const j = (t / chunks) * 2 * step;
+                  std::size_t const c = t % chunks;
+                  pfss_eval_all_sum_add_1(
+                      copies + j * domain_bytes,
+                      copies + (j + step) * domain_bytes,
+                      x_firsts[c],
+                      x_firsts[c + 1] - 1,
+                      y_size);
+                });
+  }
+  if (copies_count != 0) {
+    context.run(plan.num_threads,
+                chunks,
+                [&](std::size_t const c, eval_scratch &) {
+                  pfss_eval_all_sum_merge_1(ys,
+                                            copies,
+                                            x_firsts[c],
+                                            x_firsts[c + 1] - 1,
+                                            range_bits,
+                                            y_size,
+                                            y_is_little_endian);
+                });
   }
 }
 
 pfss_status
-pfss_eval_all_sum_nolog(pfss_key const * const * const keys,
+pfss_eval_all_sum_nolog(pfss_eval_context * const context,
+                        pfss_key const * const * const keys,
                         uint32_t const keys_count,
                         uint8_t * const ys,
                         uint32_t const y_size,
                         pfss_endianness const y_endianness,
-                        uint32_t const thread_count) noexcept {
+                        uint32_t const thread_count,
+                        bool const packed) noexcept {
   try {
+    validate_pointer(context);
     validate_pointer(keys);
     validate_size(keys_count);
     for (uint32_t i = 0; i != keys_count; ++i) {
@@ -2012,15 +5804,23 @@ pfss_eval_all_sum_nolog(pfss_key const * const * const keys,
       throw error(PFSS_DOMAIN_OVERFLOW);
     }
     validate_pointer(ys);
-    validate_byte_size(y_size, keys[0]->range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
+    bool y_is_little_endian = false;
+    if (packed) {
+      validate_packed(keys[0]->domain_bits, keys[0]->range_bits);
+    } else {
+      validate_byte_size(y_size, keys[0]->range_bits);
+      y_is_little_endian = validate_endianness(y_endianness);
+    }
     validate_size(thread_count);
-    pfss_eval_all_sum_noval(keys,
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    pfss_eval_all_sum_noval(*context,
+                            keys,
                             keys_count,
                             ys,
                             y_size,
                             y_is_little_endian,
-                            thread_count);
+                            thread_count,
+                            packed);
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -2039,12 +5839,52 @@ pfss_status pfss_eval_all_sum(pfss_key const * const * const keys,
                               pfss_endianness const y_endianness,
                               uint32_t const thread_count) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_eval_all_sum_nolog(keys,
+  pfss_eval_context context;
+  auto const ret = pfss_eval_all_sum_nolog(&context,
+                                           keys,
+                                           keys_count,
+                                           ys,
+                                           y_size,
+                                           y_endianness,
+                                           thread_count,
+                                           false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 keys,
+                 keys_count,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_sum_ctx(pfss_eval_context * const context,
+                                  pfss_key const * const * const keys,
+                                  uint32_t const keys_count,
+                                  uint8_t * const ys,
+                                  uint32_t const y_size,
+                                  pfss_endianness const y_endianness,
+                                  uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_sum_nolog(context,
+                                           keys,
                                            keys_count,
                                            ys,
                                            y_size,
                                            y_endianness,
-                                           thread_count);
+                                           thread_count,
+                                           false);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -2054,6 +5894,7 @@ pfss_status pfss_eval_all_sum(pfss_key const * const * const keys,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
+                 context,
                  keys,
                  keys_count,
                  ys,
@@ -2065,6 +5906,78 @@ pfss_status pfss_eval_all_sum(pfss_key const * const * const keys,
   return ret;
 }
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_sum_key_set(pfss_eval_context * const context,
+                          pfss_key_set const * const key_set,
+                          uint8_t * const ys,
+                          uint32_t const y_size,
+                          pfss_endianness const y_endianness,
+                          uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_sum_nolog(context,
+                                           key_set_keys(key_set),
+                                           key_set_keys_count(key_set),
+                                           ys,
+                                           y_size,
+                                           y_endianness,
+                                           thread_count,
+                                           false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key_set,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_sum_packed_ctx(pfss_eval_context * const context,
+                             pfss_key const * const * const keys,
+                             uint32_t const keys_count,
+                             uint8_t * const ys,
+                             uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_sum_nolog(context,
+                                           keys,
+                                           keys_count,
+                                           ys,
+                                           0,
+                                           PFSS_NATIVE_ENDIAN,
+                                           thread_count,
+                                           true);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 keys,
+                 keys_count,
+                 ys,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
 //----------------------------------------------------------------------
 // pfss_eval_all_dot
 //----------------------------------------------------------------------
@@ -2075,38 +5988,48 @@ template<class Y, bool Aligned, bool Reverse>
 void pfss_eval_all_dot_helper_2(
     pfss_key const * const * const keys,
     uint32_t const keys_count,
-    std::size_t const x_first,
-    std::size_t const x_last,
+    std::size_t const range_first,
+    std::size_t const range_last,
     uint8_t const * const ys,
-    std::vector<unsigned long long> & partials) {
+    std::vector<unsigned long long> & partials,
+    eval_scratch & scratch) {
   PFSS_SST_STATIC_ASSERT((std::is_same<Y, std::uint8_t>::value
                       || std::is_same<Y, std::uint16_t>::value
                       || std::is_same<Y, std::uint32_t>::value
                       || std::is_same<Y, std::uint64_t>::value));
   assert(keys != nullptr);
   assert(keys_count > 0);
-  assert(x_first <= x_last);
+  assert(range_first <= range_last);
   assert(ys != nullptr);
-  for (uint32_t i = 0; i != keys_count; ++i) {
-    pfss_key const * const key = keys[i];
-    std::size_t x = x_first;
-    uint_buf_type const x_buf(&x, sizeof(x), system_is_little_endian());
-    uint_buf_iterator<
-        dot_accumulator<unsigned long long,
-                        uint_buf<void, Y const, Aligned, Reverse>>>
-        out(&partials[i], ys + x * sizeof(Y));
-    if (key->header[0] == 0) {
+  std::size_t const tile_size =
+      keys_count == 1 ? 0 : ys_tile_bytes / sizeof(Y);
+  std::size_t tile_first = range_first;
+  while (true) {
+    std::size_t const x = tile_first;
+    std::size_t const x_last = get_tile_last(x, range_last, tile_size);
+    for (uint32_t i = 0; i != keys_count; ++i) {
+      pfss_key const * const key = keys[i];
+      uint_buf_iterator<
+          dot_accumulator<unsigned long long,
+                          uint_buf<void, Y const, Aligned, Reverse>>>
+          out(&partials[i], ys + x * sizeof(Y));
+      if (key->header[0] == 0) {
 #define SCHEME_CLASS pfss::bgi1
 #define SCHEME_CLASS_V pfss::bgi1_v
-      PFSS_SWITCH_DB_RB(key->domain_bits,
-                        key->range_bits,
-                        PFSS_EVAL_ALL_TEMPLATE_CODE,
-                        PFSS_EVAL_ALL_STANDARD_CODE);
+        PFSS_SWITCH_DB_RB(key->domain_bits,
+                          key->range_bits,
+                          PFSS_EVAL_ALL_TEMPLATE_CODE,
+                          PFSS_EVAL_ALL_STANDARD_CODE);
 #undef SCHEME_CLASS_V
 #undef SCHEME_CLASS
-    } else {
-      throw error(PFSS_UNKNOWN_ERROR);
+      } else {
+        throw error(PFSS_UNKNOWN_ERROR);
+      }
+    }
+    if (x_last == range_last) {
+      break;
     }
+    tile_first = x_last + 1;
   }
 }
 
@@ -2118,7 +6041,8 @@ void pfss_eval_all_dot_helper_1(
     uint8_t const * const ys,
     uint32_t const y_size,
     bool const y_is_little_endian,
-    std::vector<unsigned long long> & partials) {
+    std::vector<unsigned long long> & partials,
+    eval_scratch & scratch) {
   switch (y_size) {
     case 1: {
       pfss_eval_all_dot_helper_2<std::uint8_t, true, false>(keys,
@@ -2126,7 +6050,8 @@ void pfss_eval_all_dot_helper_1(
                                                             x_first,
                                                             x_last,
                                                             ys,
-                                                            partials);
+                                                            partials,
+                                                            scratch);
     } break;
 #define C(Y)                                                           \
   case sizeof(Y): {                                                    \
@@ -2140,14 +6065,16 @@ void pfss_eval_all_dot_helper_1(
                                                   x_first,             \
                                                   x_last,              \
                                                   ys,                  \
-                                                  partials);           \
+                                                  partials,            \
+                                                  scratch);            \
       } else {                                                         \
         pfss_eval_all_dot_helper_2<Y, true, false>(keys,               \
                                                    keys_count,         \
                                                    x_first,            \
                                                    x_last,             \
                                                    ys,                 \
-                                                   partials);          \
+                                                   partials,           \
+                                                   scratch);           \
       }                                                                \
     } else {                                                           \
       if (reverse) {                                                   \
@@ -2156,14 +6083,16 @@ void pfss_eval_all_dot_helper_1(
                                                    x_first,            \
                                                    x_last,             \
                                                    ys,                 \
-                                                   partials);          \
+                                                   partials,           \
+                                                   scratch);           \
       } else {                                                         \
         pfss_eval_all_dot_helper_2<Y, false, false>(keys,              \
                                                     keys_count,        \
                                                     x_first,           \
                                                     x_last,            \
                                                     ys,                \
-                                                    partials);         \
+                                                    partials,          \
+                                                    scratch);          \
       }                                                                \
     }                                                                  \
   } break
@@ -2177,7 +6106,72 @@ void pfss_eval_all_dot_helper_1(
   }
 }
 
-void pfss_eval_all_dot_noval(pfss_key const * const * const keys,
+//
+// Adds the dot products of the keys with the packed array ys from
+// range_first to range_last into partials, a tile at a time. Each tile
+// of ys is unpacked into native cells in scratch.packed_tile first.
+//
+
+void pfss_eval_all_dot_packed_helper(
+    pfss_key const * const * const keys,
+    uint32_t const keys_count,
+    std::size_t const range_first,
+    std::size_t const range_last,
+    uint8_t const * const ys,
+    std::vector<unsigned long long> & partials,
+    eval_scratch & scratch) {
+  assert(keys != nullptr);
+  assert(keys_count > 0);
+  assert(range_first <= range_last);
+  assert(ys != nullptr);
+  using Y = std::uint64_t;
+  int const range_bits = keys[0]->range_bits;
+  std::size_t const tile_size = ys_tile_bytes / sizeof(Y);
+  std::vector<Y> & tile = scratch.packed_tile;
+  if (tile.size() < tile_size) {
+    tile.resize(tile_size);
+  }
+  std::size_t tile_first = range_first;
+  while (true) {
+    std::size_t const x = tile_first;
+    std::size_t const x_last = get_tile_last(x, range_last, tile_size);
+    std::size_t const n = x_last - x + 1;
+    for (std::size_t j = 0; j != n; ++j) {
+      tile[j] = get_packed(ys, x + j, range_bits);
+    }
+    for (uint32_t i = 0; i != keys_count; ++i) {
+      pfss_key const * const key = keys[i];
+      uint_buf_iterator<
+          dot_accumulator<unsigned long long,
+                          uint_buf<void, Y const, true, false>>>
+          out(&partials[i], tile.data());
+      if (key->header[0] == 0) {
+#define SCHEME_CLASS pfss::bgi1
+#define SCHEME_CLASS_V pfss::bgi1_v
+        PFSS_SWITCH_DB_RB(key->domain_bits,
+                          key->range_bits,
+                          PFSS_EVAL_ALL_TEMPLATE_CODE,
+                          PFSS_EVAL_ALL_STANDARD_CODE);
+#undef SCHEME_CLASS_V
+#undef SCHEME_CLASS
+      } else {
+        throw error(PFSS_UNKNOWN_ERROR);
+      }
+    }
+    if (x_last == range_last) {
+      break;
+    }
+    tile_first = x_last + 1;
+  }
+}
+
+//
+// If packed is true, ys is a packed array of range_bits-bit elements
+// and y_size and y_is_little_endian are ignored.
+//
+
+void pfss_eval_all_dot_noval(pfss_eval_context & context,
+                             pfss_key const * const * const keys,
                              uint32_t const keys_count,
                              uint8_t const * const ys,
                              uint32_t const y_size,
@@ -2185,84 +6179,78 @@ void pfss_eval_all_dot_noval(pfss_key const * const * const keys,
                              uint8_t * const zs,
                              uint32_t const z_size,
                              bool const z_is_little_endian,
-                             uint32_t const thread_count) {
+                             uint32_t const thread_count,
+                             bool const packed) {
   int const domain_bits = keys[0]->domain_bits;
   int const range_bits = keys[0]->range_bits;
 
-  std::size_t const num_threads =
-      get_num_threads<std::size_t>(thread_count, domain_bits);
-  std::pair<std::size_t, std::size_t> const step_and_slop =
-      get_step_and_slop(num_threads, domain_bits);
-  std::size_t const step = step_and_slop.first;
-  std::size_t const slop = step_and_slop.second;
-
-  std::vector<std::future<void>> futures;
-  futures.reserve(num_threads);
-
-  std::vector<std::vector<unsigned long long>> partials(
-      num_threads,
-      std::vector<unsigned long long>(keys_count));
-
-  std::size_t x_first = 0;
-  for (std::size_t i = 0; i != num_threads; ++i) {
-    std::size_t const x_last = x_first + (step + (i < slop));
-    auto future = std::async(std::launch::async, [=, &partials] {
-      pfss_eval_all_dot_helper_1(keys,
-                                 keys_count,
-                                 x_first,
-                                 x_last,
-                                 ys,
-                                 y_size,
-                                 y_is_little_endian,
-                                 partials[i]);
-    });
-    try {
-      futures.push_back(std::move(future));
-    } catch (...) {
-      try {
-        future.get();
-      } catch (...) {
-      }
-      for (std::size_t j = 0; j != i; ++j) {
-        try {
-          futures[j].get();
-        } catch (...) {
-        }
-      }
-      throw;
-    }
-    x_first = x_last + 1;
+  eval_all_plan const plan = get_eval_all_plan(
+      thread_count,
+      keys_count,
+      domain_bits,
+      get_ys_tile_bits(packed ? sizeof(std::uint64_t) : y_size),
+      keys_count);
+  std::size_t const chunks = plan.chunks();
+  std::vector<std::size_t> const & x_firsts = plan.x_firsts;
+
+  // Each task sums into partials that cover only its own key block and
+  // then adds them into the totals, so the memory that the partials
+  // take up does not grow with keys_count times the thread count.
+  std::unique_ptr<std::atomic<unsigned long long>[]> const totals(
+      new std::atomic<unsigned long long>[keys_count]);
+  for (decltype(+keys_count) j = 0; j < keys_count; ++j) {
+    totals[j].store(0, std::memory_order_relaxed);
   }
 
-  for (std::size_t i = 0; i != num_threads; ++i) {
-    try {
-      futures[i].get();
-    } catch (...) {
-      for (std::size_t j = i + 1; j != num_threads; ++j) {
-        try {
-          futures[j].get();
-        } catch (...) {
+  context.run(
+      plan.num_threads,
+      plan.tasks(),
+      [&](std::size_t const t, eval_scratch & scratch) {
+        std::size_t const k = t / chunks;
+        std::size_t const c = t % chunks;
+        std::size_t const key_first = k * plan.key_block_size;
+        uint32_t const n = static_cast<uint32_t>(
+            pfss::min(plan.key_block_size, keys_count - key_first));
+        std::vector<unsigned long long> & partials =
+            scratch.dot_partials;
+        partials.assign(n, 0);
+        if (packed) {
+          pfss_eval_all_dot_packed_helper(keys + key_first,
+                                          n,
+                                          x_firsts[c],
+                                          x_firsts[c + 1] - 1,
+                                          ys,
+                                          partials,
+                                          scratch);
+        } else {
+          pfss_eval_all_dot_helper_1(keys + key_first,
+                                     n,
+                                     x_firsts[c],
+                                     x_firsts[c + 1] - 1,
+                                     ys,
+                                     y_size,
+                                     y_is_little_endian,
+                                     partials,
+                                     scratch);
         }
-      }
-      throw;
-    }
-  }
+        for (uint32_t j = 0; j != n; ++j) {
+          totals[key_first + j].fetch_add(partials[j],
+                                          std::memory_order_relaxed);
+        }
+      });
 
-  for (decltype(+num_threads) i = 1; i < num_threads; ++i) {
-    for (decltype(+keys_count) j = 0; j < keys_count; ++j) {
-      partials[0][j] += partials[i][j];
-    }
-  }
   unsigned char * z = zs;
   for (decltype(+keys_count) j = 0; j < keys_count; ++j) {
     uint_buf_type z_buf(z, z_size, z_is_little_endian);
-    z_buf = partials[0][j] & get_mask<unsigned long long>(range_bits);
+    z_buf = totals[j].load(std::memory_order_relaxed)
+            & get_mask<unsigned long long>(range_bits);
     z += z_size;
   }
 }
 
 pfss_status
-pfss_eval_all_dot_nolog(pfss_key const * const * const keys,
+pfss_eval_all_dot_nolog(pfss_eval_context * const context,
+                        pfss_key const * const * const keys,
                         uint32_t const keys_count,
                         uint8_t const * const ys,
                         uint32_t const y_size,
@@ -2270,8 +6258,10 @@ pfss_eval_all_dot_nolog(pfss_key const * const * const keys,
                         uint8_t * const zs,
                         uint32_t const z_size,
                         pfss_endianness const z_endianness,
-                        uint32_t const thread_count) noexcept {
+                        uint32_t const thread_count,
+                        bool const packed) noexcept {
   try {
+    validate_pointer(context);
     validate_pointer(keys);
     validate_size(keys_count);
     for (uint32_t i = 0; i != keys_count; ++i) {
@@ -2292,13 +6282,20 @@ pfss_eval_all_dot_nolog(pfss_key const * const * const keys,
       throw error(PFSS_DOMAIN_OVERFLOW);
     }
     validate_pointer(ys);
-    validate_byte_size(y_size, keys[0]->range_bits);
-    bool const y_is_little_endian = validate_endianness(y_endianness);
+    bool y_is_little_endian = false;
+    if (packed) {
+      validate_packed(keys[0]->domain_bits, keys[0]->range_bits);
+    } else {
+      validate_byte_size(y_size, keys[0]->range_bits);
+      y_is_little_endian = validate_endianness(y_endianness);
+    }
     validate_pointer(zs);
     validate_byte_size(z_size, keys[0]->range_bits);
     bool const z_is_little_endian = validate_endianness(z_endianness);
     validate_size(thread_count);
-    pfss_eval_all_dot_noval(keys,
+    std::lock_guard<std::mutex> const lock(context->mutex);
+    pfss_eval_all_dot_noval(*context,
+                            keys,
                             keys_count,
                             ys,
                             y_size,
@@ -2306,7 +6303,8 @@ pfss_eval_all_dot_nolog(pfss_key const * const * const keys,
                             zs,
                             z_size,
                             z_is_little_endian,
-                            thread_count);
+                            thread_count,
+                            packed);
   } catch (error const & e) {
     return e.status;
   } catch (...) {
@@ -2328,7 +6326,55 @@ pfss_status pfss_eval_all_dot(pfss_key const * const * const keys,
                               pfss_endianness const z_endianness,
                               uint32_t const thread_count) {
   pre_call_info_t pre_call_info;
-  auto const ret = pfss_eval_all_dot_nolog(keys,
+  pfss_eval_context context;
+  auto const ret = pfss_eval_all_dot_nolog(&context,
+                                           keys,
+                                           keys_count,
+                                           ys,
+                                           y_size,
+                                           y_endianness,
+                                           zs,
+                                           z_size,
+                                           z_endianness,
+                                           thread_count,
+                                           false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 keys,
+                 keys_count,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 zs,
+                 z_size,
+                 z_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status pfss_eval_all_dot_ctx(pfss_eval_context * const context,
+                                  pfss_key const * const * const keys,
+                                  uint32_t const keys_count,
+                                  uint8_t const * const ys,
+                                  uint32_t const y_size,
+                                  pfss_endianness const y_endianness,
+                                  uint8_t * const zs,
+                                  uint32_t const z_size,
+                                  pfss_endianness const z_endianness,
+                                  uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_dot_nolog(context,
+                                           keys,
                                            keys_count,
                                            ys,
                                            y_size,
@@ -2336,7 +6382,8 @@ pfss_status pfss_eval_all_dot(pfss_key const * const * const keys,
                                            zs,
                                            z_size,
                                            z_endianness,
-                                           thread_count);
+                                           thread_count,
+                                           false);
   post_call_info_t post_call_info;
   if (PFSS_WITH_LOGGING) {
     FILE * const log_file = g_log_file.load();
@@ -2346,6 +6393,7 @@ pfss_status pfss_eval_all_dot(pfss_key const * const * const keys,
                  post_call_info,
                  __func__,
                  boxed_status(ret),
+                 context,
                  keys,
                  keys_count,
                  ys,
@@ -2360,4 +6408,119 @@ pfss_status pfss_eval_all_dot(pfss_key const * const * const keys,
   return ret;
 }
 
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_dot_key_set(pfss_eval_context * const context,
+                          pfss_key_set const * const key_set,
+                          uint8_t const * const ys,
+                          uint32_t const y_size,
+                          pfss_endianness const y_endianness,
+                          uint8_t * const zs,
+                          uint32_t const z_size,
+                          pfss_endianness const z_endianness,
+                          uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_dot_nolog(context,
+                                           key_set_keys(key_set),
+                                           key_set_keys_count(key_set),
+                                           ys,
+                                           y_size,
+                                           y_endianness,
+                                           zs,
+                                           z_size,
+                                           z_endianness,
+                                           thread_count,
+                                           false);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 key_set,
+                 ys,
+                 y_size,
+                 y_endianness,
+                 zs,
+                 z_size,
+                 z_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+PFSS_PUBLIC_C_FUNCTION
+pfss_status
+pfss_eval_all_dot_packed_ctx(pfss_eval_context * const context,
+                             pfss_key const * const * const keys,
+                             uint32_t const keys_count,
+                             uint8_t const * const ys,
+                             uint8_t * const zs,
+                             uint32_t const z_size,
+                             pfss_endianness const z_endianness,
+                             uint32_t const thread_count) {
+  pre_call_info_t pre_call_info;
+  auto const ret = pfss_eval_all_dot_nolog(context,
+                                           keys,
+                                           keys_count,
+                                           ys,
+                                           0,
+                                           PFSS_NATIVE_ENDIAN,
+                                           zs,
+                                           z_size,
+                                           z_endianness,
+                                           thread_count,
+                                           true);
+  post_call_info_t post_call_info;
+  if (PFSS_WITH_LOGGING) {
+    FILE * const log_file = g_log_file.load();
+    if (log_file != nullptr) {
+      print_call(log_file,
+                 pre_call_info,
+                 post_call_info,
+                 __func__,
+                 boxed_status(ret),
+                 context,
+                 keys,
+                 keys_count,
+                 ys,
+                 zs,
+                 z_size,
+                 z_endianness,
+                 thread_count);
+    }
+  }
+  return ret;
+}
+
+//----------------------------------------------------------------------
+// key_ops
+//----------------------------------------------------------------------
+
+namespace {
+
+template<class Scheme>
+key_ops const * get_key_ops() noexcept {
+  static key_ops const ops = {
+      &destroy_key_op<Scheme>,
+      &destroy_key_set_op<Scheme>,
+      &eval_op<Scheme>,
+      &map_eval_op<Scheme>,
+      &map_eval_sorted_op<Scheme>,
+      &map_eval_keys_op<Scheme>,
+      &map_eval_reduce_sum_op<Scheme>,
+      &eval_all_op<Scheme>,
+      &eval_all_packed_op<Scheme>,
+      &eval_range_op<Scheme>,
+  };
+  return &ops;
+}
+
+} // namespace
+
 //----------------------------------------------------------------------
@@ -164,7 +164,40 @@ struct tester final {
     TEST_VECTOR(nist_sp_800_38a_f112);
     TEST_VECTOR(nist_sp_800_38a_f113);
     TEST_VECTOR(nist_sp_800_38a_f114);
-    
+
+    // The NIST SP 800-38A blocks share a key, so they can also go
+    // through the batched operator in place. Repeating them out to 29
+    // blocks covers every group size that the batched paths use,
+    // including a partial group at the end.
+    {
+      RandPerm p(nist_sp_800_38a_f111_key.data());
+      mimic const * const plaintexts[] = {
+          &nist_sp_800_38a_f111_plaintext,
+          &nist_sp_800_38a_f112_plaintext,
+          &nist_sp_800_38a_f113_plaintext,
+          &nist_sp_800_38a_f114_plaintext,
+      };
+      mimic const * const outputs[] = {
+          &nist_sp_800_38a_f111_output,
+          &nist_sp_800_38a_f112_output,
+          &nist_sp_800_38a_f113_output,
+          &nist_sp_800_38a_f114_output,
+      };
+      std::array<Block, 29> bs;
+      for (std::size_t i = 0; i != bs.size(); ++i) {
+        bs[i].parse(plaintexts[i % 4]->cbegin());
+      }
+      p(bs.data(), bs.data(), bs.size());
+      for (std::size_t i = 0; i != bs.size(); ++i) {
+        bs[i].serialize(m1.begin());
+        if (m1 != *outputs[i % 4]) {
+          throw fail(name
+                     + " batch failed: returned output does not match"
+                       " expected output");
+        }
+      }
+    }
+
     std::cout << "pass: " << name << std::endl;
   }
 };
@@ -223,6 +256,30 @@ int main() {
     SKIP((pfss::uint8x16_block), (pfss::arm_crypto_aes_128_rand_perm));
 #endif
 
+    // Without PFSS_WITH_VAES, vaes_512_rand_perm runs on emulated lanes,
+    // which must produce exactly the same output.
+#if PFSS_HAVE_UINT64_T
+    TEST(
+        (pfss::chunked_block<std::uint64_t, 2>),
+        (pfss::vaes_512_rand_perm<
+            pfss::chunked_block<std::uint64_t, 2>>));
+#else
+    SKIP(
+        (pfss::chunked_block<std::uint64_t, 2>),
+        (pfss::vaes_512_rand_perm<
+            pfss::chunked_block<std::uint64_t, 2>>));
+#endif
+
+#if PFSS_WITH_SSE2
+    TEST(
+        (pfss::m128i_block),
+        (pfss::vaes_512_rand_perm<pfss::m128i_block>));
+#else
+    SKIP(
+        (pfss::m128i_block),
+        (pfss::vaes_512_rand_perm<pfss::m128i_block>));
+#endif
+
   } catch (fail const & e) {
     try {
       std::cout << e.what() << std::endl;
@@ -54,6 +54,22 @@ int main() {
         }
       }
     }
+
+    // compare prepared cw's, which should be rebuilt by parse
+    for (size_t i = 0; i != t.keys[0].pcw.size(); ++i) {
+      for (size_t k = 0; k < 2; ++k) {
+        auto const & a = t.deserialized_key0.pcw[i].scw[k];
+        auto const & b = t.keys[0].pcw[i].scw[k];
+        for (size_t j = 0; j != static_cast<std::size_t>(b.size()); ++j) {
+          if (a[j] != b[j]) {
+            exit_status = TEST_EXIT_FAIL;
+          }
+        }
+        if (b.get_msb() != t.keys[0].cw[i].tcw[k]) {
+          exit_status = TEST_EXIT_FAIL;
+        }
+      }
+    }
   }
 
   return exit_status;
@@ -0,0 +1,101 @@
+//
+// For the copyright information for this file, please search up the
+// directory tree for the first COPYING file.
+//
+
+#include <TEST_EXIT.h>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pfss/common.h>
+
+using namespace pfss;
+
+int main() {
+#if PFSS_WITH_CPU_DISPATCH
+
+  // The PFSS_AES_BACKEND override is read at first use, which has not
+  // happened yet in this process.
+#if PFSS_WITH_POSIX
+  if (::setenv("PFSS_AES_BACKEND", "portable", 1) != 0) {
+    return TEST_EXIT_ERROR;
+  }
+  if (std::strcmp(get_aes_128_backend().name, "portable") != 0) {
+    std::cout << "PFSS_AES_BACKEND was ignored" << std::endl;
+    return TEST_EXIT_FAIL;
+  }
+#endif
+
+  // FIPS 197 Appendix C.1, to check the reference cipher itself.
+  {
+    std::array<unsigned char, 16> key;
+    std::array<unsigned char, 16> plaintext;
+    for (int i = 0; i != 16; ++i) {
+      key[i] = static_cast<unsigned char>(i);
+      plaintext[i] = static_cast<unsigned char>(i * 0x11);
+    }
+    std::array<unsigned char, 16> const output = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+        0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+    };
+    std::array<unsigned char, 176> rkeys;
+    fips197::KeyExpansion<4>(key.cbegin(), rkeys.begin());
+    std::array<unsigned char, 16> ciphertext;
+    fips197::Cipher<4>(plaintext.cbegin(),
+                       ciphertext.begin(),
+                       rkeys.cbegin());
+    if (ciphertext != output) {
+      std::cout << "fips197::Cipher failed" << std::endl;
+      return TEST_EXIT_FAIL;
+    }
+  }
+
+  // Every usable backend must match the reference cipher bit for bit,
+  // in place, on enough blocks to reach its widest group and its tail.
+  constexpr std::size_t n = 29;
+  std::array<m128i_block, n> in;
+  std::array<m128i_block, n> want;
+  for (std::size_t i = 0; i != n; ++i) {
+    for (unsigned int j = 0; j != 16; ++j) {
+      in[i][j] = static_cast<unsigned char>(i * 16 + j * 7 + 1);
+    }
+    fips197::Cipher<4>(&in[i][0], &want[i][0], fixed_aes_128_rkeys);
+  }
+  cpu_features const f = get_cpu_features();
+  for (auto b = get_aes_128_backends(); b->name != nullptr; ++b) {
+    if (!b->usable(f)) {
+      std::cout << "skip: " << b->name << std::endl;
+      if (find_aes_128_backend(b->name) != nullptr) {
+        return TEST_EXIT_FAIL;
+      }
+      continue;
+    }
+    std::array<m128i_block, n> got = in;
+    b->encrypt(got.data(), got.data(), n);
+    if (std::memcmp(&got, &want, sizeof(got)) != 0) {
+      std::cout << "fail: " << b->name << std::endl;
+      return TEST_EXIT_FAIL;
+    }
+    if (find_aes_128_backend(b->name) != b) {
+      return TEST_EXIT_FAIL;
+    }
+    std::cout << "pass: " << b->name << std::endl;
+  }
+  if (find_aes_128_backend("no-such-backend") != nullptr) {
+    return TEST_EXIT_FAIL;
+  }
+
+  fixed_dispatch_aes_128_rand_perm const p;
+  m128i_block const y = p(in[n - 1]);
+  if (std::memcmp(&y, &want[n - 1], sizeof(y)) != 0) {
+    return TEST_EXIT_FAIL;
+  }
+
+  return TEST_EXIT_PASS;
+
+#else
+  return TEST_EXIT_SKIP;
+#endif
+}
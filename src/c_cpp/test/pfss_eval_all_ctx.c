@@ -0,0 +1,99 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Expands both keys over the whole domain through one context, going
+ * from a larger domain to a smaller one and back so that the scratch
+ * buffers are reused at different sizes, and with different thread
+ * counts so that the pool is reused too. The two grids must sum to the
+ * point function.
+ */
+
+static int test1(pfss_eval_context * const context,
+                 uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const thread_count) {
+  uint32_t * ys1 = NULL;
+  uint32_t * ys2 = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys1 = malloc(((size_t)1 << domain_bits) * sizeof(*ys1));
+  ys2 = malloc(((size_t)1 << domain_bits) * sizeof(*ys2));
+  if (ys1 == NULL || ys2 == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint8_t const xp = 0;
+    pfss_status s = pfss_eval_all_ctx(context,
+                                      key1,
+                                      &xp,
+                                      0,
+                                      PFSS_NATIVE_ENDIAN,
+                                      (uint8_t *)ys1,
+                                      sizeof(*ys1),
+                                      PFSS_NATIVE_ENDIAN,
+                                      thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_eval_all_ctx(context,
+                            key2,
+                            &xp,
+                            0,
+                            PFSS_NATIVE_ENDIAN,
+                            (uint8_t *)ys2,
+                            sizeof(*ys2),
+                            PFSS_NATIVE_ENDIAN,
+                            thread_count);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t const mask = (uint32_t)(((uint64_t)1 << range_bits) - 1);
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      uint32_t const y = x == domain_value ? range_value : 0;
+      if (((ys1[x] + ys2[x]) & mask) != y) {
+        fprintf(stderr, "pfss_eval_all_ctx got a wrong answer\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(ys2);
+  free(ys1);
+  goto cleanup;
+}
+
+int main(void) {
+  pfss_eval_context * context;
+  int s = TEST_EXIT_PASS;
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    return TEST_EXIT_ERROR;
+  }
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 16, 32, 12345, 67890, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 5, 8, 17, 200, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 14, 16, 16383, 4321, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 16, 32, 0, 1, 8));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 14, 16, 16383, 4321, 1));
+  if (pfss_eval_context_destroy(context) != PFSS_OK) {
+    s = (s != TEST_EXIT_PASS ? s : TEST_EXIT_ERROR);
+  }
+  return s;
+}
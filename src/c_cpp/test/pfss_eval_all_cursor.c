@@ -0,0 +1,183 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Walks a cursor over the 2^(db - xp_bits) domain elements that start
+ * at xp * 2^(db - xp_bits) in chunks of at most chunk results on
+ * thread_count threads. Checks that every chunk has the expected size,
+ * that the cursor then keeps returning empty chunks, and that the
+ * results agree with pfss_eval_range over the same elements and, when
+ * xp_bits is zero, with pfss_eval_all.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const xp_bits,
+                 uint64_t const xp,
+                 uint32_t const chunk,
+                 uint32_t const thread_count) {
+  uint64_t const n = (uint64_t)1 << (db - xp_bits);
+  uint64_t const x_lo = db - xp_bits == 64 ? 0 : xp << (db - xp_bits);
+  uint64_t const x_hi = x_lo + (n - 1);
+  pfss_eval_all_cursor * cursor = NULL;
+  uint32_t * ys1 = NULL;
+  uint32_t * ys2 = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys1 = malloc((size_t)n * sizeof(*ys1));
+  ys2 = malloc((size_t)n * sizeof(*ys2));
+  if (ys1 == NULL || ys2 == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  if (pfss_eval_all_cursor_create(&cursor,
+                                  key1,
+                                  (uint8_t const *)&xp,
+                                  xp_bits,
+                                  PFSS_NATIVE_ENDIAN)
+      != PFSS_OK) {
+    fprintf(stderr, "pfss_eval_all_cursor_create failed\n");
+    cursor = NULL;
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t count;
+    if (pfss_eval_all_cursor_next(cursor,
+                                  (uint8_t *)ys1,
+                                  0,
+                                  sizeof(*ys1),
+                                  PFSS_NATIVE_ENDIAN,
+                                  thread_count,
+                                  &count)
+        != PFSS_INVALID_ARGUMENT) {
+      fprintf(stderr, "pfss_eval_all_cursor_next accepted ys_count=0\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+  {
+    uint64_t done = 0;
+    int k;
+    for (k = 0; k != 3;) {
+      uint32_t count;
+      uint64_t const left = n - done;
+      uint64_t const want = left < chunk ? left : chunk;
+      pfss_status const s =
+          pfss_eval_all_cursor_next(cursor,
+                                    (uint8_t *)(ys1 + (left == 0 ? 0 : done)),
+                                    chunk,
+                                    sizeof(*ys1),
+                                    PFSS_NATIVE_ENDIAN,
+                                    thread_count,
+                                    &count);
+      if (s != PFSS_OK) {
+        fprintf(stderr,
+                "pfss_eval_all_cursor_next failed: %s\n",
+                pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+      if (count != want) {
+        fprintf(stderr,
+                "pfss_eval_all_cursor_next returned %lu results instead "
+                "of %lu (db=%lu)\n",
+                (unsigned long)count,
+                (unsigned long)want,
+                (unsigned long)db);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+      done += count;
+      if (count == 0) {
+        ++k;
+      }
+    }
+  }
+  {
+    pfss_status s = pfss_eval_range(key1,
+                                    (uint8_t const *)&x_lo,
+                                    (uint8_t const *)&x_hi,
+                                    sizeof(x_lo),
+                                    PFSS_NATIVE_ENDIAN,
+                                    (uint8_t *)ys2,
+                                    sizeof(*ys2),
+                                    PFSS_NATIVE_ENDIAN,
+                                    1);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_range failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    if (memcmp(ys1, ys2, (size_t)n * sizeof(*ys1)) != 0) {
+      fprintf(stderr,
+              "pfss_eval_all_cursor_next disagrees with pfss_eval_range "
+              "(db=%lu, xp_bits=%lu, chunk=%lu)\n",
+              (unsigned long)db,
+              (unsigned long)xp_bits,
+              (unsigned long)chunk);
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+    if (xp_bits == 0) {
+      s = pfss_eval_all(key1,
+                        (uint8_t const *)&xp,
+                        0,
+                        PFSS_NATIVE_ENDIAN,
+                        (uint8_t *)ys2,
+                        sizeof(*ys2),
+                        PFSS_NATIVE_ENDIAN);
+      if (s != PFSS_OK) {
+        fprintf(stderr,
+                "pfss_eval_all failed: %s\n",
+                pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+      if (memcmp(ys1, ys2, (size_t)n * sizeof(*ys1)) != 0) {
+        fprintf(stderr,
+                "pfss_eval_all_cursor_next disagrees with pfss_eval_all "
+                "(db=%lu, chunk=%lu)\n",
+                (unsigned long)db,
+                (unsigned long)chunk);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  if (cursor != NULL) {
+    pfss_eval_all_cursor_destroy(cursor);
+  }
+  free(ys1);
+  free(ys2);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 200, 77, 0, 0, 1, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 200, 77, 0, 0, 7, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 200, 77, 0, 0, 1000, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 16, 4000, 999, 0, 0, 4096, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 16, 4000, 999, 0, 0, 1000, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 16, 4000, 999, 4, 0, 333, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 1, 12345, 1, 6, 3, 5000, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(9, 13, 300, 4321, 0, 0, 100, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(64, 32, 99, 31337, 52, 0, 999, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(64, 8, 99, 200, 50, 12345, 4096, 1));
+  return s;
+}
@@ -0,0 +1,162 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Takes the dot product of both keys with a vector whose elements are
+ * their own indices, through one context with changing thread counts.
+ * The two results must sum to range_value * domain_value.
+ */
+
+static int test1(pfss_eval_context * const context,
+                 uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const thread_count) {
+  uint32_t * ys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = malloc(((size_t)1 << domain_bits) * sizeof(*ys));
+  if (ys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      ys[x] = x;
+    }
+  }
+  {
+    pfss_key const * const keys[2] = {key1, key2};
+    uint32_t zs[2];
+    pfss_status const s = pfss_eval_all_dot_ctx(context,
+                                                keys,
+                                                2,
+                                                (uint8_t const *)ys,
+                                                sizeof(*ys),
+                                                PFSS_NATIVE_ENDIAN,
+                                                (uint8_t *)zs,
+                                                sizeof(*zs),
+                                                PFSS_NATIVE_ENDIAN,
+                                                thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_dot_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    if ((uint32_t)(zs[0] + zs[1]) != (uint32_t)(range_value * domain_value)) {
+      fprintf(stderr, "pfss_eval_all_dot_ctx got a wrong answer\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  free(ys);
+  goto cleanup;
+}
+
+/*
+ * Takes the dot products of keys_count / 2 copies of both keys over a
+ * small domain, so that the keys have to be split across the threads
+ * as well as the domain. Each pair of results must sum to
+ * range_value * domain_value.
+ */
+
+static int test2(pfss_eval_context * const context,
+                 uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const keys_count,
+                 uint32_t const thread_count) {
+  uint32_t * ys = NULL;
+  uint32_t * zs = NULL;
+  pfss_key const ** keys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = malloc(((size_t)1 << domain_bits) * sizeof(*ys));
+  zs = malloc(keys_count * sizeof(*zs));
+  keys = malloc(keys_count * sizeof(*keys));
+  if (ys == NULL || zs == NULL || keys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      ys[x] = x;
+    }
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      keys[i] = i % 2 == 0 ? key1 : key2;
+    }
+  }
+  {
+    pfss_status const s = pfss_eval_all_dot_ctx(context,
+                                                keys,
+                                                keys_count,
+                                                (uint8_t const *)ys,
+                                                sizeof(*ys),
+                                                PFSS_NATIVE_ENDIAN,
+                                                (uint8_t *)zs,
+                                                sizeof(*zs),
+                                                PFSS_NATIVE_ENDIAN,
+                                                thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_dot_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t const mask = (uint32_t)(((uint64_t)1 << range_bits) - 1);
+    uint32_t i;
+    for (i = 0; i != keys_count; i += 2) {
+      if (((zs[i] + zs[i + 1]) & mask)
+          != ((range_value * domain_value) & mask)) {
+        fprintf(stderr, "pfss_eval_all_dot_ctx got a wrong answer\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(keys);
+  free(zs);
+  free(ys);
+  goto cleanup;
+}
+
+int main(void) {
+  pfss_eval_context * context;
+  int s = TEST_EXIT_PASS;
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    return TEST_EXIT_ERROR;
+  }
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 16, 32, 12345, 67890, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 12, 32, 2748, 12345, 8));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 14, 32, 16000, 5, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 18, 32, 200000, 7, 3));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 4, 32, 9, 4321, 200, 8));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 10, 16, 1, 77, 34, 5));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 2, 8, 3, 200, 6, 64));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 17, 32, 99, 5, 10, 4));
+  if (pfss_eval_context_destroy(context) != PFSS_OK) {
+    s = (s != TEST_EXIT_PASS ? s : TEST_EXIT_ERROR);
+  }
+  return s;
+}
@@ -0,0 +1,108 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Expands key1 over the part of the domain that starts with the
+ * xp_bits bits of xp on thread_count threads, and checks every element
+ * against pfss_eval. The elements outside of that part must be left
+ * alone.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const xp,
+                 uint32_t const xp_bits,
+                 uint32_t const thread_count) {
+  uint32_t * ys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = malloc(((size_t)1 << domain_bits) * sizeof(*ys));
+  if (ys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      ys[x] = 0xDEADBEEF;
+    }
+  }
+  {
+    pfss_status const s = pfss_eval_all_mt(key1,
+                                           (uint8_t const *)&xp,
+                                           xp_bits,
+                                           PFSS_NATIVE_ENDIAN,
+                                           (uint8_t *)ys,
+                                           sizeof(*ys),
+                                           PFSS_NATIVE_ENDIAN,
+                                           thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_mt failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t const k = domain_bits - xp_bits;
+    uint32_t const x_first = xp_bits == 0 ? 0 : xp << k;
+    uint32_t const x_last = x_first + (((uint32_t)1 << k) - 1);
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      uint32_t y = 0xDEADBEEF;
+      if (x >= x_first && x <= x_last) {
+        pfss_status const s = pfss_eval(key1,
+                                        (uint8_t const *)&x,
+                                        sizeof(x),
+                                        PFSS_NATIVE_ENDIAN,
+                                        (uint8_t *)&y,
+                                        sizeof(y),
+                                        PFSS_NATIVE_ENDIAN);
+        if (s != PFSS_OK) {
+          fprintf(stderr,
+                  "pfss_eval failed: %s\n",
+                  pfss_get_status_name(s));
+          exit_status = TEST_EXIT_ERROR;
+          goto cleanup2;
+        }
+      }
+      if (ys[x] != y) {
+        fprintf(stderr, "pfss_eval_all_mt disagrees with pfss_eval\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(ys);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 0, 0, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 0, 0, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 0, 0, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 0, 0, 7));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 0, 0, 16));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 3, 2, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 1, 2, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 33, 7, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(14, 16, 16383, 4321, 0, 0, 6));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 8, 17, 200, 0, 0, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(3, 1, 5, 1, 0, 0, 9));
+  s = (s != TEST_EXIT_PASS ? s : test1(10, 32, 1000, 5, 1, 1, 1000));
+  s = (s != TEST_EXIT_PASS ? s : test1(12, 32, 100, 9, 4095, 12, 4));
+  return s;
+}
@@ -0,0 +1,282 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GUARD 0xA5
+
+static uint64_t get_packed(uint8_t const * const ys,
+                           uint64_t const i,
+                           uint32_t const rb) {
+  uint64_t y = 0;
+  uint32_t k;
+  for (k = 0; k != rb; ++k) {
+    uint64_t const bit = i * rb + k;
+    y |= (uint64_t)((ys[bit / 8] >> (bit % 8)) & 1) << k;
+  }
+  return y;
+}
+
+static void set_packed(uint8_t * const ys,
+                       uint64_t const i,
+                       uint32_t const rb,
+                       uint64_t const y) {
+  uint32_t k;
+  for (k = 0; k != rb; ++k) {
+    uint64_t const bit = i * rb + k;
+    ys[bit / 8] &= (uint8_t) ~(1U << (bit % 8));
+    ys[bit / 8] |= (uint8_t)(((y >> k) & 1) << (bit % 8));
+  }
+}
+
+/*
+ * Checks that the n elements of the packed array ys match the n
+ * elements of ys_ref, and that the bits after the last element were
+ * left as GUARD bytes.
+ */
+
+static int check_packed(uint8_t const * const ys,
+                        uint64_t const * const ys_ref,
+                        uint64_t const n,
+                        uint32_t const rb,
+                        size_t const packed_size) {
+  uint64_t i;
+  for (i = 0; i != n; ++i) {
+    if (get_packed(ys, i, rb) != ys_ref[i]) {
+      return 0;
+    }
+  }
+  for (i = n * rb; i != (uint64_t)(packed_size + 1) * 8; ++i) {
+    if (((ys[i / 8] >> (i % 8)) & 1) != ((GUARD >> (i % 8)) & 1)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Evaluates key1 and key2 at every domain element with the prefix xp
+ * of xp_bits bits, both with pfss_eval_all_ctx into 64-bit outputs and
+ * with pfss_eval_all_packed_ctx, and checks that the two agree. Then
+ * checks that pfss_eval_all_sum_packed_ctx and
+ * pfss_eval_all_dot_packed_ctx agree with pfss_eval_all_sum_ctx and
+ * pfss_eval_all_dot_ctx over keys_count keys.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const xp,
+                 uint32_t const xp_bits,
+                 uint32_t const keys_count,
+                 uint32_t const thread_count) {
+  uint64_t const n = (uint64_t)1 << db;
+  uint64_t const m = (uint64_t)1 << (db - xp_bits);
+  uint64_t const mask = rb >= 64 ? UINT64_MAX : ((uint64_t)1 << rb) - 1;
+  size_t const packed_size = (size_t)((n * rb + 7) / 8);
+  pfss_eval_context * context = NULL;
+  pfss_key const ** keys = NULL;
+  uint64_t * ys_ref = NULL;
+  uint64_t * ws = NULL;
+  uint64_t * zs1 = NULL;
+  uint64_t * zs2 = NULL;
+  uint8_t * ys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  keys = malloc(keys_count * sizeof(*keys));
+  ys_ref = malloc((size_t)n * sizeof(*ys_ref));
+  ws = malloc((size_t)n * sizeof(*ws));
+  zs1 = malloc(keys_count * sizeof(*zs1));
+  zs2 = malloc(keys_count * sizeof(*zs2));
+  ys = malloc(packed_size + 1);
+  if (keys == NULL || ys_ref == NULL || ws == NULL || zs1 == NULL
+      || zs2 == NULL || ys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      keys[i] = i % 3 == 1 ? key2 : key1;
+    }
+  }
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    pfss_key const * const keys2[2] = {key1, key2};
+    int j;
+    for (j = 0; j != 2; ++j) {
+      pfss_status s;
+      memset(ys, GUARD, packed_size + 1);
+      s = pfss_eval_all_ctx(context,
+                            keys2[j],
+                            (uint8_t const *)&xp,
+                            xp_bits,
+                            PFSS_NATIVE_ENDIAN,
+                            (uint8_t *)ys_ref,
+                            sizeof(*ys_ref),
+                            PFSS_NATIVE_ENDIAN,
+                            thread_count);
+      if (s == PFSS_OK) {
+        s = pfss_eval_all_packed_ctx(context,
+                                     keys2[j],
+                                     (uint8_t const *)&xp,
+                                     xp_bits,
+                                     PFSS_NATIVE_ENDIAN,
+                                     ys,
+                                     thread_count);
+      }
+      if (s != PFSS_OK) {
+        fprintf(stderr,
+                "pfss_eval_all_{,packed_}ctx failed: %s\n",
+                pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+      if (!check_packed(ys, ys_ref, m, rb, packed_size)) {
+        fprintf(stderr,
+                "pfss_eval_all_packed_ctx disagrees with "
+                "pfss_eval_all_ctx (db=%lu, rb=%lu, xp_bits=%lu)\n",
+                (unsigned long)db,
+                (unsigned long)rb,
+                (unsigned long)xp_bits);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+  {
+    pfss_status s;
+    memset(ys, GUARD, packed_size + 1);
+    memset(ys_ref, 0, (size_t)n * sizeof(*ys_ref));
+    {
+      uint64_t i;
+      for (i = 0; i != n; ++i) {
+        uint64_t const y =
+            ((uint64_t)rand() << 32 ^ (uint64_t)rand()) & mask;
+        ys_ref[i] = y;
+        set_packed(ys, i, rb, y);
+      }
+    }
+    s = pfss_eval_all_sum_ctx(context,
+                              keys,
+                              keys_count,
+                              (uint8_t *)ys_ref,
+                              sizeof(*ys_ref),
+                              PFSS_NATIVE_ENDIAN,
+                              thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_eval_all_sum_packed_ctx(
+          context, keys, keys_count, ys, thread_count);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_sum{,_packed}_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    {
+      uint64_t i;
+      for (i = 0; i != n; ++i) {
+        ys_ref[i] &= mask;
+      }
+    }
+    if (!check_packed(ys, ys_ref, n, rb, packed_size)) {
+      fprintf(stderr,
+              "pfss_eval_all_sum_packed_ctx disagrees with "
+              "pfss_eval_all_sum_ctx (db=%lu, rb=%lu)\n",
+              (unsigned long)db,
+              (unsigned long)rb);
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+  {
+    pfss_status s;
+    memset(ys, GUARD, packed_size + 1);
+    {
+      uint64_t i;
+      for (i = 0; i != n; ++i) {
+        uint64_t const w =
+            ((uint64_t)rand() << 32 ^ (uint64_t)rand()) & mask;
+        ws[i] = w;
+        set_packed(ys, i, rb, w);
+      }
+    }
+    s = pfss_eval_all_dot_ctx(context,
+                              keys,
+                              keys_count,
+                              (uint8_t const *)ws,
+                              sizeof(*ws),
+                              PFSS_NATIVE_ENDIAN,
+                              (uint8_t *)zs1,
+                              sizeof(*zs1),
+                              PFSS_NATIVE_ENDIAN,
+                              thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_eval_all_dot_packed_ctx(context,
+                                       keys,
+                                       keys_count,
+                                       ys,
+                                       (uint8_t *)zs2,
+                                       sizeof(*zs2),
+                                       PFSS_NATIVE_ENDIAN,
+                                       thread_count);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_dot{,_packed}_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    if (memcmp(zs1, zs2, keys_count * sizeof(*zs1)) != 0) {
+      fprintf(stderr,
+              "pfss_eval_all_dot_packed_ctx disagrees with "
+              "pfss_eval_all_dot_ctx (db=%lu, rb=%lu)\n",
+              (unsigned long)db,
+              (unsigned long)rb);
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  if (context != NULL) {
+    pfss_eval_context_destroy(context);
+  }
+  free(keys);
+  free(ys_ref);
+  free(ws);
+  free(zs1);
+  free(zs2);
+  free(ys);
+  goto cleanup;
+}
+
+int main(void) {
+  static uint32_t const rbs[] = {1,  2,  3,  4,  5,  7,  8,  9, 13,
+                                 16, 17, 31, 32, 33, 57, 63, 64};
+  int s = TEST_EXIT_PASS;
+  size_t i;
+  for (i = 0; i != sizeof(rbs) / sizeof(*rbs); ++i) {
+    uint32_t const rb = rbs[i];
+    s = (s != TEST_EXIT_PASS ? s : test1(10, rb, 777, 4321, 0, 0, 5, 1));
+    s = (s != TEST_EXIT_PASS ? s : test1(10, rb, 777, 4321, 0, 0, 7, 3));
+    s = (s != TEST_EXIT_PASS ? s : test1(10, rb, 777, 4321, 2, 3, 3, 2));
+    s = (s != TEST_EXIT_PASS ? s : test1(2, rb, 1, 3, 0, 0, 2, 2));
+  }
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 1, 40000, 1, 0, 0, 9, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 4, 40000, 9, 1, 1, 9, 4));
+  return s;
+}
@@ -0,0 +1,69 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Sums both keys over the whole domain with a thread count that does
+ * not divide the domain size, so that the threads' ranges start and
+ * end in the middle of the tree. The sum must be the point function.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const thread_count) {
+  uint32_t * ys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = calloc((size_t)1 << domain_bits, sizeof(*ys));
+  if (ys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    pfss_key const * const keys[2] = {key1, key2};
+    pfss_status const s = pfss_eval_all_sum(keys,
+                                            2,
+                                            (uint8_t *)ys,
+                                            sizeof(*ys),
+                                            PFSS_NATIVE_ENDIAN,
+                                            thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_sum failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      uint32_t const y = x == domain_value ? range_value : 0;
+      if (ys[x] != y) {
+        fprintf(stderr, "pfss_eval_all_sum got a wrong answer\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(ys);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 12345, 67890, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(12, 32, 2748, 12345, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(13, 8, 8190, 77, 7));
+  return s;
+}
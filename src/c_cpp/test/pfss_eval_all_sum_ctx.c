@@ -0,0 +1,150 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Like pfss_eval_all_sum, but every call goes through one context. The
+ * thread counts grow and then shrink and the domain sizes change from
+ * call to call, so the pool and the scratch buffers are reused in
+ * states that an earlier call left behind.
+ */
+
+static int test1(pfss_eval_context * const context,
+                 uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const thread_count) {
+  uint32_t * ys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = calloc((size_t)1 << domain_bits, sizeof(*ys));
+  if (ys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    pfss_key const * const keys[2] = {key1, key2};
+    pfss_status const s = pfss_eval_all_sum_ctx(context,
+                                                keys,
+                                                2,
+                                                (uint8_t *)ys,
+                                                sizeof(*ys),
+                                                PFSS_NATIVE_ENDIAN,
+                                                thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_sum_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      uint32_t const y = x == domain_value ? range_value : 0;
+      if (ys[x] != y) {
+        fprintf(stderr, "pfss_eval_all_sum_ctx got a wrong answer\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(ys);
+  goto cleanup;
+}
+
+/*
+ * Sums keys_count / 2 copies of both keys over a small domain, so that
+ * the keys have to be split across the threads as well as the domain.
+ * The result must be keys_count / 2 times the point function.
+ */
+
+static int test2(pfss_eval_context * const context,
+                 uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const keys_count,
+                 uint32_t const thread_count) {
+  uint32_t * ys = NULL;
+  pfss_key const ** keys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = calloc((size_t)1 << domain_bits, sizeof(*ys));
+  keys = malloc(keys_count * sizeof(*keys));
+  if (ys == NULL || keys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      keys[i] = i % 2 == 0 ? key1 : key2;
+    }
+  }
+  {
+    pfss_status const s = pfss_eval_all_sum_ctx(context,
+                                                keys,
+                                                keys_count,
+                                                (uint8_t *)ys,
+                                                sizeof(*ys),
+                                                PFSS_NATIVE_ENDIAN,
+                                                thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_sum_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t const mask = (uint32_t)(((uint64_t)1 << range_bits) - 1);
+    uint32_t x;
+    for (x = 0; x != (uint32_t)1 << domain_bits; ++x) {
+      uint32_t const y =
+          x == domain_value ? (keys_count / 2 * range_value) & mask : 0;
+      if (ys[x] != y) {
+        fprintf(stderr, "pfss_eval_all_sum_ctx got a wrong answer\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(keys);
+  free(ys);
+  goto cleanup;
+}
+
+int main(void) {
+  pfss_eval_context * context;
+  int s = TEST_EXIT_PASS;
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    return TEST_EXIT_ERROR;
+  }
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 16, 32, 12345, 67890, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 12, 32, 2748, 12345, 8));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 13, 8, 8190, 77, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 4, 16, 9, 4321, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 18, 32, 1, 99, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 17, 16, 131071, 9, 3));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 4, 32, 9, 4321, 200, 8));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 10, 16, 1, 77, 34, 5));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 2, 8, 3, 200, 6, 64));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 12, 32, 4000, 3, 2, 3));
+  s = (s != TEST_EXIT_PASS ? s : test2(context, 17, 32, 99, 5, 10, 4));
+  if (pfss_eval_context_destroy(context) != PFSS_OK) {
+    s = (s != TEST_EXIT_PASS ? s : TEST_EXIT_ERROR);
+  }
+  return s;
+}
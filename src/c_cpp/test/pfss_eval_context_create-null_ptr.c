@@ -6,15 +6,12 @@
 #include <helpers.h>
 
 int main(void) {
-  return TEST_EXIT_SKIP;
-#if 0
   {
     pfss_status const s =
         pfss_eval_context_create(NULL);
-    if (s != PFSS_INVALID_ARGUMENT) {
+    if (s != PFSS_NULL_POINTER) {
       return TEST_EXIT_FAIL;
     }
   }
   return TEST_EXIT_PASS;
-#endif
 }
@@ -0,0 +1,152 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Evaluates key1 at every x in [lo, hi] on thread_count threads and
+ * checks every output against pfss_eval. The element just past the end
+ * of ys must be left alone.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint64_t const lo,
+                 uint64_t const hi,
+                 uint32_t const thread_count) {
+  uint64_t const n = hi - lo + 1;
+  uint32_t * ys = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys = malloc((size_t)(n + 1) * sizeof(*ys));
+  if (ys == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint64_t i;
+    for (i = 0; i != n + 1; ++i) {
+      ys[i] = 0xDEADBEEF;
+    }
+  }
+  {
+    pfss_status const s = pfss_eval_range(key1,
+                                          (uint8_t const *)&lo,
+                                          (uint8_t const *)&hi,
+                                          sizeof(lo),
+                                          PFSS_NATIVE_ENDIAN,
+                                          (uint8_t *)ys,
+                                          sizeof(*ys),
+                                          PFSS_NATIVE_ENDIAN,
+                                          thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_range failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint64_t i;
+    for (i = 0; i != n; ++i) {
+      uint64_t const x = lo + i;
+      uint32_t y;
+      pfss_status const s = pfss_eval(key1,
+                                      (uint8_t const *)&x,
+                                      sizeof(x),
+                                      PFSS_NATIVE_ENDIAN,
+                                      (uint8_t *)&y,
+                                      sizeof(y),
+                                      PFSS_NATIVE_ENDIAN);
+      if (s != PFSS_OK) {
+        fprintf(stderr, "pfss_eval failed: %s\n", pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+      if (ys[i] != y) {
+        fprintf(stderr,
+                "pfss_eval_range disagrees with pfss_eval at x=%lu "
+                "(db=%lu, lo=%lu, hi=%lu, thread_count=%lu)\n",
+                (unsigned long)x,
+                (unsigned long)db,
+                (unsigned long)lo,
+                (unsigned long)hi,
+                (unsigned long)thread_count);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+    if (ys[n] != 0xDEADBEEF) {
+      fprintf(stderr, "pfss_eval_range wrote past the end of ys\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  free(ys);
+  goto cleanup;
+}
+
+/*
+ * Checks that pfss_eval_range rejects an empty interval and an
+ * interval that goes past the end of the domain.
+ */
+
+static int test2(void) {
+  uint32_t ys[4];
+  DO_UP_TO_PARSE_KEY(8, 8, 3, 1);
+  {
+    uint32_t const lo = 5;
+    uint32_t const hi = 4;
+    uint32_t const big = 256;
+    if (pfss_eval_range(key1,
+                        (uint8_t const *)&lo,
+                        (uint8_t const *)&hi,
+                        sizeof(lo),
+                        PFSS_NATIVE_ENDIAN,
+                        (uint8_t *)ys,
+                        sizeof(*ys),
+                        PFSS_NATIVE_ENDIAN,
+                        1)
+            != PFSS_INVALID_ARGUMENT
+        || pfss_eval_range(key1,
+                           (uint8_t const *)&hi,
+                           (uint8_t const *)&big,
+                           sizeof(hi),
+                           PFSS_NATIVE_ENDIAN,
+                           (uint8_t *)ys,
+                           sizeof(*ys),
+                           PFSS_NATIVE_ENDIAN,
+                           1)
+               != PFSS_DOMAIN_OVERFLOW) {
+      fprintf(stderr, "pfss_eval_range accepted a bad interval\n");
+      exit_status = TEST_EXIT_FAIL;
+    }
+  }
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 654321, 654321, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 654000, 654999, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 600001, 700003, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 8, 0, 7, 0, 1048575, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 1, 99999, 1, 99000, 1048575, 9));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 4000, 67890, 3, 65533, 7));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 3, 29, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(3, 5, 6, 9, 0, 7, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(1, 8, 1, 200, 1, 1, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(40, 32, 5, 9, 0, 100000, 5));
+  s = (s != TEST_EXIT_PASS ? s : test2());
+  return s;
+}
@@ -0,0 +1,129 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Evaluates key1 and key2 at every x in [lo, hi] with 64-bit outputs
+ * and checks every output against pfss_eval, and the sum of the two
+ * against rv at dv and zero elsewhere. This covers the leaf kernels for
+ * each kind of range width: whole words, sub-byte widths, other widths
+ * that fit in a 64-bit window, and wider ones.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint64_t const lo,
+                 uint64_t const hi) {
+  uint64_t const n = hi - lo + 1;
+  uint64_t const mask = rb >= 64 ? UINT64_MAX : ((uint64_t)1 << rb) - 1;
+  uint64_t * ys1 = NULL;
+  uint64_t * ys2 = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  ys1 = malloc((size_t)n * sizeof(*ys1));
+  ys2 = malloc((size_t)n * sizeof(*ys2));
+  if (ys1 == NULL || ys2 == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    pfss_key const * const keys[2] = {key1, key2};
+    uint64_t * const yss[2] = {ys1, ys2};
+    int j;
+    for (j = 0; j != 2; ++j) {
+      pfss_status const s = pfss_eval_range(keys[j],
+                                            (uint8_t const *)&lo,
+                                            (uint8_t const *)&hi,
+                                            sizeof(lo),
+                                            PFSS_NATIVE_ENDIAN,
+                                            (uint8_t *)yss[j],
+                                            sizeof(*yss[j]),
+                                            PFSS_NATIVE_ENDIAN,
+                                            1);
+      if (s != PFSS_OK) {
+        fprintf(stderr,
+                "pfss_eval_range failed: %s\n",
+                pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+    }
+    for (j = 0; j != 2; ++j) {
+      uint64_t i;
+      for (i = 0; i != n; ++i) {
+        uint64_t const x = lo + i;
+        uint64_t y;
+        pfss_status const s = pfss_eval(keys[j],
+                                        (uint8_t const *)&x,
+                                        sizeof(x),
+                                        PFSS_NATIVE_ENDIAN,
+                                        (uint8_t *)&y,
+                                        sizeof(y),
+                                        PFSS_NATIVE_ENDIAN);
+        if (s != PFSS_OK) {
+          fprintf(stderr,
+                  "pfss_eval failed: %s\n",
+                  pfss_get_status_name(s));
+          exit_status = TEST_EXIT_ERROR;
+          goto cleanup2;
+        }
+        if (yss[j][i] != y) {
+          fprintf(stderr,
+                  "pfss_eval_range disagrees with pfss_eval at x=%lu "
+                  "(db=%lu, rb=%lu)\n",
+                  (unsigned long)x,
+                  (unsigned long)db,
+                  (unsigned long)rb);
+          exit_status = TEST_EXIT_FAIL;
+          goto cleanup2;
+        }
+      }
+    }
+  }
+  {
+    uint64_t i;
+    for (i = 0; i != n; ++i) {
+      uint64_t const sum = (ys1[i] + ys2[i]) & mask;
+      if (sum != (lo + i == dv ? rv & mask : 0)) {
+        fprintf(stderr,
+                "pfss_eval_range got a wrong answer at x=%lu "
+                "(db=%lu, rb=%lu)\n",
+                (unsigned long)(lo + i),
+                (unsigned long)db,
+                (unsigned long)rb);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(ys1);
+  free(ys2);
+  goto cleanup;
+}
+
+int main(void) {
+  static uint32_t const rbs[] = {1,  2,  3,  4,  5,  7,  8,  9,  12,
+                                 16, 17, 24, 31, 32, 33, 40, 57, 58,
+                                 63, 64};
+  int s = TEST_EXIT_PASS;
+  size_t i;
+  for (i = 0; i != sizeof(rbs) / sizeof(*rbs); ++i) {
+    uint32_t const rb = rbs[i];
+    s = (s != TEST_EXIT_PASS ? s : test1(12, rb, 1234, 4321, 0, 4095));
+    s = (s != TEST_EXIT_PASS ? s : test1(12, rb, 1234, 4321, 1001, 1299));
+    s = (s != TEST_EXIT_PASS ? s : test1(3, rb, 5, 3, 1, 6));
+  }
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 0, 65535));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 4000, 67890, 3, 65533));
+  return s;
+}
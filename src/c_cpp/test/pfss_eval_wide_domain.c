@@ -0,0 +1,174 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define X_SIZE 16
+#define MAX_XS 129
+
+/*
+ * Generates keys for a random alpha of db bits given as a 16-byte
+ * little-endian value, then evaluates both keys at alpha and at alpha
+ * with each of its db bits flipped. Checks that the outputs sum to rv
+ * at alpha and to zero elsewhere, that giving the points in big-endian
+ * order changes nothing, and that pfss_map_eval agrees with pfss_eval.
+ * The bits above db are set to garbage in every point, which must be
+ * ignored.
+ */
+
+static int test1(uint32_t const db, uint32_t const rb, uint32_t const rv) {
+  uint8_t alpha[X_SIZE];
+  uint8_t xs[MAX_XS][X_SIZE];
+  uint32_t ys1[MAX_XS];
+  uint32_t ys2[MAX_XS];
+  uint32_t n = db + 1;
+  uint32_t const mask = rb >= 32 ? UINT32_MAX : (1U << rb) - 1;
+  DO_UP_TO_NOT_INCLUDING_GEN(db, rb, 0, rv);
+  {
+    uint32_t i;
+    for (i = 0; i != X_SIZE; ++i) {
+      alpha[i] = (uint8_t)rand();
+    }
+    for (i = db; i != X_SIZE * 8; ++i) {
+      alpha[i / 8] &= (uint8_t)~(1U << (i % 8));
+    }
+  }
+  {
+    pfss_status const s = pfss_gen(db,
+                                   rb,
+                                   alpha,
+                                   X_SIZE,
+                                   PFSS_LITTLE_ENDIAN,
+                                   (uint8_t const *)&range_value,
+                                   sizeof(range_value),
+                                   PFSS_NATIVE_ENDIAN,
+                                   key1_blob,
+                                   key2_blob,
+                                   rand_buf);
+    if (s != PFSS_OK) {
+      printf("pfss_gen failed: %s\n", pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup;
+    }
+  }
+  if (pfss_parse_key(&key1, key1_blob, key_blob_size) != PFSS_OK
+      || pfss_parse_key(&key2, key2_blob, key_blob_size) != PFSS_OK) {
+    printf("pfss_parse_key failed\n");
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup;
+  }
+  {
+    uint32_t j;
+    for (j = 0; j != n; ++j) {
+      uint32_t i;
+      memcpy(xs[j], alpha, X_SIZE);
+      if (j != 0) {
+        xs[j][(j - 1) / 8] ^= (uint8_t)(1U << ((j - 1) % 8));
+      }
+      for (i = db; i != X_SIZE * 8; ++i) {
+        if (rand() & 1) {
+          xs[j][i / 8] |= (uint8_t)(1U << (i % 8));
+        }
+      }
+    }
+  }
+  {
+    pfss_key const * const keys[2] = {key1, key2};
+    uint32_t * const yss[2] = {ys1, ys2};
+    int k;
+    for (k = 0; k != 2; ++k) {
+      uint32_t j;
+      for (j = 0; j != n; ++j) {
+        uint8_t x_be[X_SIZE];
+        uint32_t y_be;
+        uint32_t i;
+        for (i = 0; i != X_SIZE; ++i) {
+          x_be[i] = xs[j][X_SIZE - 1 - i];
+        }
+        if (pfss_eval(keys[k],
+                      xs[j],
+                      X_SIZE,
+                      PFSS_LITTLE_ENDIAN,
+                      (uint8_t *)&yss[k][j],
+                      sizeof(yss[k][j]),
+                      PFSS_NATIVE_ENDIAN)
+                != PFSS_OK
+            || pfss_eval(keys[k],
+                         x_be,
+                         X_SIZE,
+                         PFSS_BIG_ENDIAN,
+                         (uint8_t *)&y_be,
+                         sizeof(y_be),
+                         PFSS_NATIVE_ENDIAN)
+                   != PFSS_OK) {
+          printf("pfss_eval failed\n");
+          exit_status = TEST_EXIT_ERROR;
+          goto cleanup;
+        }
+        if (y_be != yss[k][j]) {
+          printf("pfss_eval depends on x_endianness (db=%lu)\n",
+                 (unsigned long)db);
+          exit_status = TEST_EXIT_FAIL;
+          goto cleanup;
+        }
+      }
+      {
+        uint32_t ys[MAX_XS];
+        pfss_status const s = pfss_map_eval(keys[k],
+                                            &xs[0][0],
+                                            n,
+                                            X_SIZE,
+                                            PFSS_LITTLE_ENDIAN,
+                                            (uint8_t *)ys,
+                                            sizeof(*ys),
+                                            PFSS_NATIVE_ENDIAN);
+        if (s != PFSS_OK) {
+          printf("pfss_map_eval failed: %s\n", pfss_get_status_name(s));
+          exit_status = TEST_EXIT_ERROR;
+          goto cleanup;
+        }
+        if (memcmp(ys, yss[k], n * sizeof(*ys)) != 0) {
+          printf("pfss_map_eval disagrees with pfss_eval (db=%lu)\n",
+                 (unsigned long)db);
+          exit_status = TEST_EXIT_FAIL;
+          goto cleanup;
+        }
+      }
+    }
+  }
+  {
+    uint32_t j;
+    for (j = 0; j != n; ++j) {
+      uint32_t const sum = (ys1[j] + ys2[j]) & mask;
+      if (sum != (j == 0 ? rv & mask : 0)) {
+        printf("pfss_eval got a wrong answer (db=%lu, j=%lu)\n",
+               (unsigned long)db,
+               (unsigned long)j);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup;
+      }
+    }
+  }
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 77));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 16, 12345));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 32, 99999));
+  s = (s != TEST_EXIT_PASS ? s : test1(33, 32, 424242));
+  s = (s != TEST_EXIT_PASS ? s : test1(64, 8, 200));
+  s = (s != TEST_EXIT_PASS ? s : test1(80, 32, 31337));
+  s = (s != TEST_EXIT_PASS ? s : test1(100, 32, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(128, 32, 1));
+  return s;
+}
@@ -0,0 +1,17 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <pfss.h>
+#include <stdio.h>
+
+int main(void) {
+  char const * const name = pfss_get_aes_backend();
+  if (name == NULL || *name == '\0') {
+    return TEST_EXIT_FAIL;
+  }
+  printf("%s\n", name);
+  return TEST_EXIT_PASS;
+}
@@ -0,0 +1,304 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Writes keys_count key blobs, alternating between key1_blob and
+ * key2_blob, to a key store on thread_count threads, then opens the
+ * store at an aligned address, at a misaligned address, and with the
+ * image fields of its header changed, and checks that each key set
+ * agrees with pfss_parse_keys under pfss_eval_all_sum_key_set and
+ * pfss_map_eval_key_set. Also checks that a store with a bad magic
+ * number, a truncated store, and a too small output buffer are
+ * rejected.
+ */
+
+static int check_store(pfss_eval_context * const context,
+                       uint8_t const * const store,
+                       uint64_t const store_size,
+                       pfss_key_set const * const ref_set,
+                       uint32_t const * const xs,
+                       uint32_t const n,
+                       uint32_t const keys_count,
+                       uint32_t const thread_count,
+                       uint32_t * const ys1,
+                       uint32_t * const ys2) {
+  pfss_key_set * key_set = NULL;
+  int exit_status = TEST_EXIT_PASS;
+  pfss_status s =
+      pfss_open_key_store(&key_set, store, store_size, thread_count);
+  if (s != PFSS_OK) {
+    fprintf(stderr,
+            "pfss_open_key_store failed: %s\n",
+            pfss_get_status_name(s));
+    return TEST_EXIT_ERROR;
+  }
+  memset(ys1, 0, n * sizeof(*ys1));
+  memset(ys2, 0, n * sizeof(*ys2));
+  s = pfss_eval_all_sum_key_set(context,
+                                key_set,
+                                (uint8_t *)ys1,
+                                sizeof(*ys1),
+                                PFSS_NATIVE_ENDIAN,
+                                thread_count);
+  if (s == PFSS_OK) {
+    s = pfss_eval_all_sum_key_set(context,
+                                  ref_set,
+                                  (uint8_t *)ys2,
+                                  sizeof(*ys2),
+                                  PFSS_NATIVE_ENDIAN,
+                                  thread_count);
+  }
+  if (s != PFSS_OK) {
+    fprintf(stderr,
+            "pfss_eval_all_sum_key_set failed: %s\n",
+            pfss_get_status_name(s));
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup;
+  }
+  if (memcmp(ys1, ys2, n * sizeof(*ys1)) != 0) {
+    fprintf(stderr,
+            "pfss_eval_all_sum_key_set disagrees between the opened "
+            "and the parsed key sets\n");
+    exit_status = TEST_EXIT_FAIL;
+    goto cleanup;
+  }
+  s = pfss_map_eval_key_set(context,
+                            key_set,
+                            (uint8_t const *)xs,
+                            n,
+                            sizeof(*xs),
+                            PFSS_NATIVE_ENDIAN,
+                            (uint8_t *)ys1,
+                            sizeof(*ys1),
+                            PFSS_NATIVE_ENDIAN,
+                            PFSS_KEY_MAJOR,
+                            thread_count);
+  if (s == PFSS_OK) {
+    s = pfss_map_eval_key_set(context,
+                              ref_set,
+                              (uint8_t const *)xs,
+                              n,
+                              sizeof(*xs),
+                              PFSS_NATIVE_ENDIAN,
+                              (uint8_t *)ys2,
+                              sizeof(*ys2),
+                              PFSS_NATIVE_ENDIAN,
+                              PFSS_KEY_MAJOR,
+                              thread_count);
+  }
+  if (s != PFSS_OK) {
+    fprintf(stderr,
+            "pfss_map_eval_key_set failed: %s\n",
+            pfss_get_status_name(s));
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup;
+  }
+  if (memcmp(ys1, ys2, (size_t)keys_count * n * sizeof(*ys1)) != 0) {
+    fprintf(stderr,
+            "pfss_map_eval_key_set disagrees between the opened and "
+            "the parsed key sets\n");
+    exit_status = TEST_EXIT_FAIL;
+    goto cleanup;
+  }
+cleanup:
+  pfss_destroy_key_set(key_set);
+  return exit_status;
+}
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const keys_count,
+                 uint32_t const thread_count) {
+  uint32_t const n = 1U << db;
+  uint64_t store_size = 0;
+  uint8_t * blobs = NULL;
+  uint8_t * store_buf = NULL;
+  pfss_key_set * ref_set = NULL;
+  pfss_eval_context * context = NULL;
+  uint32_t * xs = NULL;
+  uint32_t * ys1 = NULL;
+  uint32_t * ys2 = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  if (pfss_key_store_size(db, rb, keys_count, &store_size) != PFSS_OK) {
+    fprintf(stderr, "pfss_key_store_size failed\n");
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  blobs = malloc((size_t)keys_count * key_blob_size);
+  store_buf = malloc((size_t)store_size + 1);
+  xs = malloc(n * sizeof(*xs));
+  ys1 = malloc((size_t)keys_count * n * sizeof(*ys1));
+  ys2 = malloc((size_t)keys_count * n * sizeof(*ys2));
+  if (blobs == NULL || store_buf == NULL || xs == NULL || ys1 == NULL
+      || ys2 == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      memcpy(blobs + (size_t)i * key_blob_size,
+             i % 2 == 0 ? key1_blob : key2_blob,
+             key_blob_size);
+    }
+    for (i = 0; i != n; ++i) {
+      xs[i] = (uint32_t)rand() & (n - 1);
+    }
+  }
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  if (pfss_parse_keys(
+          &ref_set, blobs, keys_count, key_blob_size, thread_count)
+      != PFSS_OK) {
+    fprintf(stderr, "pfss_parse_keys failed\n");
+    ref_set = NULL;
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    pfss_status const s = pfss_write_key_store(blobs,
+                                               keys_count,
+                                               key_blob_size,
+                                               store_buf + 1,
+                                               store_size - 1,
+                                               thread_count);
+    if (s != PFSS_INVALID_ARGUMENT) {
+      fprintf(stderr,
+              "pfss_write_key_store accepted a small buffer: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+  {
+    /* An aligned store, which should be opened in place. */
+    pfss_status const s = pfss_write_key_store(blobs,
+                                               keys_count,
+                                               key_blob_size,
+                                               store_buf,
+                                               store_size,
+                                               thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_write_key_store failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    exit_status = check_store(context,
+                              store_buf,
+                              store_size,
+                              ref_set,
+                              xs,
+                              n,
+                              keys_count,
+                              thread_count,
+                              ys1,
+                              ys2);
+    if (exit_status != TEST_EXIT_PASS) {
+      goto cleanup2;
+    }
+  }
+  {
+    /* A misaligned store, which should be parsed. */
+    memmove(store_buf + 1, store_buf, (size_t)store_size);
+    exit_status = check_store(context,
+                              store_buf + 1,
+                              store_size,
+                              ref_set,
+                              xs,
+                              n,
+                              keys_count,
+                              thread_count,
+                              ys1,
+                              ys2);
+    memmove(store_buf, store_buf + 1, (size_t)store_size);
+    if (exit_status != TEST_EXIT_PASS) {
+      goto cleanup2;
+    }
+  }
+  {
+    /* A store whose images do not fit, which should be parsed. */
+    store_buf[36] ^= 1;
+    exit_status = check_store(context,
+                              store_buf,
+                              store_size,
+                              ref_set,
+                              xs,
+                              n,
+                              keys_count,
+                              thread_count,
+                              ys1,
+                              ys2);
+    store_buf[36] ^= 1;
+    if (exit_status != TEST_EXIT_PASS) {
+      goto cleanup2;
+    }
+  }
+  {
+    pfss_key_set * bad_set = NULL;
+    pfss_status s;
+    store_buf[0] ^= 1;
+    s = pfss_open_key_store(&bad_set, store_buf, store_size, thread_count);
+    store_buf[0] ^= 1;
+    if (s == PFSS_OK) {
+      pfss_destroy_key_set(bad_set);
+    }
+    if (s != PFSS_MALFORMED_KEY) {
+      fprintf(stderr,
+              "pfss_open_key_store accepted a bad magic number: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+    s = pfss_open_key_store(
+        &bad_set, store_buf, store_size - 1, thread_count);
+    if (s == PFSS_OK) {
+      pfss_destroy_key_set(bad_set);
+    }
+    if (s != PFSS_MALFORMED_KEY) {
+      fprintf(stderr,
+              "pfss_open_key_store accepted a truncated store: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  if (ref_set != NULL) {
+    pfss_destroy_key_set(ref_set);
+  }
+  if (context != NULL) {
+    pfss_eval_context_destroy(context);
+  }
+  free(blobs);
+  free(store_buf);
+  free(xs);
+  free(ys1);
+  free(ys2);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 200, 77, 1, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(10, 32, 1000, 12345, 1001, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(12, 16, 4000, 999, 600, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(9, 13, 300, 4321, 77, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 64, 2));
+  return s;
+}
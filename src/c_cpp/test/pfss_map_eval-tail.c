@@ -0,0 +1,66 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Maps both keys over a point count that is not a multiple of the
+ * number of lanes pfss_map_eval runs in lockstep, with the special
+ * point placed in the scalar tail. The sums must be the point function.
+ */
+
+int main(void) {
+  uint32_t xs[13] = {0,
+                     1,
+                     77,
+                     4095,
+                     1048575,
+                     524288,
+                     12,
+                     999999,
+                     31337,
+                     262143,
+                     65536,
+                     654321,
+                     7};
+  uint32_t ys1[13];
+  uint32_t ys2[13];
+  uint32_t i;
+  DO_UP_TO_PARSE_KEY(20, 32, 654321, 0xDEADBEEF);
+  if (pfss_map_eval(key1,
+                    (uint8_t const *)xs,
+                    13,
+                    sizeof(*xs),
+                    PFSS_NATIVE_ENDIAN,
+                    (uint8_t *)ys1,
+                    sizeof(*ys1),
+                    PFSS_NATIVE_ENDIAN)
+          != PFSS_OK
+      || pfss_map_eval(key2,
+                       (uint8_t const *)xs,
+                       13,
+                       sizeof(*xs),
+                       PFSS_NATIVE_ENDIAN,
+                       (uint8_t *)ys2,
+                       sizeof(*ys2),
+                       PFSS_NATIVE_ENDIAN)
+             != PFSS_OK) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup;
+  }
+  for (i = 0; i != 13; ++i) {
+    uint32_t const y = xs[i] == domain_value ? range_value : 0;
+    if ((uint32_t)(ys1[i] + ys2[i]) != y) {
+      fprintf(stderr, "pfss_map_eval got a wrong answer\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup;
+    }
+  }
+  goto cleanup;
+}
@@ -0,0 +1,93 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Evaluates both keys at a spread of points through one context and
+ * checks that the outputs sum to the point function.
+ */
+
+static int test1(pfss_eval_context * const context,
+                 uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const thread_count) {
+  enum { n = 37 };
+  uint32_t xs[n];
+  uint32_t ys1[n];
+  uint32_t ys2[n];
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  {
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      xs[i] = (uint32_t)(domain_value + i * 977) & ((1U << db) - 1);
+    }
+  }
+  {
+    pfss_status s = pfss_map_eval_ctx(context,
+                                      key1,
+                                      (uint8_t const *)xs,
+                                      n,
+                                      sizeof(*xs),
+                                      PFSS_NATIVE_ENDIAN,
+                                      (uint8_t *)ys1,
+                                      sizeof(*ys1),
+                                      PFSS_NATIVE_ENDIAN,
+                                      thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_map_eval_ctx(context,
+                            key2,
+                            (uint8_t const *)xs,
+                            n,
+                            sizeof(*xs),
+                            PFSS_NATIVE_ENDIAN,
+                            (uint8_t *)ys2,
+                            sizeof(*ys2),
+                            PFSS_NATIVE_ENDIAN,
+                            thread_count);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_map_eval_ctx failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup;
+    }
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      uint32_t const y = xs[i] == domain_value ? range_value : 0;
+      if ((uint32_t)(ys1[i] + ys2[i]) != y) {
+        fprintf(stderr, "pfss_map_eval_ctx got a wrong answer\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup;
+      }
+    }
+  }
+  goto cleanup;
+}
+
+int main(void) {
+  pfss_eval_context * context;
+  int s = TEST_EXIT_PASS;
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    return TEST_EXIT_ERROR;
+  }
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 20, 32, 654321, 13, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 16, 32, 4000, 67890, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(context, 16, 32, 4000, 67890, 4));
+  if (pfss_eval_context_destroy(context) != PFSS_OK) {
+    s = (s != TEST_EXIT_PASS ? s : TEST_EXIT_ERROR);
+  }
+  return s;
+}
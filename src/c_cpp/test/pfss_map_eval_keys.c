@@ -0,0 +1,135 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Evaluates keys_count keys, alternating between key1 and key2, at n
+ * points on thread_count threads, and checks every cell of the matrix
+ * against pfss_map_eval. The element just past the end of ys must be
+ * left alone.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const keys_count,
+                 uint32_t const n,
+                 pfss_layout const layout,
+                 uint32_t const thread_count) {
+  pfss_key const ** keys = NULL;
+  uint32_t * xs = NULL;
+  uint32_t * ys = NULL;
+  uint32_t * ys_ref = NULL;
+  size_t const cells = (size_t)keys_count * n;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  keys = malloc(keys_count * sizeof(*keys));
+  xs = malloc(n * sizeof(*xs));
+  ys = malloc((cells + 1) * sizeof(*ys));
+  ys_ref = malloc(2 * n * sizeof(*ys_ref));
+  if (keys == NULL || xs == NULL || ys == NULL || ys_ref == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t const mask = db >= 32 ? UINT32_MAX : (1U << db) - 1;
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      keys[i] = i % 2 == 0 ? key1 : key2;
+    }
+    for (i = 0; i != n; ++i) {
+      xs[i] = i % 3 == 0 ? dv : (uint32_t)(dv + i * 977) & mask;
+    }
+    for (i = 0; i != cells + 1; ++i) {
+      ys[i] = 0xDEADBEEF;
+    }
+  }
+  {
+    pfss_status s = pfss_map_eval_keys(keys,
+                                       keys_count,
+                                       (uint8_t const *)xs,
+                                       n,
+                                       sizeof(*xs),
+                                       PFSS_NATIVE_ENDIAN,
+                                       (uint8_t *)ys,
+                                       sizeof(*ys),
+                                       PFSS_NATIVE_ENDIAN,
+                                       layout,
+                                       thread_count);
+    int j;
+    for (j = 0; s == PFSS_OK && j != 2; ++j) {
+      s = pfss_map_eval(j == 0 ? key1 : key2,
+                        (uint8_t const *)xs,
+                        n,
+                        sizeof(*xs),
+                        PFSS_NATIVE_ENDIAN,
+                        (uint8_t *)(ys_ref + j * n),
+                        sizeof(*ys_ref),
+                        PFSS_NATIVE_ENDIAN);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_map_eval{,_keys} failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t k;
+    for (k = 0; k != keys_count; ++k) {
+      uint32_t i;
+      for (i = 0; i != n; ++i) {
+        size_t const cell = layout == PFSS_POINT_MAJOR ?
+                                (size_t)i * keys_count + k :
+                                (size_t)k * n + i;
+        if (ys[cell] != ys_ref[(k % 2) * n + i]) {
+          fprintf(stderr,
+                  "pfss_map_eval_keys disagrees with pfss_map_eval "
+                  "for key %lu at point %lu\n",
+                  (unsigned long)k,
+                  (unsigned long)i);
+          exit_status = TEST_EXIT_FAIL;
+          goto cleanup2;
+        }
+      }
+    }
+    if (ys[cells] != 0xDEADBEEF) {
+      fprintf(stderr, "pfss_map_eval_keys wrote past the end of ys\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  free(keys);
+  free(xs);
+  free(ys);
+  free(ys_ref);
+  goto cleanup;
+}
+
+int main(void) {
+  pfss_layout const km = PFSS_KEY_MAJOR;
+  pfss_layout const pm = PFSS_POINT_MAJOR;
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 1, 1, km, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 1, 1000, km, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 2, 7, pm, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 9, 500, km, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 9, 500, pm, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 100, 3, km, 16));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 100, 3, pm, 16));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 17, 33, pm, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(3, 5, 6, 9, 4, 8, km, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 32, 123456789, 5, 33, 2000, pm, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(100, 16, 4321, 77, 12, 300, km, 2));
+  return s;
+}
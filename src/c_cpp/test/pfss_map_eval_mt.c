@@ -0,0 +1,106 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Evaluates key1 at n points on thread_count threads and checks every
+ * output against pfss_map_eval. The element just past the end of ys
+ * must be left alone.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const n,
+                 uint32_t const thread_count) {
+  uint32_t * xs = NULL;
+  uint32_t * ys = NULL;
+  uint32_t * ys_ref = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  xs = malloc(n * sizeof(*xs));
+  ys = malloc((n + 1) * sizeof(*ys));
+  ys_ref = malloc(n * sizeof(*ys_ref));
+  if (xs == NULL || ys == NULL || ys_ref == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t const mask = db >= 32 ? UINT32_MAX : (1U << db) - 1;
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      xs[i] = i % 3 == 0 ? dv : (uint32_t)(dv + i * 977) & mask;
+      ys[i] = 0xDEADBEEF;
+    }
+    ys[n] = 0xDEADBEEF;
+  }
+  {
+    pfss_status s = pfss_map_eval_mt(key1,
+                                     (uint8_t const *)xs,
+                                     n,
+                                     sizeof(*xs),
+                                     PFSS_NATIVE_ENDIAN,
+                                     (uint8_t *)ys,
+                                     sizeof(*ys),
+                                     PFSS_NATIVE_ENDIAN,
+                                     thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_map_eval(key1,
+                        (uint8_t const *)xs,
+                        n,
+                        sizeof(*xs),
+                        PFSS_NATIVE_ENDIAN,
+                        (uint8_t *)ys_ref,
+                        sizeof(*ys_ref),
+                        PFSS_NATIVE_ENDIAN);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_map_eval{,_mt} failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      if (ys[i] != ys_ref[i]) {
+        fprintf(stderr, "pfss_map_eval_mt disagrees with pfss_map_eval\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+    if (ys[n] != 0xDEADBEEF) {
+      fprintf(stderr, "pfss_map_eval_mt wrote past the end of ys\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  free(xs);
+  free(ys);
+  free(ys_ref);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 1, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 7, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 1000, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 5000, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 4000, 67890, 33333, 7));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 20001, 16));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 4099, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 32, 123456789, 5, 9000, 5));
+  return s;
+}
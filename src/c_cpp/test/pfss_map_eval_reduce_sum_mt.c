@@ -0,0 +1,109 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Sums key1 and key2 over n points on thread_count threads and checks
+ * each sum against pfss_map_eval_reduce_sum, and the sum of the two
+ * against the number of times dv appears in the points times rv.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const n,
+                 uint32_t const thread_count) {
+  uint32_t * xs = NULL;
+  uint32_t hits = 0;
+  uint32_t y1 = 0;
+  uint32_t y2 = 0;
+  uint32_t y1_ref = 0;
+  uint32_t y2_ref = 0;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  xs = malloc(n * sizeof(*xs));
+  if (xs == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t const mask = db >= 32 ? UINT32_MAX : (1U << db) - 1;
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      xs[i] = i % 5 == 0 ? dv : (uint32_t)(dv + i * 977) & mask;
+      hits += xs[i] == dv;
+    }
+  }
+  {
+    pfss_key const * const keys[2] = {key1, key2};
+    uint32_t * const ys[2] = {&y1, &y2};
+    uint32_t * const ys_ref[2] = {&y1_ref, &y2_ref};
+    int j;
+    for (j = 0; j != 2; ++j) {
+      pfss_status s = pfss_map_eval_reduce_sum_mt(keys[j],
+                                                  (uint8_t const *)xs,
+                                                  n,
+                                                  sizeof(*xs),
+                                                  PFSS_NATIVE_ENDIAN,
+                                                  (uint8_t *)ys[j],
+                                                  sizeof(*ys[j]),
+                                                  PFSS_NATIVE_ENDIAN,
+                                                  thread_count);
+      if (s == PFSS_OK) {
+        s = pfss_map_eval_reduce_sum(keys[j],
+                                     (uint8_t const *)xs,
+                                     n,
+                                     sizeof(*xs),
+                                     PFSS_NATIVE_ENDIAN,
+                                     (uint8_t *)ys_ref[j],
+                                     sizeof(*ys_ref[j]),
+                                     PFSS_NATIVE_ENDIAN);
+      }
+      if (s != PFSS_OK) {
+        fprintf(stderr,
+                "pfss_map_eval_reduce_sum{,_mt} failed: %s\n",
+                pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+    }
+  }
+  {
+    uint32_t const mask = rb >= 32 ? UINT32_MAX : (1U << rb) - 1;
+    if (y1 != y1_ref || y2 != y2_ref) {
+      fprintf(stderr,
+              "pfss_map_eval_reduce_sum_mt disagrees with "
+              "pfss_map_eval_reduce_sum\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+    if (((y1 + y2) & mask) != ((hits * rv) & mask)) {
+      fprintf(stderr, "pfss_map_eval_reduce_sum_mt got a wrong answer\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  free(xs);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 1, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 7, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 5000, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 4000, 67890, 33333, 7));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 20001, 16));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 4099, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 32, 123456789, 5, 9000, 5));
+  return s;
+}
@@ -0,0 +1,119 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compare_uint32(void const * const a, void const * const b) {
+  uint32_t const x = *(uint32_t const *)a;
+  uint32_t const y = *(uint32_t const *)b;
+  return x < y ? -1 : x > y;
+}
+
+/*
+ * Evaluates key1 at n clustered points on thread_count threads and
+ * checks every output against pfss_map_eval. If sort is nonzero, the
+ * points are sorted beforehand. xs_are_sorted is passed through as is,
+ * and a nonzero value with unsorted points must still give the right
+ * answers.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const n,
+                 int const sort,
+                 int const xs_are_sorted,
+                 uint32_t const thread_count) {
+  uint32_t * xs = NULL;
+  uint32_t * ys = NULL;
+  uint32_t * ys_ref = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  xs = malloc(n * sizeof(*xs));
+  ys = malloc(n * sizeof(*ys));
+  ys_ref = malloc(n * sizeof(*ys_ref));
+  if (xs == NULL || ys == NULL || ys_ref == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t const mask = db >= 32 ? UINT32_MAX : (1U << db) - 1;
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      uint32_t const c = (uint32_t)rand() % 4 * 0x10000;
+      uint32_t const d = (uint32_t)rand() % 500;
+      xs[i] = i % 7 == 0 ? dv : (dv + c + d) & mask;
+    }
+    if (sort) {
+      qsort(xs, n, sizeof(*xs), compare_uint32);
+    }
+  }
+  {
+    pfss_status s = pfss_map_eval_sorted(key1,
+                                         (uint8_t const *)xs,
+                                         n,
+                                         sizeof(*xs),
+                                         PFSS_NATIVE_ENDIAN,
+                                         (uint8_t *)ys,
+                                         sizeof(*ys),
+                                         PFSS_NATIVE_ENDIAN,
+                                         xs_are_sorted,
+                                         thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_map_eval(key1,
+                        (uint8_t const *)xs,
+                        n,
+                        sizeof(*xs),
+                        PFSS_NATIVE_ENDIAN,
+                        (uint8_t *)ys_ref,
+                        sizeof(*ys_ref),
+                        PFSS_NATIVE_ENDIAN);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_map_eval{,_sorted} failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != n; ++i) {
+      if (ys[i] != ys_ref[i]) {
+        fprintf(stderr,
+                "pfss_map_eval_sorted disagrees with pfss_map_eval\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+cleanup2:
+  free(xs);
+  free(ys);
+  free(ys_ref);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 1, 0, 0, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 9, 0, 0, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 5000, 0, 0, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 5000, 1, 1, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 32, 654321, 13, 5000, 0, 1, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 32, 123456789, 5, 9000, 0, 0, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 8, 123456789, 5, 9000, 1, 0, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 8, 65535, 255, 20001, 0, 0, 7));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 4099, 0, 0, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(3, 5, 6, 9, 100, 0, 0, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(100, 16, 4321, 77, 3000, 0, 0, 2));
+  return s;
+}
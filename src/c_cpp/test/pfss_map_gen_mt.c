@@ -0,0 +1,162 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Generates count key pairs with pfss_map_gen_mt on thread_count
+ * threads and checks that each pair is byte-for-byte the same as the
+ * pair that pfss_gen generates from the same random bytes.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const count,
+                 uint32_t const thread_count) {
+  int exit_status = TEST_EXIT_PASS;
+  uint32_t key_blob_size;
+  uint32_t rand_buf_size;
+  uint64_t * alphas = NULL;
+  uint64_t * betas = NULL;
+  uint8_t * rand_bufs = NULL;
+  uint8_t * key1_blobs = NULL;
+  uint8_t * key2_blobs = NULL;
+  uint8_t * key1_blob = NULL;
+  uint8_t * key2_blob = NULL;
+  {
+    pfss_status const s =
+        pfss_gen_sizes(db, rb, &key_blob_size, &rand_buf_size);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_gen_sizes failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup;
+    }
+  }
+  alphas = malloc(count * sizeof(*alphas));
+  betas = malloc(count * sizeof(*betas));
+  rand_bufs = malloc((size_t)count * rand_buf_size);
+  key1_blobs = calloc(count, key_blob_size);
+  key2_blobs = calloc(count, key_blob_size);
+  key1_blob = calloc(1, key_blob_size);
+  key2_blob = calloc(1, key_blob_size);
+  if (alphas == NULL || betas == NULL || rand_bufs == NULL
+      || key1_blobs == NULL || key2_blobs == NULL || key1_blob == NULL
+      || key2_blob == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup;
+  }
+  {
+    uint64_t const dmask =
+        db >= 64 ? UINT64_MAX : ((uint64_t)1 << db) - 1;
+    uint64_t const rmask =
+        rb >= 64 ? UINT64_MAX : ((uint64_t)1 << rb) - 1;
+    uint32_t i;
+    for (i = 0; i != count; ++i) {
+      alphas[i] = (((uint64_t)rand() << 32) ^ (uint64_t)rand()) & dmask;
+      betas[i] = (((uint64_t)rand() << 32) ^ (uint64_t)rand()) & rmask;
+    }
+    for (i = 0; i != count * rand_buf_size; ++i) {
+      rand_bufs[i] = (uint8_t)rand();
+    }
+  }
+  {
+    pfss_status const s = pfss_map_gen_mt(db,
+                                          rb,
+                                          (uint8_t const *)alphas,
+                                          count,
+                                          sizeof(*alphas),
+                                          PFSS_NATIVE_ENDIAN,
+                                          (uint8_t const *)betas,
+                                          sizeof(*betas),
+                                          PFSS_NATIVE_ENDIAN,
+                                          key1_blobs,
+                                          key2_blobs,
+                                          rand_bufs,
+                                          thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_map_gen_mt failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup;
+    }
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != count; ++i) {
+      pfss_status const s =
+          pfss_gen(db,
+                   rb,
+                   (uint8_t const *)&alphas[i],
+                   sizeof(*alphas),
+                   PFSS_NATIVE_ENDIAN,
+                   (uint8_t const *)&betas[i],
+                   sizeof(*betas),
+                   PFSS_NATIVE_ENDIAN,
+                   key1_blob,
+                   key2_blob,
+                   rand_bufs + (size_t)i * rand_buf_size);
+      if (s != PFSS_OK) {
+        fprintf(stderr, "pfss_gen failed: %s\n", pfss_get_status_name(s));
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup;
+      }
+      if (memcmp(key1_blob,
+                 key1_blobs + (size_t)i * key_blob_size,
+                 key_blob_size)
+              != 0
+          || memcmp(key2_blob,
+                    key2_blobs + (size_t)i * key_blob_size,
+                    key_blob_size)
+                 != 0) {
+        fprintf(stderr,
+                "pfss_map_gen_mt disagrees with pfss_gen for key %lu "
+                "(db=%lu, rb=%lu, count=%lu, thread_count=%lu)\n",
+                (unsigned long)i,
+                (unsigned long)db,
+                (unsigned long)rb,
+                (unsigned long)count,
+                (unsigned long)thread_count);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup;
+      }
+    }
+  }
+cleanup:
+  free(alphas);
+  free(betas);
+  free(rand_bufs);
+  free(key1_blobs);
+  free(key2_blobs);
+  free(key1_blob);
+  free(key2_blob);
+  return exit_status;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 8, 1, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 8, 7, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 8, 8, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 8, 9, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 37, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(16, 32, 1000, 7));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 1, 37, 5));
+  s = (s != TEST_EXIT_PASS ? s : test1(20, 3, 17, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(3, 5, 23, 16));
+  s = (s != TEST_EXIT_PASS ? s : test1(1, 1, 9, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(33, 64, 65, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(64, 64, 41, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(100, 17, 19, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(32, 63, 11, 2));
+  return s;
+}
@@ -0,0 +1,279 @@
+/*
+ * For the copyright information for this file, please search up the
+ * directory tree for the first COPYING file.
+ */
+
+#include <TEST_EXIT.h>
+#include <helpers.h>
+#include <pfss.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Parses keys_count key blobs, alternating between key1_blob and
+ * key2_blob, into a key set on thread_count threads. Checks that every
+ * key of the set evaluates like the key it was parsed from, and that
+ * pfss_eval_all_sum_key_set, pfss_eval_all_dot_key_set, and
+ * pfss_map_eval_key_set agree with the same calls on an array of the
+ * separately parsed keys. Also checks that a set with one mismatched
+ * blob and a set with the wrong blob size are rejected.
+ */
+
+static int test1(uint32_t const db,
+                 uint32_t const rb,
+                 uint32_t const dv,
+                 uint32_t const rv,
+                 uint32_t const keys_count,
+                 uint32_t const thread_count) {
+  uint32_t const n = 1U << db;
+  uint8_t * blobs = NULL;
+  pfss_key_set * key_set = NULL;
+  pfss_eval_context * context = NULL;
+  pfss_key const ** keys = NULL;
+  uint32_t * xs = NULL;
+  uint32_t * ys1 = NULL;
+  uint32_t * ys2 = NULL;
+  uint32_t * zs1 = NULL;
+  uint32_t * zs2 = NULL;
+  DO_UP_TO_PARSE_KEY(db, rb, dv, rv);
+  blobs = malloc((size_t)keys_count * key_blob_size);
+  keys = malloc(keys_count * sizeof(*keys));
+  xs = malloc(n * sizeof(*xs));
+  ys1 = malloc((size_t)keys_count * n * sizeof(*ys1));
+  ys2 = malloc((size_t)keys_count * n * sizeof(*ys2));
+  zs1 = malloc(keys_count * sizeof(*zs1));
+  zs2 = malloc(keys_count * sizeof(*zs2));
+  if (blobs == NULL || keys == NULL || xs == NULL || ys1 == NULL
+      || ys2 == NULL || zs1 == NULL || zs2 == NULL) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      memcpy(blobs + (size_t)i * key_blob_size,
+             i % 2 == 0 ? key1_blob : key2_blob,
+             key_blob_size);
+      keys[i] = i % 2 == 0 ? key1 : key2;
+    }
+    for (i = 0; i != n; ++i) {
+      xs[i] = (uint32_t)rand() & (n - 1);
+    }
+  }
+  if (pfss_eval_context_create(&context) != PFSS_OK) {
+    exit_status = TEST_EXIT_ERROR;
+    goto cleanup2;
+  }
+  {
+    pfss_status const s = pfss_parse_keys(
+        &key_set, blobs, keys_count, key_blob_size, thread_count);
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_parse_keys failed: %s\n",
+              pfss_get_status_name(s));
+      key_set = NULL;
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+  }
+  {
+    uint32_t i;
+    for (i = 0; i != keys_count; ++i) {
+      pfss_key const * key;
+      uint32_t y1;
+      uint32_t y2;
+      if (pfss_get_key_set_key(key_set, i, &key) != PFSS_OK
+          || pfss_eval(key,
+                       (uint8_t const *)&dv,
+                       sizeof(dv),
+                       PFSS_NATIVE_ENDIAN,
+                       (uint8_t *)&y1,
+                       sizeof(y1),
+                       PFSS_NATIVE_ENDIAN)
+                 != PFSS_OK
+          || pfss_eval(keys[i],
+                       (uint8_t const *)&dv,
+                       sizeof(dv),
+                       PFSS_NATIVE_ENDIAN,
+                       (uint8_t *)&y2,
+                       sizeof(y2),
+                       PFSS_NATIVE_ENDIAN)
+                 != PFSS_OK) {
+        fprintf(stderr, "pfss_eval failed\n");
+        exit_status = TEST_EXIT_ERROR;
+        goto cleanup2;
+      }
+      if (y1 != y2) {
+        fprintf(stderr, "key %lu of the set is wrong\n", (unsigned long)i);
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+    {
+      pfss_key const * key;
+      if (pfss_get_key_set_key(key_set, keys_count, &key)
+          != PFSS_INVALID_ARGUMENT) {
+        fprintf(stderr, "pfss_get_key_set_key accepted a bad index\n");
+        exit_status = TEST_EXIT_FAIL;
+        goto cleanup2;
+      }
+    }
+  }
+  {
+    pfss_status s;
+    memset(ys1, 0, n * sizeof(*ys1));
+    memset(ys2, 0, n * sizeof(*ys2));
+    s = pfss_eval_all_sum_key_set(context,
+                                  key_set,
+                                  (uint8_t *)ys1,
+                                  sizeof(*ys1),
+                                  PFSS_NATIVE_ENDIAN,
+                                  thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_eval_all_sum_ctx(context,
+                                keys,
+                                keys_count,
+                                (uint8_t *)ys2,
+                                sizeof(*ys2),
+                                PFSS_NATIVE_ENDIAN,
+                                thread_count);
+    }
+    if (s == PFSS_OK) {
+      s = pfss_eval_all_dot_key_set(context,
+                                    key_set,
+                                    (uint8_t const *)xs,
+                                    sizeof(*xs),
+                                    PFSS_NATIVE_ENDIAN,
+                                    (uint8_t *)zs1,
+                                    sizeof(*zs1),
+                                    PFSS_NATIVE_ENDIAN,
+                                    thread_count);
+    }
+    if (s == PFSS_OK) {
+      s = pfss_eval_all_dot_ctx(context,
+                                keys,
+                                keys_count,
+                                (uint8_t const *)xs,
+                                sizeof(*xs),
+                                PFSS_NATIVE_ENDIAN,
+                                (uint8_t *)zs2,
+                                sizeof(*zs2),
+                                PFSS_NATIVE_ENDIAN,
+                                thread_count);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_eval_all_{sum,dot} failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    if (memcmp(ys1, ys2, n * sizeof(*ys1)) != 0
+        || memcmp(zs1, zs2, keys_count * sizeof(*zs1)) != 0) {
+      fprintf(stderr,
+              "pfss_eval_all_{sum,dot}_key_set disagree with "
+              "pfss_eval_all_{sum,dot}_ctx\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+  {
+    pfss_status s = pfss_map_eval_key_set(context,
+                                          key_set,
+                                          (uint8_t const *)xs,
+                                          n,
+                                          sizeof(*xs),
+                                          PFSS_NATIVE_ENDIAN,
+                                          (uint8_t *)ys1,
+                                          sizeof(*ys1),
+                                          PFSS_NATIVE_ENDIAN,
+                                          PFSS_POINT_MAJOR,
+                                          thread_count);
+    if (s == PFSS_OK) {
+      s = pfss_map_eval_keys_ctx(context,
+                                 keys,
+                                 keys_count,
+                                 (uint8_t const *)xs,
+                                 n,
+                                 sizeof(*xs),
+                                 PFSS_NATIVE_ENDIAN,
+                                 (uint8_t *)ys2,
+                                 sizeof(*ys2),
+                                 PFSS_NATIVE_ENDIAN,
+                                 PFSS_POINT_MAJOR,
+                                 thread_count);
+    }
+    if (s != PFSS_OK) {
+      fprintf(stderr,
+              "pfss_map_eval_key{s,_set} failed: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_ERROR;
+      goto cleanup2;
+    }
+    if (memcmp(ys1, ys2, (size_t)keys_count * n * sizeof(*ys1)) != 0) {
+      fprintf(stderr,
+              "pfss_map_eval_key_set disagrees with "
+              "pfss_map_eval_keys_ctx\n");
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+  {
+    pfss_key_set * bad_set = NULL;
+    pfss_status s;
+    blobs[(size_t)(keys_count - 1) * key_blob_size + 2] ^= 1;
+    s = pfss_parse_keys(
+        &bad_set, blobs, keys_count, key_blob_size, thread_count);
+    blobs[(size_t)(keys_count - 1) * key_blob_size + 2] ^= 1;
+    if (s == PFSS_OK) {
+      pfss_destroy_key_set(bad_set);
+    }
+    if (keys_count > 1 && s != PFSS_INVALID_ARGUMENT) {
+      fprintf(stderr,
+              "pfss_parse_keys accepted a mismatched blob: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+    s = pfss_parse_keys(
+        &bad_set, blobs, keys_count - 1, key_blob_size + 1, thread_count);
+    if (s == PFSS_OK) {
+      pfss_destroy_key_set(bad_set);
+    }
+    if (keys_count > 1 && s != PFSS_MALFORMED_KEY) {
+      fprintf(stderr,
+              "pfss_parse_keys accepted the wrong blob size: %s\n",
+              pfss_get_status_name(s));
+      exit_status = TEST_EXIT_FAIL;
+      goto cleanup2;
+    }
+  }
+cleanup2:
+  if (key_set != NULL) {
+    pfss_destroy_key_set(key_set);
+  }
+  if (context != NULL) {
+    pfss_eval_context_destroy(context);
+  }
+  free(blobs);
+  free(keys);
+  free(xs);
+  free(ys1);
+  free(ys2);
+  free(zs1);
+  free(zs2);
+  goto cleanup;
+}
+
+int main(void) {
+  int s = TEST_EXIT_PASS;
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 200, 77, 1, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(8, 32, 200, 77, 2, 1));
+  s = (s != TEST_EXIT_PASS ? s : test1(10, 32, 1000, 12345, 1001, 3));
+  s = (s != TEST_EXIT_PASS ? s : test1(12, 16, 4000, 999, 600, 2));
+  s = (s != TEST_EXIT_PASS ? s : test1(9, 13, 300, 4321, 777, 4));
+  s = (s != TEST_EXIT_PASS ? s : test1(5, 1, 17, 1, 64, 2));
+  return s;
+}